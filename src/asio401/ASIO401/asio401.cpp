@@ -1,14 +1,20 @@
 #include "asio401.h"
 
+#include "clock_estimator.h"
+#include "conversion.h"
 #include "devices.h"
+#include "resampler.h"
 
 #include <cassert>
 #include <algorithm>
+#include <bit>
+#include <cmath>
+#include <numeric>
 #include <memory>
-#include <mutex>
 #include <string>
 #include <sstream>
 #include <string_view>
+#include <utility>
 #include <vector>
 
 #include <avrt.h>
@@ -21,6 +27,7 @@
 
 #include <dechamps_CMakeUtils/version.h>
 
+#include "../ASIO401Util/cpu.h"
 #include "../ASIO401Util/windows_error.h"
 
 #include "log.h"
@@ -29,6 +36,7 @@ namespace asio401 {
 
 	namespace {
 
+		// Increases the resolution of system timers (e.g. sleeps) while streaming. Note this has no bearing on timestamps, which come from HighResolutionClock.
 		class Win32HighResolutionTimer {
 		public:
 			Win32HighResolutionTimer() {
@@ -41,12 +49,11 @@ namespace asio401 {
 				Log() << "Stopping high resolution timer";
 				timeEndPeriod(1);
 			}
-			DWORD GetTimeMilliseconds() const { return timeGetTime(); }
 		};
 
 		class AvrtHighPriority {
 		public:
-			AvrtHighPriority() : avrtHandle([&] {
+			explicit AvrtHighPriority(AVRT_PRIORITY priority = AVRT_PRIORITY_CRITICAL) : avrtHandle([&] {
 				Log() << "Setting thread characteristics";
 				DWORD taskIndex = 0;
 				auto avrtHandle = AvSetMmThreadCharacteristicsA("Pro Audio", &taskIndex);
@@ -55,7 +62,7 @@ namespace asio401 {
 			}()) {
 				if (avrtHandle == 0) return;
 				Log() << "Setting thread priority";
-				if (AvSetMmThreadPriority(avrtHandle, AVRT_PRIORITY_CRITICAL) == 0) Log() << "Unable to set thread priority: " << GetWindowsErrorString(GetLastError());
+				if (AvSetMmThreadPriority(avrtHandle, priority) == 0) Log() << "Unable to set thread priority: " << GetWindowsErrorString(GetLastError());
 			}
 
 			~AvrtHighPriority() {
@@ -69,6 +76,10 @@ namespace asio401 {
 
 		std::optional<ASIOSampleRate> previousSampleRate;
 
+		// ASIO Host Applications typically call OutputReady() from within bufferSwitch(), or very shortly after it returns. If we have to wait for it,
+		// spin for a few microseconds before going to sleep, so that we don't pay for a context switch in that case.
+		constexpr size_t outputReadySpinCount = 1000;
+
 		long Message(decltype(ASIOCallbacks::asioMessage) asioMessage, long selector, long value, void* message, double* opt) {
 			Log() << "Sending message: selector = " << ::dechamps_ASIOUtil::GetASIOMessageSelectorString(selector) << ", value = " << value << ", message = " << message << ", opt = " << opt;
 			const auto result = asioMessage(selector, value, message, opt);
@@ -103,69 +114,76 @@ namespace asio401 {
 			return result;
 		}
 
-		void CopyToQA40xBuffer(const std::vector<ASIOBufferInfo>& bufferInfos, const size_t bufferSizeInFrames, const long doubleBufferIndex, const std::span<std::byte> qa40xBuffer, const long channelCount, const size_t sampleSizeInBytes) {
-			const auto calculateDestinationOffset = [&](size_t channelOffset, size_t sampleCount) {
-				return (channelCount * sampleCount + channelOffset) * sampleSizeInBytes;
-			};
-			assert(calculateDestinationOffset(0, bufferSizeInFrames) == qa40xBuffer.size());
+		// Copies the frames starting at `asioFrameOffset` in the ASIO buffers to `qa40xBuffer`. The number of frames is determined by the size of `qa40xBuffer`.
+		template <size_t channelCount>
+		void CopyToQA40xBuffer(const std::vector<ASIOBufferInfo>& bufferInfos, const long doubleBufferIndex, const size_t asioFrameOffset, const std::span<std::byte> qa40xBuffer, const size_t sampleSizeInBytes, const HostSampleType hostSampleType, const ::dechamps_cpputil::Endianness deviceSampleEndianness, const bool invertPolarity, const std::vector<SampleCalibration>& calibration) {
+			assert(sampleSizeInBytes == 4);
+			assert(qa40xBuffer.size() % (channelCount * sampleSizeInBytes) == 0);
+			const auto frameCount = qa40xBuffer.size() / (channelCount * sampleSizeInBytes);
+			std::array<const std::byte*, channelCount> sources = {};
+			SampleTransform<channelCount> transform;
+			transform.hostSampleType = hostSampleType;
+			transform.swapEndianness = ::dechamps_cpputil::endianness != deviceSampleEndianness;
 			for (const auto& bufferInfo : bufferInfos) {
 				if (bufferInfo.isInput) continue;
 
-				const auto channelNum = bufferInfo.channelNum;
+				const auto channelNum = size_t(bufferInfo.channelNum);
 				assert(channelNum < channelCount);
 				const auto channelOffset = (channelNum + 1) % channelCount;  // Both the QA401 and QA403 have their output channels swapped.
-				const auto buffer = static_cast<std::byte*>(bufferInfo.buffers[doubleBufferIndex]);
-
-				for (size_t sampleCount = 0; sampleCount < bufferSizeInFrames; ++sampleCount) {
-					memcpy(qa40xBuffer.data() + calculateDestinationOffset(channelOffset, sampleCount), buffer + sampleCount * sampleSizeInBytes, sampleSizeInBytes);
-				}
+				sources[channelOffset] = static_cast<const std::byte*>(bufferInfo.buffers[doubleBufferIndex]) + asioFrameOffset * GetHostSampleSizeInBytes(hostSampleType);
+				transform.invertPolarity[channelOffset] = invertPolarity;
+				if (!calibration.empty()) transform.calibration[channelOffset] = calibration[channelNum];
 			}
+			Interleave(sources, qa40xBuffer.data(), frameCount, transform);
 		}
 
-		void CopyFromQA40xBuffer(const std::vector<ASIOBufferInfo>& bufferInfos, const size_t bufferSizeInFrames, const long doubleBufferIndex, const std::span<const std::byte> qa40xBuffer, const long channelCount, const size_t sampleSizeInBytes, const bool swapChannels) {
-			const auto calculateSourceOffset = [&](size_t channelOffset, size_t sampleCount) {
-				return (channelCount * sampleCount + channelOffset) * sampleSizeInBytes;
-			};
-			assert(calculateSourceOffset(0, bufferSizeInFrames) == qa40xBuffer.size());
+		// The reverse of CopyToQA40xBuffer().
+		template <size_t channelCount>
+		void CopyFromQA40xBuffer(const std::vector<ASIOBufferInfo>& bufferInfos, const long doubleBufferIndex, const size_t asioFrameOffset, const std::span<const std::byte> qa40xBuffer, const size_t sampleSizeInBytes, const HostSampleType hostSampleType, const ::dechamps_cpputil::Endianness deviceSampleEndianness, const bool swapChannels, const std::vector<SampleCalibration>& calibration, SlotFilter<channelCount>* const filter) {
+			assert(sampleSizeInBytes == 4);
+			assert(qa40xBuffer.size() % (channelCount * sampleSizeInBytes) == 0);
+			const auto frameCount = qa40xBuffer.size() / (channelCount * sampleSizeInBytes);
+			std::array<std::byte*, channelCount> destinations = {};
+			SampleTransform<channelCount> transform;
+			transform.hostSampleType = hostSampleType;
+			transform.swapEndianness = ::dechamps_cpputil::endianness != deviceSampleEndianness;
 			for (const auto& bufferInfo : bufferInfos) {
 				if (!bufferInfo.isInput) continue;
 
-				const auto channelNum = bufferInfo.channelNum;
+				const auto channelNum = size_t(bufferInfo.channelNum);
 				assert(channelNum < channelCount);
 				const auto channelOffset = swapChannels ? (channelNum + 1) % channelCount : channelNum;
-				const auto buffer = static_cast<std::byte*>(bufferInfo.buffers[doubleBufferIndex]);
-
-				for (size_t sampleCount = 0; sampleCount < bufferSizeInFrames; ++sampleCount) {
-					memcpy(buffer + sampleCount * sampleSizeInBytes, qa40xBuffer.data() + calculateSourceOffset(channelOffset, sampleCount), sampleSizeInBytes);
-				}
+				destinations[channelOffset] = static_cast<std::byte*>(bufferInfo.buffers[doubleBufferIndex]) + asioFrameOffset * GetHostSampleSizeInBytes(hostSampleType);
+				// Invert polarity of the right input channel. See https://github.com/dechamps/ASIO401/issues/14
+				transform.invertPolarity[channelOffset] = channelNum == 1;
+				if (!calibration.empty()) transform.calibration[channelOffset] = calibration[channelNum];
 			}
+			if (filter != nullptr) FilterAndDeinterleave(qa40xBuffer.data(), destinations, frameCount, transform, *filter);
+			else Deinterleave(qa40xBuffer.data(), destinations, frameCount, transform);
 		}
 
-		void SwapEndianness(void* const buffer, size_t bytes, const size_t sampleSizeInBytes) {
-			assert(sampleSizeInBytes == 4);
-
-			// Potential optimization opportunity: there are probably faster ways to do this, e.g. using a bswap intrinsic.
-			auto byteBuffer = static_cast<std::byte*>(buffer);
-			while (bytes > 0) {
-				std::swap(byteBuffer[0], byteBuffer[3]);
-				std::swap(byteBuffer[1], byteBuffer[2]);
-
-				byteBuffer += sampleSizeInBytes;
-				bytes -= sampleSizeInBytes;
-			}
+		HostSampleType ParseSampleType(const std::string& sampleType) {
+			const auto hostSampleType = ::dechamps_cpputil::Find(sampleType, std::initializer_list<std::pair<std::string, HostSampleType>>{
+				{"Int32", HostSampleType::INT32},
+				{"Int24", HostSampleType::INT24},
+				{"Float32", HostSampleType::FLOAT32},
+				{"Float64", HostSampleType::FLOAT64},
+			});
+			if (!hostSampleType.has_value()) throw std::runtime_error("Invalid sample type: " + sampleType);
+			return *hostSampleType;
 		}
 
-		void ConvertASIOBufferEndianness(const std::vector<ASIOBufferInfo>& bufferInfos, const bool isInput, const long doubleBufferIndex, const size_t bufferSizeInFrames, const size_t sampleSizeInBytes, ::dechamps_cpputil::Endianness deviceSampleEndianness) {
-			if (::dechamps_cpputil::endianness == deviceSampleEndianness) return;
-			for (const auto& bufferInfo : bufferInfos) {
-				if (!!bufferInfo.isInput != isInput) continue;
-				SwapEndianness(bufferInfo.buffers[doubleBufferIndex], bufferSizeInFrames * 4, sampleSizeInBytes);
+		ASIOSampleType GetASIOSampleType(const HostSampleType hostSampleType) {
+			constexpr auto bigEndian = ::dechamps_cpputil::endianness == ::dechamps_cpputil::Endianness::BIG;
+			switch (hostSampleType) {
+			case HostSampleType::INT32: return bigEndian ? ASIOSTInt32MSB : ASIOSTInt32LSB;
+			case HostSampleType::INT24: return bigEndian ? ASIOSTInt24MSB : ASIOSTInt24LSB;
+			case HostSampleType::FLOAT32: return bigEndian ? ASIOSTFloat32MSB : ASIOSTFloat32LSB;
+			case HostSampleType::FLOAT64: return bigEndian ? ASIOSTFloat64MSB : ASIOSTFloat64LSB;
 			}
+			abort();
 		}
 
-		constexpr ASIOSampleType sampleType = ::dechamps_cpputil::endianness == ::dechamps_cpputil::Endianness::BIG ? ASIOSTInt32MSB : ASIOSTInt32LSB;
-		using NativeSampleType = int32_t;
-
 		std::optional<QA401::SampleRate> GetQA401SampleRate(ASIOSampleRate sampleRate) {
 			return ::dechamps_cpputil::Find(sampleRate, std::initializer_list<std::pair<ASIOSampleType, QA401::SampleRate>>{
 				{48000, QA401::SampleRate::KHZ48},
@@ -182,6 +200,11 @@ namespace asio401 {
 			});
 		}
 
+		// Host sample rates that no QA40x device supports natively, but that are commonly used by ASIO host applications.
+		constexpr std::array<ASIOSampleRate, 2> resampledSampleRates = { 44100, 88200 };
+		// All the sample rates supported by at least one QA40x device, in ascending order.
+		constexpr std::array<ASIOSampleRate, 4> nativeSampleRates = { 48000, 96000, 192000, 384000 };
+
 		QA401::AttenuatorState GetQA401AttenuatorState(const Config& config) {
 			const auto fullScaleInputLevelDBV = config.fullScaleInputLevelDBV.value_or(+26.0);
 			const auto attenuatorState = ::dechamps_cpputil::Find(
@@ -238,35 +261,17 @@ namespace asio401 {
 			return *fullScaleOutputLevel;
 		}
 
-		template <typename Integer> void NegateIntegerBuffer(Integer* buffer, size_t count) {
-			std::replace(buffer, buffer + count, (std::numeric_limits<Integer>::min)(), (std::numeric_limits<Integer>::min)() + 1);
-			std::transform(buffer, buffer + count, buffer, std::negate());
-		}
-
-		void PreProcessASIOOutputBuffers(const std::vector<ASIOBufferInfo>& bufferInfos, const long doubleBufferIndex, const size_t bufferSizeInFrames, const size_t sampleSizeInBytes, ::dechamps_cpputil::Endianness deviceSampleEndianness, const bool invertPolarity) {
-			for (const auto& bufferInfo : bufferInfos) {
-				if (bufferInfo.isInput) continue;
-
-				if (invertPolarity) NegateIntegerBuffer(static_cast<NativeSampleType*>(bufferInfo.buffers[doubleBufferIndex]), bufferSizeInFrames);
-			}
-
-			ConvertASIOBufferEndianness(bufferInfos, false, doubleBufferIndex, bufferSizeInFrames, sampleSizeInBytes, deviceSampleEndianness);
-		}
-
-		void PostProcessASIOInputBuffers(const std::vector<ASIOBufferInfo>& bufferInfos, const long doubleBufferIndex, const size_t bufferSizeInFrames, const size_t sampleSizeInBytes, ::dechamps_cpputil::Endianness deviceSampleEndianness) {
-			ConvertASIOBufferEndianness(bufferInfos, true, doubleBufferIndex, bufferSizeInFrames, sampleSizeInBytes, deviceSampleEndianness);
-
-			for (const auto& bufferInfo : bufferInfos) {
-				if (!bufferInfo.isInput) continue;
+	}
 
-				// Invert polarity of the right input channel. See https://github.com/dechamps/ASIO401/issues/14
-				if (bufferInfo.channelNum == 1) NegateIntegerBuffer(static_cast<NativeSampleType*>(bufferInfo.buffers[doubleBufferIndex]), bufferSizeInFrames);
-			}
+	ASIO401::Device ASIO401::GetDevice(const Config& config) {
+		if (config.emulator.has_value()) {
+			Log() << "Using emulated " << *config.emulator << " device instead of actual hardware";
+			const QA40xEmulator::Options emulatorOptions{ .sampleClockErrorPPM = config.emulatorSampleClockErrorPPM, .faultIntervalSeconds = config.emulatorFaultIntervalSeconds };
+			// The QA402 uses the same protocol as the QA403.
+			if (*config.emulator == "QA401") return Device(std::in_place_type<QA401>, emulatorOptions);
+			return Device(std::in_place_type<QA403>, emulatorOptions);
 		}
 
-	}
-
-	ASIO401::Device ASIO401::GetDevice() {
 		const auto qa401DevicesPaths = GetDevicesPaths({ 0xFDA49C5C, 0x7006, 0x4EE9, { 0x88, 0xB2, 0xA0, 0xF8, 0x06, 0x50, 0x81, 0x50 } });
 		const auto qa402DevicesPaths = GetDevicesPaths({ 0x2232825c, 0x1e52, 0x447a, { 0x83, 0xbd, 0xc8, 0x4d, 0xa7, 0xc1, 0x88, 0x59 } });
 		const auto qa403DevicesPaths = GetDevicesPaths({ 0x5512825c, 0x1e52, 0x447a, { 0x83, 0xbd, 0xc8, 0x4d, 0xa7, 0xc1, 0x82, 0x13 } });
@@ -292,12 +297,32 @@ namespace asio401 {
 		const auto config = LoadConfig();
 		if (!config.has_value()) throw ASIOException(ASE_HWMalfunction, "could not load ASIO401 configuration. See ASIO401 log for details.");
 		return *config;
-	}()), device(GetDevice()) {
+	}()), device(GetDevice(config)), hostSampleType(ParseSampleType(config.sampleType)), inputCalibration(ComputeCalibration(true)), outputCalibration(ComputeCalibration(false)), usbTransferAlignmentInFrames(ComputeUsbTransferAlignmentInFrames()), streamingStats(StreamingStats::Create()) {
 		Log() << "sysHandle = " << sysHandle;
+		Log() << "CPU supports SSSE3: " << (GetCpuFeatures().ssse3 ? "yes" : "no") << ", AVX2: " << (GetCpuFeatures().avx2 ? "yes" : "no");
 		ValidateConfig();
 	}
 
+	size_t ASIO401::ComputeUsbTransferAlignmentInFrames() {
+		return WithDevice([&](auto& device) {
+			const auto getPacketAlignmentInFrames = [&](size_t maximumPacketSizeInBytes, size_t frameSizeInBytes) {
+				return std::lcm(maximumPacketSizeInBytes, frameSizeInBytes) / frameSizeInBytes;
+			};
+			const auto writePacketAlignmentInFrames = getPacketAlignmentInFrames(device.GetWriteChannel().GetMaximumPacketSizeInBytes(), device.outputChannelCount * device.sampleSizeInBytes);
+			const auto readPacketAlignmentInFrames = getPacketAlignmentInFrames(device.GetReadChannel().GetMaximumPacketSizeInBytes(), device.inputChannelCount * device.sampleSizeInBytes);
+			const auto usbTransferAlignmentInFrames = std::lcm(std::lcm(writePacketAlignmentInFrames, readPacketAlignmentInFrames), size_t(device.writeGranularityInFrames));
+			Log() << "USB transfers will be aligned to " << usbTransferAlignmentInFrames << " frames (write packets: " << writePacketAlignmentInFrames << " frames, read packets: " << readPacketAlignmentInFrames << " frames, write granularity: " << device.writeGranularityInFrames << " frames)";
+			return usbTransferAlignmentInFrames;
+		});
+	}
+
 	void ASIO401::ValidateConfig() const {
+		if (config.usbTransferSizeSamples.has_value() && *config.usbTransferSizeSamples % usbTransferAlignmentInFrames != 0)
+			throw std::runtime_error("USB transfer size of " + std::to_string(*config.usbTransferSizeSamples) + " samples is not supported by this device. It must be a multiple of " + std::to_string(usbTransferAlignmentInFrames) + " samples.");
+		if (config.deviceSampleRateHz.has_value() && !WithDevice(
+			[&](const QA401&) { return GetQA401SampleRate(ASIOSampleRate(*config.deviceSampleRateHz)).has_value(); },
+			[&](const QA403&) { return GetQA403SampleRate(ASIOSampleRate(*config.deviceSampleRateHz)).has_value(); }))
+			throw std::runtime_error("Device sample rate of " + std::to_string(*config.deviceSampleRateHz) + " Hz is not supported by this device");
 		WithDevice(
 			[&](const QA401&) {
 				GetQA401AttenuatorState(config);
@@ -309,6 +334,70 @@ namespace asio401 {
 			});
 	}
 
+	std::vector<SampleCalibration> ASIO401::ComputeCalibration(const bool input) const {
+		const auto direction = input ? "input" : "output";
+		const auto& calibrations = input ? config.inputCalibration : config.outputCalibration;
+		// Note the full scale level is validated later, in ValidateConfig(). If it is invalid, it won't match anything here.
+		const auto fullScaleLevelDBV = WithDevice(
+			[&](const QA401&) { return input ? config.fullScaleInputLevelDBV.value_or(+26.0) : +5.5; },
+			[&](const QA403&) { return input ? config.fullScaleInputLevelDBV.value_or(+42.0) : config.fullScaleOutputLevelDBV.value_or(-12.0); });
+		const auto calibration = std::find_if(calibrations.begin(), calibrations.end(), [&](const Config::Calibration& candidate) { return candidate.fullScaleLevelDBV == fullScaleLevelDBV; });
+		if (calibration == calibrations.end()) {
+			if (!calibrations.empty()) Log() << "No " << direction << " calibration for full scale level " << fullScaleLevelDBV << " dBV";
+			return {};
+		}
+
+		const auto channelCount = size_t(input ? GetDeviceInputChannelCount() : GetDeviceOutputChannelCount());
+		if (!calibration->gainDB.empty() && calibration->gainDB.size() != channelCount)
+			throw std::runtime_error("The " + std::string(direction) + " calibration for full scale level " + std::to_string(fullScaleLevelDBV) + " dBV has " + std::to_string(calibration->gainDB.size()) + " gain values, but the device has " + std::to_string(channelCount) + " " + direction + " channels");
+		if (!calibration->offset.empty() && calibration->offset.size() != channelCount)
+			throw std::runtime_error("The " + std::string(direction) + " calibration for full scale level " + std::to_string(fullScaleLevelDBV) + " dBV has " + std::to_string(calibration->offset.size()) + " offset values, but the device has " + std::to_string(channelCount) + " " + direction + " channels");
+
+		std::vector<SampleCalibration> result(channelCount);
+		for (size_t channelNum = 0; channelNum < channelCount; ++channelNum) {
+			if (!calibration->gainDB.empty()) result[channelNum].gain = std::pow(10.0, calibration->gainDB[channelNum] / 20);
+			if (!calibration->offset.empty()) result[channelNum].offset = calibration->offset[channelNum];
+			Log() << "Applying " << direction << " calibration for full scale level " << fullScaleLevelDBV << " dBV to channel " << channelNum << ": gain " << result[channelNum].gain << ", offset " << result[channelNum].offset;
+		}
+		return result;
+	}
+
+	std::optional<ASIOSampleRate> ASIO401::GetDeviceSampleRate(ASIOSampleRate sampleRate) const {
+		if (config.deviceSampleRateHz.has_value()) {
+			// Only native sample rates are offered to the host, so that the device sample rate is always a power-of-two multiple of the host sample rate
+			// (see SampleRateRatio::IsDecimation()).
+			const auto deviceSampleRate = ASIOSampleRate(*config.deviceSampleRateHz);
+			if (sampleRate > deviceSampleRate || std::ranges::find(nativeSampleRates, sampleRate) == nativeSampleRates.end()) return std::nullopt;
+			return deviceSampleRate;
+		}
+		const auto isNative = [&](ASIOSampleRate candidate) {
+			return WithDevice(
+				[&](const QA401&) { return GetQA401SampleRate(candidate).has_value(); },
+				[&](const QA403&) { return GetQA403SampleRate(candidate).has_value(); });
+		};
+		if (isNative(sampleRate)) return sampleRate;
+		if (std::ranges::find(resampledSampleRates, sampleRate) == resampledSampleRates.end()) return std::nullopt;
+		// Resampling to a higher rate means the entire host bandwidth is preserved.
+		for (const auto candidate : nativeSampleRates)
+			if (candidate > sampleRate && isNative(candidate)) return candidate;
+		return std::nullopt;
+	}
+
+	ASIO401::SampleRateRatio ASIO401::GetSampleRateRatio(ASIOSampleRate sampleRate) const {
+		const auto hostSampleRate = int64_t(sampleRate);
+		const auto deviceSampleRate = int64_t(*GetDeviceSampleRate(sampleRate));
+		const auto divisor = std::gcd(hostSampleRate, deviceSampleRate);
+		return { .deviceFrames = size_t(deviceSampleRate / divisor), .hostFrames = size_t(hostSampleRate / divisor) };
+	}
+
+	size_t ASIO401::GetBufferSizeGranularityInFrames(bool output) const {
+		const auto sampleRateRatio = GetSampleRateRatio(sampleRate);
+		if (!output) return sampleRateRatio.hostFrames;
+		// Every `hostFrames` host frames make `deviceFrames` device frames, so we need the smallest multiple of `deviceFrames` that is also a multiple of the write granularity.
+		const auto writeGranularityInFrames = GetDeviceWriteGranularityInFrames();
+		return sampleRateRatio.hostFrames * (writeGranularityInFrames / std::gcd(sampleRateRatio.deviceFrames, writeGranularityInFrames));
+	}
+
 	ASIO401::BufferSizes ASIO401::ComputeBufferSizes() const
 	{
 		BufferSizes bufferSizes;
@@ -316,6 +405,10 @@ namespace asio401 {
 			Log() << "Using buffer size " << *config.bufferSizeSamples << " from configuration";
 			bufferSizes.minimum = bufferSizes.maximum = bufferSizes.preferred = long(*config.bufferSizeSamples);
 			bufferSizes.granularity = 0;
+			if (size_t(*config.bufferSizeSamples) % GetBufferSizeGranularityInFrames(/*output=*/false) != 0)
+				Log() << "WARNING: the configured buffer size is not a multiple of " << GetBufferSizeGranularityInFrames(/*output=*/false) << " samples, and cannot be used at " << sampleRate << " Hz";
+			else if (size_t(*config.bufferSizeSamples) % GetBufferSizeGranularityInFrames(/*output=*/true) != 0)
+				Log() << "WARNING: the configured buffer size is not a multiple of " << GetBufferSizeGranularityInFrames(/*output=*/true) << " samples, and cannot be used with output channels at " << sampleRate << " Hz";
 		}
 		else {
 			// Mostly arbitrary; based on the size of a single USB bulk transfer packet
@@ -330,7 +423,12 @@ namespace asio401 {
 
 			// QA40x devices have a minimum write granularity, under which the DAC output is garbled.
 			// We don't know if the user actually intends to use output channels at this point, but let's err on the safe side.
-			bufferSizes.granularity = long(GetDeviceWriteGranularityInFrames());
+			// If the stream is resampled, the granularity is coarser, and the above sizes are rounded to it. (Otherwise they are already multiples of it.)
+			const auto granularity = long(GetBufferSizeGranularityInFrames(/*output=*/true));
+			bufferSizes.granularity = granularity;
+			bufferSizes.minimum = (bufferSizes.minimum + granularity - 1) / granularity * granularity;
+			bufferSizes.preferred = (std::max)((bufferSizes.preferred + granularity / 2) / granularity, 1L) * granularity;
+			bufferSizes.maximum = bufferSizes.maximum / granularity * granularity;
 		}
 		return bufferSizes;
 	}
@@ -343,6 +441,11 @@ namespace asio401 {
 		*preferredSize = bufferSizes.preferred;
 		*granularity = bufferSizes.granularity;
 		Log() << "Returning: min buffer size " << *minSize << ", max buffer size " << *maxSize << ", preferred buffer size " << *preferredSize << ", granularity " << *granularity;
+		// This happens when the stream is resampled (e.g. 44.1 kHz), as the granularity is then a multiple of 147. Host applications that only offer
+		// power-of-two buffer sizes will not be able to stream at this sample rate, so make that obvious in the log.
+		const auto outputGranularityInFrames = GetBufferSizeGranularityInFrames(/*output=*/true);
+		if (!std::has_single_bit(outputGranularityInFrames))
+			Log() << "Note: at " << sampleRate << " Hz, buffer sizes must be a multiple of " << GetBufferSizeGranularityInFrames(/*output=*/false) << " samples (" << outputGranularityInFrames << " samples if output channels are used), so power-of-two buffer sizes cannot be used";
 	}
 
 	void ASIO401::GetChannels(long* numInputChannels, long* numOutputChannels)
@@ -368,7 +471,7 @@ namespace asio401 {
 
 		info->isActive = preparedState.has_value() && preparedState->IsChannelActive(info->isInput, info->channel);
 		info->channelGroup = 0;
-		info->type = sampleType;
+		info->type = GetASIOSampleType(hostSampleType);
 		std::stringstream channel_string;
 		channel_string << (info->isInput ? "IN" : "OUT") << " " << info->channel;
 		switch (info->channel) {
@@ -382,9 +485,7 @@ namespace asio401 {
 	bool ASIO401::CanSampleRate(ASIOSampleRate sampleRate)
 	{
 		Log() << "Checking for sample rate: " << sampleRate;
-		return WithDevice(
-			[&](QA401&) { return GetQA401SampleRate(sampleRate).has_value(); },
-			[&](QA403&) { return GetQA403SampleRate(sampleRate).has_value(); });
+		return GetDeviceSampleRate(sampleRate).has_value();
 	}
 
 	void ASIO401::GetSampleRate(ASIOSampleRate* sampleRateResult)
@@ -409,12 +510,19 @@ namespace asio401 {
 			return;
 		}
 
+		const auto previousSampleRateRatio = GetSampleRateRatio(sampleRate);
 		sampleRate = requestedSampleRate;
 		if (preparedState.has_value() && preparedState->IsRunning())
 		{
 			Log() << "Sending a reset request to the host as it's not possible to change sample rate while streaming";
 			preparedState->RequestReset();
 		}
+		else if (preparedState.has_value() && GetSampleRateRatio(sampleRate) != previousSampleRateRatio)
+		{
+			// The streaming buffers are sized in device frames, which don't correspond to the same number of host frames anymore.
+			Log() << "Sending a reset request to the host as the buffers need to be recreated for the new sample rate";
+			preparedState->RequestReset();
+		}
 	}
 
 	void ASIO401::CreateBuffers(ASIOBufferInfo* bufferInfos, long numChannels, long bufferSize, ASIOCallbacks* callbacks) {
@@ -434,9 +542,9 @@ namespace asio401 {
 		preparedState.emplace(*this, bufferInfos, numChannels, bufferSize, callbacks);
 	}
 
-	ASIO401::PreparedState::Buffers::Buffers(size_t bufferSetCount, size_t inputChannelCount, size_t outputChannelCount, size_t bufferSizeInFrames, size_t inputSampleSizeInBytes, size_t outputSampleSizeInBytes) :
+	ASIO401::PreparedState::Buffers::Buffers(MemoryArena& memoryArena, size_t bufferSetCount, size_t inputChannelCount, size_t outputChannelCount, size_t bufferSizeInFrames, size_t inputSampleSizeInBytes, size_t outputSampleSizeInBytes) :
 		bufferSetCount(bufferSetCount), inputChannelCount(inputChannelCount), outputChannelCount(outputChannelCount), bufferSizeInFrames(bufferSizeInFrames), inputSampleSizeInBytes(inputSampleSizeInBytes), outputSampleSizeInBytes(outputSampleSizeInBytes),
-		buffers(bufferSetCount * bufferSizeInFrames * (inputChannelCount * inputSampleSizeInBytes + outputChannelCount * outputSampleSizeInBytes)) {
+		buffers(memoryArena.Allocate(GetSizeInBytes(bufferSetCount, inputChannelCount, outputChannelCount, bufferSizeInFrames, inputSampleSizeInBytes, outputSampleSizeInBytes))) {
 		Log() << "Allocated "
 			<< bufferSetCount << " buffer sets, "
 			<< inputChannelCount << "/" << outputChannelCount << " (I/O) channels per buffer set, "
@@ -451,10 +559,20 @@ namespace asio401 {
 
 	ASIO401::PreparedState::PreparedState(ASIO401& asio401, ASIOBufferInfo* asioBufferInfos, long numChannels, long bufferSizeInFrames, ASIOCallbacks* callbacks) :
 		asio401(asio401), callbacks(*callbacks),
+		streamingLayout(ComputeStreamingLayout(asio401, GetBufferInfosChannelCount(asioBufferInfos, numChannels, true), GetBufferInfosChannelCount(asioBufferInfos, numChannels, false), bufferSizeInFrames)),
+		memoryArena(
+			MemoryArena::GetBlockSizeInBytes(Buffers::GetSizeInBytes(
+				2,
+				GetBufferInfosChannelCount(asioBufferInfos, numChannels, true), GetBufferInfosChannelCount(asioBufferInfos, numChannels, false),
+				bufferSizeInFrames, asio401.GetHostSampleSizeInBytes(), asio401.GetHostSampleSizeInBytes())) +
+			StreamingBuffers::GetArenaSizeInBytes(streamingLayout)),
 		buffers(
+			memoryArena,
 			2,
 			GetBufferInfosChannelCount(asioBufferInfos, numChannels, true), GetBufferInfosChannelCount(asioBufferInfos, numChannels, false),
-			bufferSizeInFrames, asio401.GetDeviceSampleSizeInBytes(), asio401.GetDeviceSampleSizeInBytes()),
+			bufferSizeInFrames, asio401.GetHostSampleSizeInBytes(), asio401.GetHostSampleSizeInBytes()),
+		streamingBuffers(streamingLayout, memoryArena),
+		tracer(Tracer::Open(clock)),
 		bufferInfos([&] {
 		std::vector<ASIOBufferInfo> bufferInfos;
 		bufferInfos.reserve(numChannels);
@@ -491,14 +609,174 @@ namespace asio401 {
 		}
 
 		if (hasOutput) {
-			const auto requiredGranularityInFrames = asio401.GetDeviceWriteGranularityInFrames();
+			const auto requiredGranularityInFrames = asio401.GetBufferSizeGranularityInFrames(/*output=*/true);
 			if (bufferSizeInFrames % requiredGranularityInFrames != 0)
 				throw ASIOException(ASE_InvalidMode, "Buffer size must be a multiple of " + std::to_string(requiredGranularityInFrames) + " when output channels are used");
 		}
 
 		return bufferInfos;
-	}()) {
+	}()),
+		streamingThread([this] { runningState->RunThread(); }) {
+		if (asio401.config.ioThread) callbackThread.emplace([this] { runningState->RunCallbackThread(); });
+
+		if (const auto& sampleRateRatio = streamingLayout.sampleRateRatio; !sampleRateRatio.IsIdentity()) {
+			const auto deviceSampleEndianness = asio401.GetDeviceSampleEndianness();
+			Log() << "Resampling " << asio401.sampleRate << " Hz to/from " << *asio401.GetDeviceSampleRate(asio401.sampleRate) << " Hz (" << sampleRateRatio.deviceFrames << "/" << sampleRateRatio.hostFrames << ")"
+				<< " using " << GetResamplerTapsPerPhase(sampleRateRatio.deviceFrames, sampleRateRatio.hostFrames) << " taps per phase for output";
+			if (sampleRateRatio.IsDecimation()) {
+				std::stringstream tapCounts;
+				for (size_t stageIndex = 0; stageIndex < sampleRateRatio.GetDecimationStageCount(); ++stageIndex)
+					tapCounts << (stageIndex > 0 ? "/" : "") << GetDecimatorTapCount(sampleRateRatio.GetDecimationStageCount(), stageIndex);
+				Log() << "Decimating input using " << sampleRateRatio.GetDecimationStageCount() << " half-band stages with " << tapCounts.str() << " taps";
+			}
+			else Log() << "Resampling input using " << GetResamplerTapsPerPhase(sampleRateRatio.hostFrames, sampleRateRatio.deviceFrames) << " taps per phase";
+			if (streamingLayout.mustPlay) {
+				outputResampler.emplace(sampleRateRatio.deviceFrames, sampleRateRatio.hostFrames, buffers.bufferSizeInFrames, /*swapInputEndianness=*/false, /*swapOutputEndianness=*/::dechamps_cpputil::endianness != deviceSampleEndianness);
+				outputResamplerInput.resize(buffers.bufferSizeInFrames * streamingLayout.writeFrameSizeInBytes);
+			}
+			if (streamingLayout.mustRecord) {
+				if (sampleRateRatio.IsDecimation())
+					inputDecimator.emplace(sampleRateRatio.GetDecimationStageCount(), streamingLayout.asioBufferSizeInDeviceFrames, /*swapInputEndianness=*/::dechamps_cpputil::endianness != deviceSampleEndianness, /*swapOutputEndianness=*/false);
+				else
+					inputResampler.emplace(sampleRateRatio.hostFrames, sampleRateRatio.deviceFrames, streamingLayout.asioBufferSizeInDeviceFrames, /*swapInputEndianness=*/::dechamps_cpputil::endianness != deviceSampleEndianness, /*swapOutputEndianness=*/false);
+			}
+		}
+
+		recoveryBeginTimes.resize(size_t(asio401.config.recoveryLimit));
+
+		Log() << "Allocated a memory arena of " << memoryArena.GetSizeInBytes() << " bytes at " << static_cast<const void*>(memoryArena.GetData());
+		if (asio401.config.lockMemory) {
+			try {
+				memoryArena.Lock();
+				Log() << "Memory arena locked";
+			}
+			catch (const std::exception& exception) {
+				Log() << "WARNING: unable to lock the memory arena, proceeding without locking: " << exception.what();
+			}
+		}
+
 		if (callbacks->asioMessage) ProbeHostMessages(callbacks->asioMessage);
+
+		if (tracer != nullptr) tracer->Record(TraceEvent::SESSION_BEGIN, bufferSizeInFrames, int64_t(streamingLayout.transferSlotCount));
+	}
+
+	ASIO401::PreparedState::StreamingLayout ASIO401::PreparedState::ComputeStreamingLayout(const ASIO401& asio401, size_t inputChannelCount, size_t outputChannelCount, size_t asioBufferSizeInFrames) {
+		// From this point on, everything is in device frames.
+		const auto sampleRateRatio = asio401.GetSampleRateRatio(asio401.sampleRate);
+		if (asioBufferSizeInFrames % sampleRateRatio.hostFrames != 0)
+			throw ASIOException(ASE_InvalidMode, "Buffer size must be a multiple of " + std::to_string(sampleRateRatio.hostFrames) + " at " + std::to_string(asio401.sampleRate) + " Hz");
+		const auto bufferSizeInFrames = asioBufferSizeInFrames / sampleRateRatio.hostFrames * sampleRateRatio.deviceFrames;
+		const auto mustPlay = outputChannelCount > 0;
+		const auto mustRecord = inputChannelCount > 0;
+		const auto mustRead = mustRecord || asio401.config.forceRead;
+		const auto mustMaintainSync = mustPlay && mustRead;
+		const auto initialInputGarbageInFrames = asio401.WithDevice(
+			[&](const QA401&) {
+				// As described in https://github.com/dechamps/ASIO401/issues/5, the QA401 will initially replay the last 64 frames of input.
+				// After that, the QA401 produces about 1000 frames of silence, regardless of sample rate.
+				// (Note the read still takes about the same amount of time to complete, so time sync appears to bemaintained
+				// throughout - it's as if we're actually recording, but the data gets mangled before it's delivered to us.)
+				// Note: using 1056 (1024 + 32) should work in theory, but in practice it seems like the QA401 DAC doesn't like
+				// playing a buffer that is not 64-frame aligned followed by a buffer that is 64-frame aligned (even though the
+				// QA401 minimum write granularity is supposed to be 32 frames) so let's align that one to 64 frames to be safe.
+				return 1088u;
+			},
+			[&](const QA403&) { return 0u; }
+		);
+		const auto outputQueueStartThresholdInFrames = asio401.WithDevice(
+			[&](const QA401&) { return 1u; }, // The QA401 will start as soon as at least 1 frame is written to it.
+			[&](const QA403&) { return QA403::hardwareQueueSizeInFrames; } // The QA403 will only start once its internal queue has been filled.
+		);
+		const auto inflightTransfers = size_t(asio401.config.inflightTransfers);
+		const auto usbTransferLayout = asio401.ComputeUsbTransferLayout(bufferSizeInFrames);
+		const auto periodSizeInFrames = usbTransferLayout.asioBuffersPerPeriod * bufferSizeInFrames;
+		const auto initialGarbageToSkipFrames = mustRecord ? initialInputGarbageInFrames : 0;
+		const auto prefixWriteSizeInFrames = [&] {
+			size_t prefixWriteSizeInFrames = mustMaintainSync ? initialGarbageToSkipFrames : 0;
+			// At the beginning we send one period per inflight transfer before waiting, so the total initial playback queue is the sum of the prefix and these periods.
+			const auto initialPlaybackQueueInFrames = prefixWriteSizeInFrames + (mustPlay ? inflightTransfers * periodSizeInFrames : 0);
+			// Make sure the initial playback queue is enough to trigger the hardware to start; otherwise, we'll want to pad it with silence until it does.
+			// Technically we could keep asking the host application for more buffers until we fill the queue, but that would likely make the logic vastly
+			// more complex, and things would likely become awkward if things don't align with the ASIO buffer size. Also, it's atypical for an ASIO driver
+			// to ask for more buffers than that before starting.
+			if (outputQueueStartThresholdInFrames > initialPlaybackQueueInFrames) {
+				const auto writeGranularityInFrames = asio401.GetDeviceWriteGranularityInFrames();
+				prefixWriteSizeInFrames += (outputQueueStartThresholdInFrames - initialPlaybackQueueInFrames + writeGranularityInFrames - 1) / writeGranularityInFrames * writeGranularityInFrames;
+			}
+			return prefixWriteSizeInFrames;
+		}();
+		const auto callbackThreadLeadInAsioBuffers = asio401.config.ioThread ? (inflightTransfers + size_t(asio401.config.ioThreadRingDepth)) * usbTransferLayout.asioBuffersPerPeriod : 0;
+		return {
+			.mustPlay = mustPlay,
+			.mustRecord = mustRecord,
+			.mustRead = mustRead,
+			.sampleRateRatio = sampleRateRatio,
+			.asioBufferSizeInDeviceFrames = bufferSizeInFrames,
+			.writeFrameSizeInBytes = asio401.GetDeviceOutputChannelCount() * asio401.GetDeviceSampleSizeInBytes(),
+			.readFrameSizeInBytes = asio401.GetDeviceInputChannelCount() * asio401.GetDeviceSampleSizeInBytes(),
+			.usbTransferLayout = usbTransferLayout,
+			.transferSlotCount = inflightTransfers * usbTransferLayout.transfersPerPeriod,
+			.prefixWriteSizeInFrames = prefixWriteSizeInFrames,
+			.prefixReadSizeInFrames = mustRead ? (std::max)(size_t(initialInputGarbageInFrames), mustMaintainSync ? prefixWriteSizeInFrames : 0) : 0,
+			.callbackThreadLeadInAsioBuffers = callbackThreadLeadInAsioBuffers,
+			// The rings have room for all the ASIO buffers that RunCallbackThread() produces before it starts consuming input, plus one for the buffer it is working on.
+			.ringSizeInFrames = asio401.config.ioThread ? (callbackThreadLeadInAsioBuffers + 1) * bufferSizeInFrames : 0,
+		};
+	}
+
+	ASIO401::PreparedState::StreamingBuffers::StreamingBuffers(const StreamingLayout& streamingLayout, MemoryArena& memoryArena) :
+		writeBuffers(streamingLayout.transferSlotCount), readBuffers(streamingLayout.transferSlotCount) {
+		const auto maybeAllocateBuffer = [&](auto& optionalBuffer, size_t size) {
+			if (size > 0) optionalBuffer.emplace(memoryArena.Allocate(size));
+		};
+		const auto transferSizeInFrames = streamingLayout.usbTransferLayout.transferSizeInFrames;
+		for (auto& writeBuffer : writeBuffers) maybeAllocateBuffer(writeBuffer, (streamingLayout.mustPlay ? transferSizeInFrames : 0) * streamingLayout.writeFrameSizeInBytes);
+		for (auto& readBuffer : readBuffers) maybeAllocateBuffer(readBuffer, (streamingLayout.mustRead ? transferSizeInFrames : 0) * streamingLayout.readFrameSizeInBytes);
+		maybeAllocateBuffer(prefixWriteBuffer, streamingLayout.prefixWriteSizeInFrames * streamingLayout.writeFrameSizeInBytes);
+		maybeAllocateBuffer(prefixReadBuffer, streamingLayout.prefixReadSizeInFrames * streamingLayout.readFrameSizeInBytes);
+		if (streamingLayout.mustPlay) outputRingBuffer = memoryArena.Allocate(streamingLayout.ringSizeInFrames * streamingLayout.writeFrameSizeInBytes);
+		if (streamingLayout.mustRecord) inputRingBuffer = memoryArena.Allocate(streamingLayout.ringSizeInFrames * streamingLayout.readFrameSizeInBytes);
+	}
+
+	size_t ASIO401::PreparedState::StreamingBuffers::GetArenaSizeInBytes(const StreamingLayout& streamingLayout) {
+		// Must match the allocations made by the constructor.
+		const auto transferSizeInFrames = streamingLayout.usbTransferLayout.transferSizeInFrames;
+		return
+			streamingLayout.transferSlotCount * MemoryArena::GetBlockSizeInBytes((streamingLayout.mustPlay ? transferSizeInFrames : 0) * streamingLayout.writeFrameSizeInBytes) +
+			streamingLayout.transferSlotCount * MemoryArena::GetBlockSizeInBytes((streamingLayout.mustRead ? transferSizeInFrames : 0) * streamingLayout.readFrameSizeInBytes) +
+			MemoryArena::GetBlockSizeInBytes(streamingLayout.prefixWriteSizeInFrames * streamingLayout.writeFrameSizeInBytes) +
+			MemoryArena::GetBlockSizeInBytes(streamingLayout.prefixReadSizeInFrames * streamingLayout.readFrameSizeInBytes) +
+			(streamingLayout.mustPlay ? MemoryArena::GetBlockSizeInBytes(streamingLayout.ringSizeInFrames * streamingLayout.writeFrameSizeInBytes) : 0) +
+			(streamingLayout.mustRecord ? MemoryArena::GetBlockSizeInBytes(streamingLayout.ringSizeInFrames * streamingLayout.readFrameSizeInBytes) : 0);
+	}
+
+	template <QA40x::ChannelType channelType>
+	ASIO401::PreparedState::QA40xBuffer<channelType>::QA40xBuffer(std::span<std::byte> buffer) : buffer(buffer) {
+		assert(!buffer.empty());
+	}
+
+	template <QA40x::ChannelType channelType>
+	std::span<std::byte> ASIO401::PreparedState::QA40xBuffer<channelType>::data() {
+		assert(!ioSlot.HasPending());
+		return buffer;
+	}
+
+	template <QA40x::ChannelType channelType>
+	std::span<const std::byte> ASIO401::PreparedState::QA40xBuffer<channelType>::data() const {
+		assert(!ioSlot.HasPending());
+		return buffer;
+	}
+
+	ASIO401::PreparedState::~PreparedState() {
+		runningState.reset();
+		if (!warmSampleRate.has_value()) return;
+		const auto sampleRate = *std::exchange(warmSampleRate, std::nullopt);
+		try {
+			TearDownDevice(sampleRate, /*warm=*/false);
+		}
+		catch (const std::exception& exception) {
+			Log() << "Error while attempting to tear down the QA40x: " << exception.what();
+		}
 	}
 
 	bool ASIO401::PreparedState::IsChannelActive(bool isInput, long channel) const {
@@ -527,9 +805,44 @@ namespace asio401 {
 		}
 	}
 
-	void ASIO401::ComputeLatencies(long* const inputLatency, long* const outputLatency, long bufferSizeInFrames, bool outputOnly) const
+	ASIO401::UsbTransferLayout ASIO401::ComputeUsbTransferLayout(const size_t bufferSizeInFrames) const {
+		// By default, transfers are as large as the hardware queue (rounded down to the alignment), which is 1024 frames on all devices.
+		// There is little point in making them larger, and making them much smaller would add more USB overhead.
+		const auto transferSizeInFrames = config.usbTransferSizeSamples.has_value() ?
+			size_t(*config.usbTransferSizeSamples) :
+			(std::max)(GetHardwareQueueSizeInFrames() / usbTransferAlignmentInFrames, size_t(1)) * usbTransferAlignmentInFrames;
+		if (bufferSizeInFrames > transferSizeInFrames) {
+			return {
+				.asioBuffersPerPeriod = 1,
+				.transfersPerPeriod = (bufferSizeInFrames + transferSizeInFrames - 1) / transferSizeInFrames,
+				.transferSizeInFrames = transferSizeInFrames,
+			};
+		}
+		// Coalescing ASIO buffers increases latency, so we only do it if the user explicitly asked for transfers that are larger than the ASIO buffer size.
+		const auto asioBuffersPerPeriod = config.usbTransferSizeSamples.has_value() ? transferSizeInFrames / bufferSizeInFrames : 1;
+		return {
+			.asioBuffersPerPeriod = asioBuffersPerPeriod,
+			.transfersPerPeriod = 1,
+			.transferSizeInFrames = asioBuffersPerPeriod * bufferSizeInFrames,
+		};
+	}
+
+	void ASIO401::ComputeLatencies(long* const inputLatency, long* const outputLatency, long asioBufferSizeInFrames, bool outputOnly) const
 	{
+		// The latencies are computed in device frames, then converted to host frames at the end.
+		const auto sampleRateRatio = GetSampleRateRatio(sampleRate);
+		const auto bufferSizeInFrames = long((size_t(asioBufferSizeInFrames) * sampleRateRatio.deviceFrames + sampleRateRatio.hostFrames - 1) / sampleRateRatio.hostFrames);
 		*inputLatency = *outputLatency = bufferSizeInFrames;
+		// Note that the ASIO buffers are streamed in periods (see ComputeUsbTransferLayout()), which are the same as the ASIO buffers unless they are coalesced.
+		const auto usbTransferLayout = ComputeUsbTransferLayout(size_t(bufferSizeInFrames));
+		const auto periodSizeInFrames = long(usbTransferLayout.asioBuffersPerPeriod) * bufferSizeInFrames;
+		if (usbTransferLayout.asioBuffersPerPeriod > 1) {
+			// Output data is only sent once the period is complete, and input data is only received once the period is complete. Worst case, an ASIO buffer has to wait for all the other ASIO buffers in the period.
+			const auto coalescingLatencyInFrames = periodSizeInFrames - bufferSizeInFrames;
+			Log() << coalescingLatencyInFrames << " samples added to input and output latency due to coalescing " << usbTransferLayout.asioBuffersPerPeriod << " ASIO buffers per USB transfer";
+			*inputLatency += coalescingLatencyInFrames;
+			*outputLatency += coalescingLatencyInFrames;
+		}
 		if (!hostSupportsOutputReady) {
 			Log() << bufferSizeInFrames << " samples added to output latency due to the ASIO Host Application not supporting OutputReady";
 			*outputLatency += bufferSizeInFrames;
@@ -548,10 +861,37 @@ namespace asio401 {
 			// one will NOT be transferred to a write buffer and queued right away; instead, it will only be sent *after*
 			// another write completes and frees up a write buffer. End result: the ASIO output buffer will have to wait
 			// behind 2 other buffer writes, plus the hardware queue, before actually starting to play.
-			const auto additionalOutputLatencyInFrames = bufferSizeInFrames + GetHardwareQueueSizeInFrames();
+			const auto additionalOutputLatencyInFrames = periodSizeInFrames + GetHardwareQueueSizeInFrames();
 			Log() << additionalOutputLatencyInFrames << " samples added to output latency due to write-only mode";
 			*outputLatency += long(additionalOutputLatencyInFrames);
 		}
+		// The above assumes the default of 2 inflight periods. Each additional inflight period is another period that the ASIO output buffer has
+		// to wait behind before it starts playing, regardless of mode. Additional inflight reads do not affect input latency, because reads
+		// complete as soon as the data is available.
+		const auto additionalInflightTransfers = config.inflightTransfers - 2;
+		if (additionalInflightTransfers > 0) {
+			const auto additionalOutputLatencyInFrames = additionalInflightTransfers * periodSizeInFrames;
+			Log() << additionalOutputLatencyInFrames << " samples added to output latency due to " << config.inflightTransfers << " inflight transfers";
+			*outputLatency += long(additionalOutputLatencyInFrames);
+		}
+		if (config.ioThread) {
+			// See RunCallbackThread(). In full duplex mode, the callback thread stays `ioThreadRingDepth` periods ahead of the I/O thread. In output-only mode, there
+			// is nothing to hold it back, so it runs as far ahead as the output ring allows, which includes the periods the I/O thread uses for priming.
+			const auto leadInPeriods = outputOnly ? config.inflightTransfers + config.ioThreadRingDepth : config.ioThreadRingDepth;
+			const auto additionalOutputLatencyInFrames = leadInPeriods * periodSizeInFrames;
+			Log() << additionalOutputLatencyInFrames << " samples added to output latency due to the separate I/O thread";
+			*outputLatency += long(additionalOutputLatencyInFrames);
+		}
+		if (!sampleRateRatio.IsIdentity()) {
+			const auto toHostFrames = [&](double deviceFrames) { return deviceFrames * double(sampleRateRatio.hostFrames) / double(sampleRateRatio.deviceFrames); };
+			Log() << "Converting latencies of " << *inputLatency << "/" << *outputLatency << " (input/output) device samples to " << sampleRate << " Hz";
+			// The resampler delays are fixed, so they can be reported exactly (rounded up to the next frame).
+			const auto inputResamplerDelayInFrames = sampleRateRatio.IsDecimation() ? GetDecimatorDelayInOutputFrames(sampleRateRatio.GetDecimationStageCount()) : GetResamplerDelayInOutputFrames(sampleRateRatio.hostFrames, sampleRateRatio.deviceFrames);
+			const auto outputResamplerDelayInFrames = toHostFrames(GetResamplerDelayInOutputFrames(sampleRateRatio.deviceFrames, sampleRateRatio.hostFrames));
+			Log() << inputResamplerDelayInFrames << "/" << outputResamplerDelayInFrames << " (input/output) samples added to latency due to resampling";
+			*inputLatency = long(std::ceil(toHostFrames(double(*inputLatency)) + inputResamplerDelayInFrames));
+			*outputLatency = long(std::ceil(toHostFrames(double(*outputLatency)) + outputResamplerDelayInFrames));
+		}
 		Log() << "Returning input latency of " << *inputLatency << " samples and output latency of " << *outputLatency << " samples";
 	}
 
@@ -568,13 +908,16 @@ namespace asio401 {
 	void ASIO401::PreparedState::Start()
 	{
 		if (runningState.has_value()) throw ASIOException(ASE_InvalidMode, "start() called twice");
+		if (asio401.GetSampleRateRatio(asio401.sampleRate) != streamingLayout.sampleRateRatio) throw ASIOException(ASE_InvalidMode, "start() called after a sample rate change that requires the buffers to be recreated");
 		runningState.emplace(*this);
 		runningState->Start();
 	}
 
 	ASIO401::PreparedState::RunningState::RunningState(PreparedState& preparedState) :
 		preparedState(preparedState),
+		stats(preparedState.asio401.streamingStats != nullptr ? &preparedState.asio401.streamingStats->Get() : nullptr),
 		sampleRate(preparedState.asio401.sampleRate),
+		deviceSampleRate(*preparedState.asio401.GetDeviceSampleRate(sampleRate)),
 		hostSupportsOutputReady(preparedState.asio401.hostSupportsOutputReady),
 		host_supports_timeinfo([&] {
 		Log() << "Checking if the host supports time info";
@@ -583,10 +926,32 @@ namespace asio401 {
 			Message(preparedState.callbacks.asioMessage, kAsioSupportsTimeInfo, 0, NULL, NULL) == 1;
 		Log() << "The host " << (result ? "supports" : "does not support") << " time info";
 		return result;
-	}()) {	}
+	}()),
+		hostSupportsOverload(preparedState.callbacks.asioMessage && Message(preparedState.callbacks.asioMessage, kAsioSelectorSupported, kAsioOverload, NULL, NULL) == 1),
+		hostSupportsResyncRequest(preparedState.callbacks.asioMessage && Message(preparedState.callbacks.asioMessage, kAsioSelectorSupported, kAsioResyncRequest, NULL, NULL) == 1),
+		outputReady(/*initiallySet=*/true, outputReadySpinCount) {
+		const auto& config = preparedState.asio401.config;
+		// The resamplers carry their state from one buffer to the next, but not from one stream to the next.
+		if (preparedState.outputResampler.has_value()) preparedState.outputResampler->Reset();
+		if (preparedState.inputResampler.has_value()) preparedState.inputResampler->Reset();
+		if (preparedState.inputDecimator.has_value()) preparedState.inputDecimator->Reset();
+		if (config.inputHighPassFilterHz.has_value()) {
+			Log() << "Applying order " << config.inputHighPassFilterOrder << " high-pass filter with cutoff frequency " << *config.inputHighPassFilterHz << " Hz to input channels";
+			inputHighPassFilter.emplace(SlotFilter<QA401::inputChannelCount>{
+				.biquad = config.inputHighPassFilterOrder == 1 ? GetFirstOrderHighPass(*config.inputHighPassFilterHz, sampleRate) : GetSecondOrderHighPass(*config.inputHighPassFilterHz, sampleRate),
+			});
+			if (std::ranges::any_of(preparedState.asio401.GetInputCalibration(), [](const SampleCalibration& calibration) { return calibration.offset != 0; }))
+				Log() << "Input calibration offsets are ignored, as the high-pass filter removes DC";
+		}
+		if (!config.ioThread) return;
+		if (!preparedState.streamingBuffers.outputRingBuffer.empty()) outputRing.emplace(preparedState.streamingBuffers.outputRingBuffer);
+		if (!preparedState.streamingBuffers.inputRingBuffer.empty()) inputRing.emplace(preparedState.streamingBuffers.inputRingBuffer);
+	}
 
 	ASIO401::PreparedState::RunningState::~RunningState() {
 		stopRequested = true;
+		// Unblock any thread that is waiting for OutputReady(). It will notice `stopRequested` right after.
+		outputReady.Set();
 		// Stop inflight I/O. If RunThread() is currently in an `Await()` call, it will immediately
 		// see ABORTED and exit faster than it would if it waited for the I/O to complete.
 		// If there is no inflight I/O, these are no-ops. We don't check first because that would require extra thread
@@ -594,78 +959,50 @@ namespace asio401 {
 		// This could end up racing against the same abort calls in the thread exit logic(), but this shouldn't be of any
 		// practical consequence.
 		Abort();
-		thread.join();
-	}
-
-	template <QA40x::ChannelType channelType>
-	ASIO401::PreparedState::RunningState::QA40xBuffer<channelType>::QA40xBuffer(size_t size) : buffer(size) {
-		assert(!buffer.empty());
-	}
-
-	template <QA40x::ChannelType channelType>
-	std::span<std::byte> ASIO401::PreparedState::RunningState::QA40xBuffer<channelType>::data() {
-		assert(!ioSlot.HasPending());
-		return buffer;
-	}
-
-	template <QA40x::ChannelType channelType>
-	std::span<const std::byte> ASIO401::PreparedState::RunningState::QA40xBuffer<channelType>::data() const {
-		assert(!ioSlot.HasPending());
-		return buffer;
+		CloseRings();
+		preparedState.streamingThread.Wait();
+		if (preparedState.callbackThread.has_value()) preparedState.callbackThread->Wait();
 	}
 
 	void ASIO401::PreparedState::RunningState::RunningState::RunThread() noexcept {
 		bool resetRequestIssued = false;
 		auto requestReset = [&]() noexcept {
 			resetRequestIssued = true;
+			if (stats != nullptr) stats->resetRequestCount.fetch_add(1, std::memory_order_relaxed);
 			try {
 				preparedState.RequestReset();
 			} catch (...) {}
 		};
 
-		const auto writeFrameSizeInBytes = preparedState.asio401.GetDeviceOutputChannelCount() * preparedState.buffers.outputSampleSizeInBytes;
-		const auto readFrameSizeInBytes = preparedState.asio401.GetDeviceInputChannelCount() * preparedState.buffers.inputSampleSizeInBytes;
-		const auto mustPlay = preparedState.buffers.outputChannelCount > 0;
-		const auto mustRecord = preparedState.buffers.inputChannelCount > 0;
-		const auto mustRead = mustRecord || preparedState.asio401.config.forceRead;
-		const auto mustMaintainSync = mustPlay && mustRead;
-		const auto initialInputGarbageInFrames = preparedState.asio401.WithDevice(
-			[&](QA401&) {
-				// As described in https://github.com/dechamps/ASIO401/issues/5, the QA401 will initially replay the last 64 frames of input.
-				// After that, the QA401 produces about 1000 frames of silence, regardless of sample rate.
-				// (Note the read still takes about the same amount of time to complete, so time sync appears to bemaintained
-				// throughout - it's as if we're actually recording, but the data gets mangled before it's delivered to us.)
-				// Note: using 1056 (1024 + 32) should work in theory, but in practice it seems like the QA401 DAC doesn't like
-				// playing a buffer that is not 64-frame aligned followed by a buffer that is 64-frame aligned (even though the
-				// QA401 minimum write granularity is supposed to be 32 frames) so let's align that one to 64 frames to be safe.
-				return 1088u;
-			},
-			[&](QA403&) { return 0u; }
-		);
-		const auto outputQueueStartThresholdInFrames = preparedState.asio401.WithDevice(
-			[&](QA401&) { return 1u; }, // The QA401 will start as soon as at least 1 frame is written to it.
-			[&](QA403&) { return QA403::hardwareQueueSizeInFrames; } // The QA403 will only start once its internal queue has been filled.
-		);
-		const auto initialGarbageToSkipFrames = mustRecord ? initialInputGarbageInFrames : 0;
-		const auto steadyStateWriteSizeInFrames = mustPlay ? preparedState.buffers.bufferSizeInFrames : 0;
-		const auto steadyStateReadSizeInFrames = mustRead ? preparedState.buffers.bufferSizeInFrames : 0;
-		const auto firstWriteSizeInFrames = [&] {
-			auto firstWriteSizeInFrames = (mustMaintainSync ? initialGarbageToSkipFrames : 0) + steadyStateWriteSizeInFrames;
-			// At the beginning we send two buffers before waiting, so the total initial playback queue is the sum of both the initial buffer and that additional buffer.
-			const auto initialPlaybackQueueInFrames = firstWriteSizeInFrames + steadyStateWriteSizeInFrames;
-			// Make sure the initial playback queue is enough to trigger the hardware to start; otherwise, we'll want to pad it with silence until it does.
-			// Technically we could keep asking the host application for more buffers until we fill the queue, but that would likely make the logic vastly
-			// more complex, and things would likely become awkward if things don't align with the ASIO buffer size. Also, it's atypical for an ASIO driver
-			// to ask for more then 2 buffers before starting.
-			if (outputQueueStartThresholdInFrames > initialPlaybackQueueInFrames) firstWriteSizeInFrames += outputQueueStartThresholdInFrames - initialPlaybackQueueInFrames;
-			return firstWriteSizeInFrames;
-		}();
-		const auto firstReadSizeInFrames = mustRead ? (std::max)(initialInputGarbageInFrames + steadyStateReadSizeInFrames, mustMaintainSync ? firstWriteSizeInFrames : 0) : 0;
-		assert(firstWriteSizeInFrames >= steadyStateWriteSizeInFrames);
-		assert(firstReadSizeInFrames >= steadyStateReadSizeInFrames);
+		const auto& streamingLayout = preparedState.streamingLayout;
+		const auto writeFrameSizeInBytes = streamingLayout.writeFrameSizeInBytes;
+		const auto readFrameSizeInBytes = streamingLayout.readFrameSizeInBytes;
+		const auto mustPlay = streamingLayout.mustPlay;
+		const auto mustRecord = streamingLayout.mustRecord;
+		const auto mustRead = streamingLayout.mustRead;
+		// If true, this thread only deals with USB I/O, and the ASIO host application is serviced by RunCallbackThread() instead. The two threads exchange
+		// device-format data through the output and input rings, which take the place of the ASIO buffers in this function. See RunCallbackThread().
+		const auto separateCallbackThread = preparedState.asio401.config.ioThread;
+		// Note: this is in device frames, as are all frame counts and positions in this function, except for the sample position. See GetSampleRateRatio().
+		const auto asioBufferSizeInFrames = streamingLayout.asioBufferSizeInDeviceFrames;
+		// A "period" is the group of consecutive ASIO buffers that is streamed as a unit. It is a single ASIO buffer unless small ASIO buffers are
+		// coalesced. Each period is streamed as one or more USB transfers; more than one if large ASIO buffers are split. See ComputeUsbTransferLayout().
+		const auto& usbTransferLayout = streamingLayout.usbTransferLayout;
+		const auto periodSizeInFrames = usbTransferLayout.asioBuffersPerPeriod * asioBufferSizeInFrames;
+		// Returns the range of frames that the given transfer covers within its period.
+		const auto getTransferFrameRange = [&](uint64_t transferIndex) {
+			const auto begin = size_t(transferIndex % usbTransferLayout.transfersPerPeriod) * usbTransferLayout.transferSizeInFrames;
+			return std::make_pair(begin, (std::min)(begin + usbTransferLayout.transferSizeInFrames, periodSizeInFrames));
+		};
+		// Returns the position of the end of the given transfer in the stream, not counting the prefixes.
+		const auto getTransferEndFramePosition = [&](uint64_t transferIndex) {
+			return int64_t(transferIndex / usbTransferLayout.transfersPerPeriod * periodSizeInFrames + getTransferFrameRange(transferIndex).second);
+		};
+		const auto prefixWriteSizeInFrames = streamingLayout.prefixWriteSizeInFrames;
+		const auto prefixReadSizeInFrames = streamingLayout.prefixReadSizeInFrames;
 
 		// QA40x (more technically, WinUSB) supports multiple concurrent I/O requests on a given channel. The requests are serviced in the order they are started.
-		// We use this capability to try to keep two buffers in flight to/from the hardware at any given time.
+		// We use this capability to try to keep multiple periods (two by default, see the `inflightTransfers` option) in flight to/from the hardware at any given time.
 		// Compared to only using one buffer per channel, this is a performance optimization. If we only used one buffer, then
 		// when an I/O completes there would be nothing in flight on the USB bus. This means the only buffer preventing an underrun/overflow
 		// would be the QA40x internal hardware buffer, which is quite small: only 2.7 ms at 384 kHz. This in turn means that when an I/O
@@ -674,24 +1011,20 @@ namespace asio401 {
 		// In contrast, if we start the next I/O before the current one completes, then when the current I/O eventually completes the WinUSB stack can
 		// directly send the next one without having to get back to this code first. (In practice, it has been observed that the process doesn't even
 		// get woken up when that happens, suggesting the round-trip happens completely in kernel mode, perhaps even in the USB host hardware itself.)
-		std::array<std::optional<QA40xBuffer<QA40x::ChannelType::WRITE>>, 2> writeBuffers;
-		std::array<std::optional<QA40xBuffer<QA40x::ChannelType::READ>>, 2> readBuffers;
-		{
-			const auto maybeAllocateBuffer = [&](auto& optionalBuffer, size_t size) {
-				if (size > 0) optionalBuffer.emplace(size);
-			};
-			maybeAllocateBuffer(writeBuffers.front(), (std::max)(firstWriteSizeInFrames, steadyStateWriteSizeInFrames) * writeFrameSizeInBytes);
-			maybeAllocateBuffer(writeBuffers.back(), steadyStateWriteSizeInFrames * writeFrameSizeInBytes);
-			maybeAllocateBuffer(readBuffers.front(), (std::max)(firstReadSizeInFrames, steadyStateReadSizeInFrames) * readFrameSizeInBytes);
-			maybeAllocateBuffer(readBuffers.back(), steadyStateReadSizeInFrames * readFrameSizeInBytes);
-		}
-		assert(!writeBuffers.back().has_value() || writeBuffers.front().has_value());
-		assert(!readBuffers.back().has_value() || readBuffers.front().has_value());
-		assert(!writeBuffers.back().has_value() || mustPlay);
-		assert((!readBuffers.front().has_value() && !readBuffers.back().has_value()) || mustRead);
+		// There is one buffer (I/O slot) per USB transfer. Transfers are assigned to slots in a round-robin fashion, i.e. the slots form a ring.
+		// The buffers are allocated in advance by PreparedState, so that starting the stream doesn't involve any memory allocation.
+		const auto transferSlotCount = streamingLayout.transferSlotCount;
+		auto& writeBuffers = preparedState.streamingBuffers.writeBuffers;
+		auto& readBuffers = preparedState.streamingBuffers.readBuffers;
+		auto& prefixWriteBuffer = preparedState.streamingBuffers.prefixWriteBuffer;
+		auto& prefixReadBuffer = preparedState.streamingBuffers.prefixReadBuffer;
+		assert(std::ranges::all_of(writeBuffers, [&](const std::optional<QA40xBuffer<QA40x::ChannelType::WRITE>>& buffer) { return buffer.has_value() == mustPlay; }));
 		assert(std::ranges::all_of(readBuffers, [&](const std::optional<QA40xBuffer<QA40x::ChannelType::READ>>& buffer) { return buffer.has_value() == mustRead; }));
-
-		size_t writeBufferIndex = 0, readBufferIndex = 0;
+		// Even if we don't want to play anything, we still have to do at least one write to start the hardware, otherwise the first read will just hang forever.
+		assert(mustPlay || prefixWriteBuffer.has_value());
+		Log() << "Streaming periods of " << usbTransferLayout.asioBuffersPerPeriod << " ASIO buffer(s) in " << usbTransferLayout.transfersPerPeriod << " USB transfer(s) of up to "
+			<< usbTransferLayout.transferSizeInFrames << " frames, using " << transferSlotCount << " I/O slots per direction; prefix write: "
+			<< prefixWriteSizeInFrames << " frames, prefix read: " << prefixReadSizeInFrames << " frames";
 
 		struct StopRequested final {};
 		// We abuse exception handling to process stop requests - this is a bit shameful but it does make the code more straightforward.
@@ -702,267 +1035,710 @@ namespace asio401 {
 			}
 		};
 
-		const auto awaitQa40xOperation = [&](auto& buffers, size_t bufferIndex, std::string_view operationName) {
-			if (IsLoggingEnabled()) Log() << "Awaiting " << operationName << " I/O slot index " << readBufferIndex;
+		const auto awaitQa40xOperation = [&](auto& buffer, std::string_view operationName) {
+			if (IsLoggingEnabled()) Log() << "Awaiting " << operationName << " I/O slot " << &buffer;
 			// We may have been asked to stop before this I/O was started. In that case `Await()` will unnecessarily block instead of immediately returning ABORTED.
 			checkStopRequested();
-			if (buffers[bufferIndex]->GetIoSlot().Await() == QA40x::AwaitResult::ABORTED) {
+			if (buffer.GetIoSlot().Await() == QA40x::AwaitResult::ABORTED) {
 				checkStopRequested();
-				throw new std::runtime_error("QA40x I/O was unexpectedly aborted");
+				throw std::runtime_error("QA40x I/O was unexpectedly aborted");
+			}
+		};
+		const auto throwRingClosed = [&] {
+			checkStopRequested();
+			throw std::runtime_error("Callback thread stopped unexpectedly");
+		};
+		const auto popOutputRing = [&](const std::span<std::byte> destination) {
+			if (!outputRing->WaitUntilReadable(destination.size())) throwRingClosed();
+			auto destinationIterator = destination.begin();
+			for (const auto region : outputRing->GetReadRegions(destination.size())) destinationIterator = std::ranges::copy(region, destinationIterator).out;
+			outputRing->CommitRead(destination.size());
+		};
+		const auto pushInputRing = [&](const std::span<const std::byte> source) {
+			if (!inputRing->WaitUntilWritable(source.size())) throwRingClosed();
+			auto sourceIterator = source.begin();
+			for (const auto region : inputRing->GetWriteRegions(source.size())) {
+				std::copy_n(sourceIterator, region.size(), region.begin());
+				sourceIterator += region.size();
 			}
+			inputRing->CommitWrite(source.size());
 		};
-		const auto awaitQa40xWrite = [&] { return awaitQa40xOperation(writeBuffers, writeBufferIndex, "write"); };
-		const auto awaitQa40xRead = [&] { return awaitQa40xOperation(readBuffers, readBufferIndex, "read"); };
-		const auto startQa40xOperation = [&](auto& buffers, size_t& bufferIndex, size_t nextSizeInBytes, auto channel, std::string_view operationName) {
-			if (IsLoggingEnabled()) Log() << "Starting new " << operationName << " I/O of size " << nextSizeInBytes << " bytes in slot index " << bufferIndex;
-			auto& buffer = *buffers[bufferIndex];;
-			buffer.GetIoSlot().Start(channel, std::span(buffer.data()).first(nextSizeInBytes));
-			bufferIndex = (bufferIndex + 1) % buffers.size();
+		const auto startQa40xOperation = [&](auto& buffer, size_t sizeInBytes, auto channel, std::string_view operationName) {
+			if (IsLoggingEnabled()) Log() << "Starting new " << operationName << " I/O of size " << sizeInBytes << " bytes in slot " << &buffer;
+			buffer.GetIoSlot().Start(channel, std::span(buffer.data()).first(sizeInBytes));
 		};
-		const auto startQa40xWrite = [&](size_t sizeInBytes) {
-			return startQa40xOperation(writeBuffers, writeBufferIndex, sizeInBytes, preparedState.asio401.WithDevice([&](auto& device) { return device.GetWriteChannel(); }), "write");
+		const auto startQa40xWrite = [&](QA40xBuffer<QA40x::ChannelType::WRITE>& buffer, size_t sizeInBytes) {
+			return startQa40xOperation(buffer, sizeInBytes, preparedState.asio401.WithDevice([&](auto& device) { return device.GetWriteChannel(); }), "write");
 		};
-		const auto startQa40xRead = [&](size_t sizeInBytes) {
-			return startQa40xOperation(readBuffers, readBufferIndex, sizeInBytes, preparedState.asio401.WithDevice([&](auto& device) { return device.GetReadChannel(); }), "read");
+		const auto startQa40xRead = [&](QA40xBuffer<QA40x::ChannelType::READ>& buffer, size_t sizeInBytes) {
+			return startQa40xOperation(buffer, sizeInBytes, preparedState.asio401.WithDevice([&](auto& device) { return device.GetReadChannel(); }), "read");
 		};
 
 		Win32HighResolutionTimer win32HighResolutionTimer;
 		// Note: Reset() calls are done under high priority, because the internal timing of the reset procedure is somewhat important to avoid https://github.com/dechamps/ASIO401/issues/9
 		AvrtHighPriority avrtHighPriority;
 
-		try {
-			SetupDevice();
-
-			// Note: see ../dechamps_ASIOUtil/BUFFERS.md for an explanation of ASIO buffer management and operation order.
-			const auto asioBufferSizeInBytes = preparedState.buffers.bufferSizeInFrames * writeFrameSizeInBytes;
-			bool firstWriteStarted = false, firstReadStarted = false, recordedFirstBuffer = false, primed = false;
-			size_t withheldOutputBuffers = 0;
-			SamplePosition currentSamplePosition;
+		ClockEstimator clockEstimator(deviceSampleRate, {});
 
-			const auto recordTimestamp = [&] {
-				currentSamplePosition.timestamp = ::dechamps_ASIOUtil::Int64ToASIO<ASIOTimeStamp>(((long long int) win32HighResolutionTimer.GetTimeMilliseconds()) * 1000000);
-			};
-			const auto startSending = [&] {
-				if (IsLoggingEnabled()) Log() << "Starting a write from QA40x buffer index " << writeBufferIndex;
-				const auto sizeInFrames = firstWriteStarted ? asioBufferSizeInBytes : firstWriteSizeInFrames * writeFrameSizeInBytes;
-				assert(sizeInFrames % preparedState.asio401.GetDeviceWriteGranularityInFrames() == 0);
-				startQa40xWrite(sizeInFrames);
-				firstWriteStarted = true;
-			};
-			const auto finishSending = [&] {
-				if (IsLoggingEnabled()) Log() << "Waiting for QA40x write buffer index " << writeBufferIndex << " to complete";
-				awaitQa40xWrite();
-				if (!mustRead) {
-					// If we can't use reads to get timing information, write completion events are the next best thing.
-					recordTimestamp();
-				}
-			};
-			const auto startReceiving = [&] {
-				if (IsLoggingEnabled()) Log() << "Starting a read into QA40x buffer index " << readBufferIndex;
-				assert(mustRead);
-				startQa40xRead(firstReadStarted ? asioBufferSizeInBytes : firstReadSizeInFrames * readFrameSizeInBytes);
-				firstReadStarted = true;
-			};
-			const auto finishReceiving = [&] {
-				if (IsLoggingEnabled()) Log() << "Waiting for read into buffer index " << readBufferIndex << " to complete";
-				assert(mustRead);
-				awaitQa40xRead();
-				// The most precise timing is given by the read completion event, so record the current time before we do anything else.
-				recordTimestamp();
+		// Lets the ASIO host application know that the stream glitched, if it supports being told.
+		const auto notifyHostOfDiscontinuity = [&] {
+			if (hostSupportsOverload) Message(preparedState.callbacks.asioMessage, kAsioOverload, 0, NULL, NULL);
+			// Timestamps reported before and after the discontinuity are not consistent with each other anymore.
+			if (hostSupportsResyncRequest) Message(preparedState.callbacks.asioMessage, kAsioResyncRequest, 0, NULL, NULL);
+		};
+		const auto abortAndAwaitPendingIo = [&] {
+			// ~RunningState() may already be calling `Abort()` at the same time, but that shouldn't
+			// matter - whomever gets there first will trigger the abort and the second call should
+			// be a no-op.
+			Abort();
+			const auto awaitIfPending = [](auto& buffer) {
+				if (buffer.has_value() && buffer->GetIoSlot().HasPending()) (void) buffer->GetIoSlot().Await();
 			};
+			awaitIfPending(prefixReadBuffer);
+			for (auto& readBuffer : readBuffers) awaitIfPending(readBuffer);
+			awaitIfPending(prefixWriteBuffer);
+			for (auto& writeBuffer : writeBuffers) awaitIfPending(writeBuffer);
+			if (stats != nullptr) {
+				stats->inflightWrites.store(0, std::memory_order_relaxed);
+				stats->inflightReads.store(0, std::memory_order_relaxed);
+			}
+		};
 
-			if (mustRead) {
-				// We can set up the initial reads at any time up until we actually need the data.
-				// These reads will not complete until the hardware actually starts (i.e.
-				// `outputQueueStartThresholdInFrames` frames have been written), so might as well
-				// set this up now and we'll be ready when that happens.
-				if (IsLoggingEnabled()) Log() << "Starting initial reads";
-				for (const auto& readBuffer : readBuffers) startReceiving();
+		// A transient USB error in the middle of a stream (e.g. a failed or aborted transfer) does not have to be the end of it. Instead of asking the
+		// ASIO host application to reset, which typically means a failed measurement, we start the stream over from scratch while the host application
+		// keeps running: abort all transfers, reset the device, and prime it again. The host application simply sees the stream continue, with a gap in
+		// the audio: the input buffers it gets while the stream is primed again are silent. The sample position carries on from where it was, because it counts the buffers that
+		// were exchanged with the host application. Only if errors keep happening do we give up and request a reset. See the `recoveryLimit` option.
+		// This is not supported if the `ioThread` option is enabled, because RunCallbackThread() would have to be brought back in sync.
+		SamplePosition currentSamplePosition;
+		// True once the stream has been primed at least once. If the stream never got that far, the problem is unlikely to be transient.
+		bool streamingEstablished = false;
+		// The recoveries that began within the `recoveryWindowSeconds` window are the `recentRecoveryCount` entries of `recoveryBeginTimes` starting at
+		// `oldestRecentRecovery`, wrapping around.
+		auto& recoveryBeginTimes = preparedState.recoveryBeginTimes;
+		size_t oldestRecentRecovery = 0;
+		size_t recentRecoveryCount = 0;
+		// Set while a recovery is in progress. If recovery fails and is attempted again, this is still the time of the original error.
+		std::optional<int64_t> recoveryBeginNanoseconds;
+		const auto recover = [&]() noexcept {
+			if (!streamingEstablished) {
+				Log() << "Streaming was never established, not attempting to recover";
+				return false;
 			}
-			recordTimestamp();
-			for (long asioBufferIndex = 0; ; asioBufferIndex = (asioBufferIndex + 1) % 2) {
-				const auto asioToQa40xWithheld = [&] {
-					// The loop is structured in such a way that the ASIO buffer that is ready to send is the
-					// *opposite* buffer from the one given by `asioBufferIndex`.
-					const auto outputAsioBufferIndex = (asioBufferIndex + 1) % 2;
-					assert(withheldOutputBuffers < writeBuffers.size());
-					const bool firstWrite = !firstWriteStarted && withheldOutputBuffers == 0;
-					const auto bufferIndex = (writeBufferIndex + withheldOutputBuffers) % 2;
-					++withheldOutputBuffers;
-					if (IsLoggingEnabled()) Log() << "About to copy data from ASIO buffer index " << outputAsioBufferIndex << " to QA40x write buffer index " << bufferIndex << (firstWrite ? " (first write)" : "");
-					assert(mustPlay);
-					const bool invertPolarity = preparedState.asio401.WithDevice(
-						[&](const QA401&) { return true; }, // https://github.com/dechamps/ASIO401/issues/14
-						[&](const QA403&) { return false; }
-					);
-					PreProcessASIOOutputBuffers(preparedState.bufferInfos, outputAsioBufferIndex, preparedState.buffers.bufferSizeInFrames, preparedState.asio401.GetDeviceSampleSizeInBytes(), preparedState.asio401.GetDeviceSampleEndianness(), invertPolarity);
-					auto& writeBuffer = *writeBuffers[bufferIndex];
-					if (writeBuffer.GetIoSlot().HasPending()) {
-						assert(bufferIndex == writeBufferIndex);
-						finishSending();
+			if (separateCallbackThread) {
+				Log() << "Recovering the stream is not supported with a separate I/O thread";
+				return false;
+			}
+			const auto& config = preparedState.asio401.config;
+			if (config.recoveryLimit == 0) {
+				Log() << "Stream recovery is disabled";
+				return false;
+			}
+			const auto nowNanoseconds = preparedState.clock.GetTimeNanoseconds();
+			while (recentRecoveryCount > 0 && double(nowNanoseconds - recoveryBeginTimes[oldestRecentRecovery]) > config.recoveryWindowSeconds * 1e9) {
+				oldestRecentRecovery = (oldestRecentRecovery + 1) % recoveryBeginTimes.size();
+				--recentRecoveryCount;
+			}
+			if (recentRecoveryCount >= recoveryBeginTimes.size()) {
+				Log() << "Already attempted " << recentRecoveryCount << " recoveries in the last " << config.recoveryWindowSeconds << " seconds, giving up";
+				return false;
+			}
+			recoveryBeginTimes[(oldestRecentRecovery + recentRecoveryCount) % recoveryBeginTimes.size()] = nowNanoseconds;
+			++recentRecoveryCount;
+			Log() << "Attempting to recover the stream (attempt " << recentRecoveryCount << " of " << config.recoveryLimit << " allowed in " << config.recoveryWindowSeconds << " seconds)";
+			Trace(TraceEvent::RECOVERY_BEGIN, int64_t(recentRecoveryCount));
+			if (stats != nullptr) stats->recoveryCount.fetch_add(1, std::memory_order_relaxed);
+			if (!recoveryBeginNanoseconds.has_value()) recoveryBeginNanoseconds = nowNanoseconds;
+			try {
+				abortAndAwaitPendingIo();
+			}
+			catch (const std::exception& exception) {
+				Log() << "Unable to abort pending I/O: " << exception.what();
+				return false;
+			}
+			// The device will be reset by SetupDevice(), since the device is not left warm. Transfer indices, and therefore frame positions, start over.
+			clockEstimator.Restart();
+			// Input frames from before the recovery are not contiguous with the ones that come after.
+			if (preparedState.inputResampler.has_value()) preparedState.inputResampler->Reset();
+			if (preparedState.inputDecimator.has_value()) preparedState.inputDecimator->Reset();
+			if (inputHighPassFilter.has_value()) {
+				inputHighPassFilter->z1 = {};
+				inputHighPassFilter->z2 = {};
+			}
+			// While the stream is primed again, the host application is handed the input ASIO buffers without any new input having been copied into
+			// them. Make sure that gap is silence, not a repeat of the last input from before the error. (All sample types use zero for silence.)
+			// There is no input ring to clear, since recovery is not attempted with a separate I/O thread.
+			assert(!inputRing.has_value());
+			auto& buffers = preparedState.buffers;
+			for (size_t bufferSetIndex = 0; bufferSetIndex < buffers.bufferSetCount; ++bufferSetIndex)
+				std::fill_n(buffers.GetInputBuffer(bufferSetIndex, 0), buffers.inputChannelCount * buffers.GetInputBufferSizeInBytes(), std::byte(0));
+			return true;
+		};
+
+		for (;;) {
+			try {
+				preparedState.SetupDevice(deviceSampleRate);
+				if (!recoveryBeginNanoseconds.has_value()) {
+					Trace(TraceEvent::STREAM_START, int64_t(sampleRate));
+					if (stats != nullptr) {
+						stats->sampleRate.store(uint64_t(sampleRate), std::memory_order_relaxed);
+						stats->bufferSizeInFrames.store(preparedState.buffers.bufferSizeInFrames, std::memory_order_relaxed);
+						stats->streamCount.fetch_add(1, std::memory_order_relaxed);
+						stats->running.store(1, std::memory_order_relaxed);
 					}
-					const auto data = writeBuffer.data();
-					CopyToQA40xBuffer(
-						preparedState.bufferInfos,
-						preparedState.buffers.bufferSizeInFrames,
-						outputAsioBufferIndex,
-						firstWrite ? data.last(asioBufferSizeInBytes) : data.first(asioBufferSizeInBytes),
-						preparedState.asio401.GetDeviceOutputChannelCount(),
-						preparedState.asio401.GetDeviceSampleSizeInBytes());
+				}
+
+				// Note: see ../dechamps_ASIOUtil/BUFFERS.md for an explanation of ASIO buffer management and operation order.
+				bool firstWriteStarted = false, primed = false;
+				// Transfers are numbered in stream order, not counting the prefixes. The I/O slot used by a transfer is its number modulo the number of slots.
+				// "Withheld" writes are writes that are complete (i.e. filled with output data) but have not been started yet.
+				uint64_t outputAsioBufferCount = 0, inputAsioBufferCount = 0;
+				uint64_t nextWriteTransferIndex = 0, nextReadTransferToConsumeIndex = 0, nextReadTransferToAwaitIndex = 0, nextReadTransferToStartIndex = 0;
+				size_t withheldWrites = 0;
+
+				const auto getTimestampNanoseconds = [&] {
+					return preparedState.clock.GetTimeNanoseconds();
 				};
-				const auto writeWithheldOutputBuffers = [&] {
-					if (IsLoggingEnabled()) Log() << "Issuing " << withheldOutputBuffers << " withheld writes";
-					for (; withheldOutputBuffers > 0; --withheldOutputBuffers) startSending();
+				// Called when the clock estimator concludes that frames were lost (if positive) or repeated (if negative). This typically means this thread
+				// fell behind for long enough that the QA40x hardware buffer overflowed or underflowed. There is nothing we can do to get the lost frames
+				// back; we just make sure everyone knows the stream glitched, and carry on. The sample position is not adjusted: it counts the frames that
+				// were exchanged with the ASIO host application, not the frames that the device clock ticked through.
+				const auto reportDiscontinuity = [&](int64_t discontinuityNanoseconds) {
+					const auto discontinuityFrames = std::llround(double(discontinuityNanoseconds) * deviceSampleRate / 1e9);
+					Log() << "WARNING: stream discontinuity detected: approximately " << std::abs(discontinuityFrames) << " frames were " << (discontinuityFrames >= 0 ? "lost" : "repeated")
+						<< " (timing was off by " << double(discontinuityNanoseconds) / 1e6 << " ms)";
+					Trace(TraceEvent::DISCONTINUITY, discontinuityFrames);
+					if (stats != nullptr) {
+						stats->discontinuityCount.fetch_add(1, std::memory_order_relaxed);
+						(discontinuityFrames >= 0 ? stats->lostFrameCount : stats->repeatedFrameCount).fetch_add(uint64_t(std::abs(discontinuityFrames)), std::memory_order_relaxed);
+					}
+					notifyHostOfDiscontinuity();
 				};
-
-				const auto qa40xToAsio = [&] {
-					if (IsLoggingEnabled()) Log() << "About to copy data from QA40x read buffer index " << readBufferIndex << " to ASIO buffer index " << asioBufferIndex << (recordedFirstBuffer ? "" : " (first read)");
-					assert(mustRecord);
-					finishReceiving();
-					const bool swapChannels = preparedState.asio401.WithDevice(
-						[&](const QA401&) { return true; }, // https://github.com/dechamps/ASIO401/issues/13
-						[&](const QA403&) { return false; });
-					const auto data = readBuffers[readBufferIndex]->data();
-					CopyFromQA40xBuffer(
-						preparedState.bufferInfos,
-						preparedState.buffers.bufferSizeInFrames,
-						asioBufferIndex,
-						recordedFirstBuffer ? data.first(asioBufferSizeInBytes) : data.last(asioBufferSizeInBytes),
-						preparedState.asio401.GetDeviceInputChannelCount(),
-						preparedState.asio401.GetDeviceSampleSizeInBytes(),
-						swapChannels);
-					startReceiving();
-					PostProcessASIOInputBuffers(preparedState.bufferInfos, asioBufferIndex, preparedState.buffers.bufferSizeInFrames, preparedState.asio401.GetDeviceSampleSizeInBytes(), preparedState.asio401.GetDeviceSampleEndianness());
-					recordedFirstBuffer = true;
+				// Note that the clock estimator uses input frame positions if we are reading, and output frame positions otherwise.
+				const auto updateClockEstimate = [&](int64_t framePosition, int64_t timestampNanoseconds) {
+					if (stats != nullptr)
+						if (const auto estimate = clockEstimator.GetEstimate(); estimate.has_value())
+							stats->completionLateness.Record(timestampNanoseconds - estimate->GetTimeNanoseconds(framePosition));
+					const auto discontinuityNanoseconds = clockEstimator.Update(framePosition, timestampNanoseconds);
+					if (separateCallbackThread) clockEstimate.Store(clockEstimator.GetEstimate());
+					if (discontinuityNanoseconds.has_value()) reportDiscontinuity(*discontinuityNanoseconds);
+				};
+				const auto recordTimestamp = [&](long long int timestampNanoseconds) {
+					currentSamplePosition.timestamp = ::dechamps_ASIOUtil::Int64ToASIO<ASIOTimeStamp>(timestampNanoseconds);
+				};
+				// For tracing purposes. The prefix transfers are identified by a negative transfer index.
+				constexpr int64_t prefixTransferIndex = -1;
+				const auto getTransferSlotIndex = [&](int64_t transferIndex) {
+					return transferIndex < 0 ? -1 : int64_t(uint64_t(transferIndex) % transferSlotCount);
+				};
+				const auto startSending = [&](QA40xBuffer<QA40x::ChannelType::WRITE>& buffer, size_t sizeInFrames, int64_t transferIndex) {
+					if (IsLoggingEnabled()) Log() << "Starting a write of " << sizeInFrames << " frames from QA40x write slot " << &buffer;
+					assert(sizeInFrames % preparedState.asio401.GetDeviceWriteGranularityInFrames() == 0);
+					Trace(TraceEvent::WRITE_START, transferIndex, getTransferSlotIndex(transferIndex));
+					// Writes are withheld until we are primed, so this only excludes the prefix write, which is never awaited while streaming anyway.
+					buffer.GetIoTimes() = { .startNanoseconds = primed ? std::optional(getTimestampNanoseconds()) : std::nullopt };
+					if (stats != nullptr) stats->inflightWrites.fetch_add(1, std::memory_order_relaxed);
+					startQa40xWrite(buffer, sizeInFrames * writeFrameSizeInBytes);
+					firstWriteStarted = true;
+				};
+				const auto finishSending = [&](QA40xBuffer<QA40x::ChannelType::WRITE>& buffer, int64_t endFramePosition, int64_t transferIndex) {
+					if (IsLoggingEnabled()) Log() << "Waiting for QA40x write slot " << &buffer << " to complete";
+					awaitQa40xOperation(buffer, "write");
+					const auto completionTimestampNanoseconds = getTimestampNanoseconds();
+					Trace(TraceEvent::WRITE_COMPLETE, transferIndex, getTransferSlotIndex(transferIndex));
+					if (stats != nullptr) {
+						stats->inflightWrites.fetch_sub(1, std::memory_order_relaxed);
+						stats->writeCount.fetch_add(1, std::memory_order_relaxed);
+						if (const auto startNanoseconds = buffer.GetIoTimes().startNanoseconds; startNanoseconds.has_value())
+							stats->writeLatency.Record(completionTimestampNanoseconds - *startNanoseconds);
+					}
+					if (!mustRead) {
+						// If we can't use reads to get timing information, write completion events are the next best thing.
+						updateClockEstimate(endFramePosition, completionTimestampNanoseconds);
+						recordTimestamp(clockEstimator.GetEstimate()->GetTimeNanoseconds(endFramePosition));
+					}
+				};
+				const auto startReceiving = [&] {
+					assert(mustRead);
+					const auto [transferBegin, transferEnd] = getTransferFrameRange(nextReadTransferToStartIndex);
+					auto& readBuffer = *readBuffers[nextReadTransferToStartIndex % readBuffers.size()];
+					if (IsLoggingEnabled()) Log() << "Starting a read of " << transferEnd - transferBegin << " frames into QA40x read slot " << &readBuffer;
+					Trace(TraceEvent::READ_START, int64_t(nextReadTransferToStartIndex), getTransferSlotIndex(int64_t(nextReadTransferToStartIndex)));
+					// Reads started before we are primed are excluded, as they include the time it takes for the hardware to start.
+					const auto startTimestampNanoseconds = getTimestampNanoseconds();
+					if (stats != nullptr) {
+						if (const auto completionNanoseconds = readBuffer.GetIoTimes().completionNanoseconds; primed && completionNanoseconds.has_value())
+							stats->readTurnaround.Record(startTimestampNanoseconds - *completionNanoseconds);
+						stats->inflightReads.fetch_add(1, std::memory_order_relaxed);
+					}
+					readBuffer.GetIoTimes() = { .startNanoseconds = primed ? std::optional(startTimestampNanoseconds) : std::nullopt };
+					startQa40xRead(readBuffer, (transferEnd - transferBegin) * readFrameSizeInBytes);
+					++nextReadTransferToStartIndex;
+				};
+				const auto finishReceiving = [&](QA40xBuffer<QA40x::ChannelType::READ>& buffer, int64_t endFramePosition, int64_t transferIndex) {
+					if (IsLoggingEnabled()) Log() << "Waiting for read into QA40x read slot " << &buffer << " to complete";
+					assert(mustRead);
+					awaitQa40xOperation(buffer, "read");
+					// The most precise timing is given by the read completion event, so record the current time before we do anything else.
+					const auto completionTimestampNanoseconds = getTimestampNanoseconds();
+					updateClockEstimate(endFramePosition, completionTimestampNanoseconds);
+					Trace(TraceEvent::READ_COMPLETE, transferIndex, getTransferSlotIndex(transferIndex));
+					if (stats != nullptr) {
+						stats->inflightReads.fetch_sub(1, std::memory_order_relaxed);
+						stats->readCount.fetch_add(1, std::memory_order_relaxed);
+						if (const auto startNanoseconds = buffer.GetIoTimes().startNanoseconds; startNanoseconds.has_value())
+							stats->readLatency.Record(completionTimestampNanoseconds - *startNanoseconds);
+					}
+					buffer.GetIoTimes().completionNanoseconds = completionTimestampNanoseconds;
 				};
 
-				if (mustPlay && hostSupportsOutputReady) {
-					// We only wait for OutputReady() after we've called bufferSwitch() at least once. In theory it *may*
-					// be pedentically correct to require the host application to call OutputReady() after Start() returns
-					// but before the first bufferSwitch() call is made, but in practice it's likely many applications
-					// won't do that.
-					if (!firstWriteStarted) {
-						std::unique_lock outputReadyLock(outputReadyMutex);
-						if (!outputReady) {
+				if (mustRead) {
+					// We can set up the initial reads at any time up until we actually need the data.
+					// These reads will not complete until the hardware actually starts (i.e. enough
+					// frames have been written, see ComputeStreamingLayout()), so might as well
+					// set this up now and we'll be ready when that happens.
+					if (IsLoggingEnabled()) Log() << "Starting initial reads";
+					if (prefixReadBuffer.has_value()) {
+						Trace(TraceEvent::READ_START, prefixTransferIndex, getTransferSlotIndex(prefixTransferIndex));
+						prefixReadBuffer->GetIoTimes() = {};
+						if (stats != nullptr) stats->inflightReads.fetch_add(1, std::memory_order_relaxed);
+						startQa40xRead(*prefixReadBuffer, prefixReadSizeInFrames * readFrameSizeInBytes);
+					}
+					for (size_t slotIndex = 0; slotIndex < readBuffers.size(); ++slotIndex) startReceiving();
+				}
+				recordTimestamp(getTimestampNanoseconds());
+				// After a recovery, carry on with the ASIO buffer that comes after the last one that was handed to the ASIO host application.
+				for (auto asioBufferIndex = long(::dechamps_ASIOUtil::ASIOToInt64(currentSamplePosition.samples) / int64_t(preparedState.buffers.bufferSizeInFrames) % 2); ; asioBufferIndex = (asioBufferIndex + 1) % 2) {
+					const auto asioToQa40xWithheld = [&] {
+						// The loop is structured in such a way that the ASIO buffer that is ready to send is the
+						// *opposite* buffer from the one given by `asioBufferIndex`.
+						const auto outputAsioBufferIndex = (asioBufferIndex + 1) % 2;
+						assert(withheldWrites < writeBuffers.size());
+						assert(mustPlay);
+						const bool invertPolarity = preparedState.asio401.WithDevice(
+							[&](const QA401&) { return true; }, // https://github.com/dechamps/ASIO401/issues/14
+							[&](const QA403&) { return false; }
+						);
+						// Range of frames that this ASIO buffer covers within its period.
+						const auto asioBufferBegin = size_t(outputAsioBufferCount % usbTransferLayout.asioBuffersPerPeriod) * asioBufferSizeInFrames;
+						const auto asioBufferEnd = asioBufferBegin + asioBufferSizeInFrames;
+						// Fill all the transfers that overlap this ASIO buffer, starting from the first one that is not complete yet.
+						for (auto transferIndex = nextWriteTransferIndex + withheldWrites; ; ++transferIndex) {
+							const auto [transferBegin, transferEnd] = getTransferFrameRange(transferIndex);
+							auto& writeBuffer = *writeBuffers[transferIndex % writeBuffers.size()];
+							if (writeBuffer.GetIoSlot().HasPending()) {
+								assert(transferBegin >= asioBufferBegin);
+								finishSending(writeBuffer, getTransferEndFramePosition(transferIndex - writeBuffers.size()), int64_t(transferIndex - writeBuffers.size()));
+							}
+							const auto copyBegin = (std::max)(transferBegin, asioBufferBegin);
+							const auto copyEnd = (std::min)(transferEnd, asioBufferEnd);
+							const auto qa40xFrames = writeBuffer.data().subspan((copyBegin - transferBegin) * writeFrameSizeInBytes, (copyEnd - copyBegin) * writeFrameSizeInBytes);
+							if (separateCallbackThread) {
+								if (IsLoggingEnabled()) Log() << "About to copy frames " << copyBegin << "-" << copyEnd << " of the period from the output ring to QA40x write slot " << &writeBuffer;
+								popOutputRing(qa40xFrames);
+							}
+							else {
+								if (IsLoggingEnabled()) Log() << "About to copy frames " << copyBegin << "-" << copyEnd << " of the period from ASIO buffer index " << outputAsioBufferIndex << " to QA40x write slot " << &writeBuffer;
+								CopyToDevice(outputAsioBufferIndex, copyBegin - asioBufferBegin, qa40xFrames, invertPolarity);
+							}
+							// If the transfer extends past this ASIO buffer, it will be completed by the next ASIO buffer(s) in the period.
+							if (transferEnd > asioBufferEnd) break;
+							++withheldWrites;
+							if (transferEnd == asioBufferEnd) break;
+						}
+						++outputAsioBufferCount;
+					};
+					const auto writeWithheldOutputBuffers = [&] {
+						if (IsLoggingEnabled()) Log() << "Issuing " << withheldWrites << " withheld writes";
+						for (; withheldWrites > 0; --withheldWrites) {
+							const auto [transferBegin, transferEnd] = getTransferFrameRange(nextWriteTransferIndex);
+							startSending(*writeBuffers[nextWriteTransferIndex % writeBuffers.size()], transferEnd - transferBegin, int64_t(nextWriteTransferIndex));
+							++nextWriteTransferIndex;
+						}
+					};
+
+					// Awaits the reads that cover the next ASIO buffer, copies the data to the ASIO buffer if we are recording, and restarts reads in the slots that are not needed anymore.
+					const auto receive = [&] {
+						assert(mustRead);
+						if (prefixReadBuffer.has_value() && prefixReadBuffer->GetIoSlot().HasPending()) {
+							if (IsLoggingEnabled()) Log() << "Discarding prefix read";
+							// The prefix read ends right where the stream begins.
+							finishReceiving(*prefixReadBuffer, 0, prefixTransferIndex);
+						}
+						const auto swapChannels = preparedState.asio401.WithDevice(
+							[&](const QA401&) { return true; }, // https://github.com/dechamps/ASIO401/issues/13
+							[&](const QA403&) { return false; });
+						// Range of frames that this ASIO buffer covers within its period.
+						const auto positionInPeriod = size_t(inputAsioBufferCount % usbTransferLayout.asioBuffersPerPeriod);
+						const auto asioBufferBegin = positionInPeriod * asioBufferSizeInFrames;
+						const auto asioBufferEnd = asioBufferBegin + asioBufferSizeInFrames;
+						for (auto transferIndex = nextReadTransferToConsumeIndex; ; ++transferIndex) {
+							const auto [transferBegin, transferEnd] = getTransferFrameRange(transferIndex);
+							auto& readBuffer = *readBuffers[transferIndex % readBuffers.size()];
+							if (transferIndex == nextReadTransferToAwaitIndex) {
+								finishReceiving(readBuffer, getTransferEndFramePosition(transferIndex), int64_t(transferIndex));
+								++nextReadTransferToAwaitIndex;
+							}
+							if (mustRecord) {
+								const auto copyBegin = (std::max)(transferBegin, asioBufferBegin);
+								const auto copyEnd = (std::min)(transferEnd, asioBufferEnd);
+								const auto qa40xFrames = std::as_const(readBuffer).data().subspan((copyBegin - transferBegin) * readFrameSizeInBytes, (copyEnd - copyBegin) * readFrameSizeInBytes);
+								if (separateCallbackThread) {
+									if (IsLoggingEnabled()) Log() << "About to copy frames " << copyBegin << "-" << copyEnd << " of the period from QA40x read slot " << &readBuffer << " to the input ring";
+									pushInputRing(qa40xFrames);
+								}
+								else {
+									if (IsLoggingEnabled()) Log() << "About to copy frames " << copyBegin << "-" << copyEnd << " of the period from QA40x read slot " << &readBuffer << " to ASIO buffer index " << asioBufferIndex;
+									CopyFromDevice(asioBufferIndex, copyBegin - asioBufferBegin, qa40xFrames, swapChannels);
+								}
+							}
+							// If the transfer extends past this ASIO buffer, the rest of it will be used by the next ASIO buffer(s) in the period.
+							if (transferEnd > asioBufferEnd) break;
+							++nextReadTransferToConsumeIndex;
+							startReceiving();
+							if (transferEnd == asioBufferEnd) break;
+						}
+						// Use the estimated time at which the end of this ASIO buffer was read. This is smoother than the raw read completion time, and also
+						// works if ASIO buffers are coalesced, in which case the read completion time corresponds to the end of the period, not the end of
+						// this ASIO buffer.
+						recordTimestamp(clockEstimator.GetEstimate()->GetTimeNanoseconds(int64_t(inputAsioBufferCount + 1) * asioBufferSizeInFrames));
+						++inputAsioBufferCount;
+					};
+
+					if (mustPlay && hostSupportsOutputReady && !separateCallbackThread) {
+						// We only wait for OutputReady() after we've called bufferSwitch() at least once. In theory it *may*
+						// be pedentically correct to require the host application to call OutputReady() after Start() returns
+						// but before the first bufferSwitch() call is made, but in practice it's likely many applications
+						// won't do that.
+						if (!firstWriteStarted && !outputReady.IsSet()) {
 							if (IsLoggingEnabled()) Log() << "Waiting for the ASIO Host Application to signal OutputReady";
-							outputReadyCondition.wait(outputReadyLock, [&] { return outputReady; });
+							outputReady.Wait();
+							// ~RunningState() sets the event to make sure we don't wait forever.
+							checkStopRequested();
 						}
+						asioToQa40xWithheld();
 					}
-					asioToQa40xWithheld();
-				}
 
-				if (!primed && (
-					!mustPlay // In read-only mode we are in steady state from the first iteration - there are no output buffers, therefore no priming necessary
-					|| withheldOutputBuffers == writeBuffers.size() // We are entering steady-state because we have accumulated enough initial output data
-				)) {
-					if (IsLoggingEnabled()) Log() << "We are now primed";
-					if (!mustPlay) {
-						assert(withheldOutputBuffers == 0);
-						assert(!firstWriteStarted);
-						// Even if we don't want to play anything, we still have to do at least one write to start the hardware,
-						// otherwise the first read will just hang forever.
-						// Note we won't wait for this write - it will stay pending until we stop streaming. This should be fine.
-						startSending();
+					if (!primed && (
+						!mustPlay // In read-only mode we are in steady state from the first iteration - there are no output buffers, therefore no priming necessary
+						|| withheldWrites == writeBuffers.size() // We are entering steady-state because we have accumulated enough initial output data
+					)) {
+						if (IsLoggingEnabled()) Log() << "We are now primed";
+						Trace(TraceEvent::PRIMED, int64_t(withheldWrites));
+						if (prefixWriteBuffer.has_value()) {
+							// The prefix write has to go first. In read-only mode, it is the only write we will ever do - it is just there to start the hardware.
+							// Note we won't wait for this write - it will stay pending until we stop streaming. This should be fine.
+							startSending(*prefixWriteBuffer, prefixWriteSizeInFrames, prefixTransferIndex);
+						}
+						primed = true;
+						streamingEstablished = true;
+						if (recoveryBeginNanoseconds.has_value()) {
+							const auto recoveryDurationNanoseconds = getTimestampNanoseconds() - *std::exchange(recoveryBeginNanoseconds, std::nullopt);
+							Log() << "Stream recovered in " << double(recoveryDurationNanoseconds) / 1e6 << " ms";
+							Trace(TraceEvent::RECOVERY_END);
+							if (stats != nullptr) stats->recoveryDuration.Record(recoveryDurationNanoseconds);
+							notifyHostOfDiscontinuity();
+						}
 					}
-					primed = true;
-				}
 
-				if (primed) {
-					// During priming, writes are "withheld", i.e. we collect the output data from the app and store it in
-					// QA40x-facing write buffers, but we don't actually send them. This is to ensure the QA40x doesn't
-					// actually start streaming before priming is done.
-					// In the first steady-state iteration, we issue all withheld writes. On subsequent steady-state iterations,
-					// this will send a single write per iteration as writes will not spend any time in a withheld state.
-					writeWithheldOutputBuffers();
+					if (primed) {
+						// During priming, writes are "withheld", i.e. we collect the output data from the app and store it in
+						// QA40x-facing write buffers, but we don't actually send them. This is to ensure the QA40x doesn't
+						// actually start streaming before priming is done.
+						// In the first steady-state iteration, we issue all withheld writes. On subsequent steady-state iterations,
+						// this will send the writes that were completed during the iteration, if any, as writes will not spend any
+						// time in a withheld state.
+						writeWithheldOutputBuffers();
 
-					if (mustRecord) {
-						qa40xToAsio();
-					}
-					else if (mustRead) {
-						finishReceiving();
-						startReceiving();
+						if (mustRead) receive();
 					}
-				}
 
-				BufferSwitch(asioBufferIndex, currentSamplePosition);
-				currentSamplePosition.samples = ::dechamps_ASIOUtil::Int64ToASIO<ASIOSamples>(::dechamps_ASIOUtil::ASIOToInt64(currentSamplePosition.samples) + preparedState.buffers.bufferSizeInFrames);
+					if (!separateCallbackThread) {
+						BufferSwitch(asioBufferIndex, currentSamplePosition, clockEstimator.GetSampleRate());
+						currentSamplePosition.samples = ::dechamps_ASIOUtil::Int64ToASIO<ASIOSamples>(::dechamps_ASIOUtil::ASIOToInt64(currentSamplePosition.samples) + preparedState.buffers.bufferSizeInFrames);
+					}
 
-				if (mustPlay && !hostSupportsOutputReady) asioToQa40xWithheld();
+					// With a separate callback thread, we always collect output data right after input data has been handed over. This will block
+					// if RunCallbackThread() has not produced it yet, but the reads for the next ASIO buffers are already queued at this point.
+					if (mustPlay && (separateCallbackThread || !hostSupportsOutputReady)) asioToQa40xWithheld();
 
-				preparedState.asio401.WithDevice(
-					[&](QA401& qa401) { qa401.Ping(); },
-					[&](auto&) {});
+					preparedState.asio401.WithDevice(
+						[&](QA401& qa401) { qa401.Ping(); },
+						[&](auto&) {});
+				}
+			}
+			catch (StopRequested) {
+				Log() << "Streaming successfully stopped; tearing down device";
+				break;
+			}
+			catch (const std::exception& exception) {
+				Log() << "Error occurred in streaming thread: " << exception.what();
+				if (recover()) continue;
+				requestReset();
+				break;
+			}
+			catch (...) {
+				Log() << "Unknown fatal error occurred in streaming thread";
+				requestReset();
+				break;
 			}
 		}
-		catch (StopRequested) {
-			Log() << "Streaming successfully stopped; tearing down device";
+
+		Trace(TraceEvent::STREAM_STOP);
+		if (stats != nullptr) {
+			stats->running.store(0, std::memory_order_relaxed);
+			stats->inflightWrites.store(0, std::memory_order_relaxed);
+			stats->inflightReads.store(0, std::memory_order_relaxed);
+		}
+
+		// Make sure RunCallbackThread() doesn't wait for us forever.
+		CloseRings();
+
+		if (clockEstimator.GetEstimate().has_value())
+			Log() << "Measured device sample rate: " << clockEstimator.GetSampleRate() << " Hz (" << clockEstimator.GetDriftPPM() << " ppm from nominal), clock estimator was reset " << clockEstimator.GetResetCount() << " times";
+
+		try {
+			abortAndAwaitPendingIo();
+			// If the stream stopped because of an error, the device could be in an inconsistent state, so don't leave it as is.
+			preparedState.TearDownDevice(deviceSampleRate, /*warm=*/!resetRequestIssued);
 		}
 		catch (const std::exception& exception) {
-			Log() << "Fatal error occurred in streaming thread: " << exception.what();
+			Log() << "Fatal error occurred while attempting to tear down the QA40x: " << exception.what();
 			requestReset();
 		}
 		catch (...) {
-			Log() << "Unknown fatal error occurred in streaming thread";
+			Log() << "Unknown fatal error occurred while attempting to tear down the QA40x";
 			requestReset();
 		}
+	}
+
+	// Only used if the `ioThread` option is enabled. In that mode, RunThread() only deals with USB I/O and does not call the ASIO host application;
+	// instead, this thread does, as well as the conversion between ASIO buffers and the device sample format. The two threads exchange data through
+	// the output and input rings. This way, a slow bufferSwitch() call does not delay the restarting of USB transfers, and RunThread() can run at a
+	// higher priority than the ASIO host application code.
+	//
+	// In full duplex mode, this thread starts by calling bufferSwitch() `callbackThreadLeadInAsioBuffers` times without any input, similar to
+	// priming in RunThread(). This provides RunThread() with the `inflightTransfers` periods it needs for priming, plus `ioThreadRingDepth` periods of
+	// lead. From then on, every ASIO buffer of input that RunThread() pushes results in one ASIO buffer of output, so the lead is maintained: that is
+	// how much this thread can fall behind before RunThread() has to wait for it. The lead adds to the output latency (see ComputeLatencies()).
+	// In output-only mode, this thread is simply paced by the space available in the output ring; in input-only mode, by the data in the input ring.
+	void ASIO401::PreparedState::RunningState::RunCallbackThread() noexcept {
+		const auto& streamingLayout = preparedState.streamingLayout;
+		const auto writeFrameSizeInBytes = streamingLayout.writeFrameSizeInBytes;
+		const auto readFrameSizeInBytes = streamingLayout.readFrameSizeInBytes;
+		const auto mustPlay = streamingLayout.mustPlay;
+		const auto mustRecord = streamingLayout.mustRecord;
+		// In device frames, like the rings. See RunThread().
+		const auto asioBufferSizeInFrames = streamingLayout.asioBufferSizeInDeviceFrames;
+		const auto leadInAsioBuffers = mustPlay && mustRecord ? streamingLayout.callbackThreadLeadInAsioBuffers : 0;
+		// RunThread() only waits for OutputReady() before its first write, i.e. while it is collecting output data for priming. Do the same here.
+		const auto outputReadyWaitAsioBuffers = size_t(preparedState.asio401.config.inflightTransfers) * streamingLayout.usbTransferLayout.asioBuffersPerPeriod;
+		const bool invertPolarity = preparedState.asio401.WithDevice(
+			[&](const QA401&) { return true; }, // https://github.com/dechamps/ASIO401/issues/14
+			[&](const QA403&) { return false; }
+		);
+		const auto swapChannels = preparedState.asio401.WithDevice(
+			[&](const QA401&) { return true; }, // https://github.com/dechamps/ASIO401/issues/13
+			[&](const QA403&) { return false; });
+
+		// This is thrown when we are asked to stop, or when RunThread() closes the rings, which it does when it stops for any reason. If it stopped
+		// because of an error, it has already requested a reset, so we don't need to do anything else.
+		struct StopRequested final {};
+
+		// Lower than RunThread(), which has much tighter deadlines thanks to the lead this thread maintains.
+		AvrtHighPriority avrtHighPriority(AVRT_PRIORITY_HIGH);
 
 		try {
-			// ~RunningState() may already be calling `Abort()` at the same time, but that shouldn't
-			// matter - whomever gets there first will trigger the abort and the second call should
-			// be a no-op.
-			Abort();
-			for (auto& readBuffer : readBuffers) if (readBuffer.has_value() && readBuffer->GetIoSlot().HasPending()) (void) readBuffer->GetIoSlot().Await();
-			for (auto& writeBuffer : writeBuffers) if (writeBuffer.has_value() && writeBuffer->GetIoSlot().HasPending()) (void) writeBuffer->GetIoSlot().Await();
-			TearDownDevice();
+			SamplePosition currentSamplePosition;
+			const auto recordTimestamp = [&] {
+				currentSamplePosition.timestamp = ::dechamps_ASIOUtil::Int64ToASIO<ASIOTimeStamp>(preparedState.clock.GetTimeNanoseconds());
+			};
+			const auto produceOutput = [&](long outputAsioBufferIndex) {
+				const auto sizeInBytes = asioBufferSizeInFrames * writeFrameSizeInBytes;
+				if (!outputRing->WaitUntilWritable(sizeInBytes)) throw StopRequested();
+				// In output-only mode, the output ring is the only thing that paces us, so it is the best timing information we have.
+				if (!mustRecord) recordTimestamp();
+				if (IsLoggingEnabled()) Log() << "Copying ASIO buffer index " << outputAsioBufferIndex << " to the output ring";
+				size_t asioFrameOffset = 0;
+				for (const auto region : outputRing->GetWriteRegions(sizeInBytes)) {
+					CopyToDevice(outputAsioBufferIndex, asioFrameOffset, region, invertPolarity);
+					asioFrameOffset += region.size() / writeFrameSizeInBytes;
+				}
+				outputRing->CommitWrite(sizeInBytes);
+			};
+			const auto consumeInput = [&](long inputAsioBufferIndex, uint64_t inputAsioBufferCount) {
+				const auto sizeInBytes = asioBufferSizeInFrames * readFrameSizeInBytes;
+				if (IsLoggingEnabled()) Log() << "Waiting for input data";
+				if (!inputRing->WaitUntilReadable(sizeInBytes)) throw StopRequested();
+				// Same as RunThread(), which has necessarily updated the estimate by the time it pushes the data. Input frame positions map directly to input ASIO buffers.
+				const auto estimate = clockEstimate.Load();
+				if (estimate.has_value()) currentSamplePosition.timestamp = ::dechamps_ASIOUtil::Int64ToASIO<ASIOTimeStamp>(estimate->GetTimeNanoseconds(int64_t(inputAsioBufferCount + 1) * asioBufferSizeInFrames));
+				else recordTimestamp();
+				if (IsLoggingEnabled()) Log() << "Copying the input ring to ASIO buffer index " << inputAsioBufferIndex;
+				size_t asioFrameOffset = 0;
+				for (const auto region : inputRing->GetReadRegions(sizeInBytes)) {
+					CopyFromDevice(inputAsioBufferIndex, asioFrameOffset, region, swapChannels);
+					asioFrameOffset += region.size() / readFrameSizeInBytes;
+				}
+				inputRing->CommitRead(sizeInBytes);
+			};
+
+			recordTimestamp();
+			size_t asioBufferCount = 0;
+			for (long asioBufferIndex = 0; ; asioBufferIndex = (asioBufferIndex + 1) % 2, ++asioBufferCount) {
+				// Same buffer management as RunThread(): the ASIO buffer that is ready to send is the *opposite* buffer from `asioBufferIndex`.
+				if (mustPlay && hostSupportsOutputReady) {
+					if (asioBufferCount < outputReadyWaitAsioBuffers && !outputReady.IsSet()) {
+						if (IsLoggingEnabled()) Log() << "Waiting for the ASIO Host Application to signal OutputReady";
+						outputReady.Wait();
+						// ~RunningState() sets the event to make sure we don't wait forever.
+						if (stopRequested) throw StopRequested();
+					}
+					produceOutput((asioBufferIndex + 1) % 2);
+				}
+
+				if (mustRecord && asioBufferCount >= leadInAsioBuffers) consumeInput(asioBufferIndex, asioBufferCount - leadInAsioBuffers);
+
+				const auto estimate = clockEstimate.Load();
+				BufferSwitch(asioBufferIndex, currentSamplePosition, estimate.has_value() ? estimate->sampleRate : deviceSampleRate);
+				currentSamplePosition.samples = ::dechamps_ASIOUtil::Int64ToASIO<ASIOSamples>(::dechamps_ASIOUtil::ASIOToInt64(currentSamplePosition.samples) + preparedState.buffers.bufferSizeInFrames);
+
+				if (mustPlay && !hostSupportsOutputReady) produceOutput(asioBufferIndex);
+			}
+		}
+		catch (StopRequested) {
+			Log() << "Callback thread stopped";
 		}
 		catch (const std::exception& exception) {
-			Log() << "Fatal error occurred while attempting to tear down the QA40x: " << exception.what();
-			requestReset();
+			Log() << "Fatal error occurred in callback thread: " << exception.what();
 		}
 		catch (...) {
-			Log() << "Unknown fatal error occurred while attempting to tear down the QA40x";
-			requestReset();
+			Log() << "Unknown fatal error occurred in callback thread";
 		}
+		// If we stopped because of an error, this makes RunThread() stop as well, and request a reset.
+		CloseRings();
 	}
 
-	void ASIO401::PreparedState::RunningState::RunningState::SetupDevice() {
-		preparedState.asio401.WithDevice(
+	void ASIO401::PreparedState::RunningState::CopyToDevice(long asioBufferIndex, size_t deviceFrameOffset, std::span<std::byte> qa40xFrames, bool invertPolarity) {
+		const auto copy = [&](size_t asioFrameOffset, std::span<std::byte> destination, ::dechamps_cpputil::Endianness destinationEndianness) {
+			preparedState.asio401.WithDevice([&](const auto& device) {
+				CopyToQA40xBuffer<std::remove_cvref_t<decltype(device)>::outputChannelCount>(
+					preparedState.bufferInfos,
+					asioBufferIndex,
+					asioFrameOffset,
+					destination,
+					preparedState.asio401.GetDeviceSampleSizeInBytes(),
+					preparedState.asio401.GetHostSampleType(),
+					destinationEndianness,
+					invertPolarity,
+					preparedState.asio401.GetOutputCalibration());
+			});
+		};
+		auto& outputResampler = preparedState.outputResampler;
+		if (!outputResampler.has_value()) {
+			copy(deviceFrameOffset, qa40xFrames, preparedState.asio401.GetDeviceSampleEndianness());
+			return;
+		}
+
+		// The whole ASIO buffer is resampled at once, when the first frames are requested. The resampler always produces the same number of device frames
+		// for each ASIO buffer, because the ASIO buffer size is a multiple of the resampling ratio (see ComputeStreamingLayout()).
+		if (deviceFrameOffset == 0) {
+			copy(0, preparedState.outputResamplerInput, ::dechamps_cpputil::endianness);
+			outputResamplerOutput = outputResampler->Process(preparedState.outputResamplerInput);
+			assert(outputResamplerOutput.size() == preparedState.streamingLayout.asioBufferSizeInDeviceFrames * preparedState.streamingLayout.writeFrameSizeInBytes);
+		}
+		std::ranges::copy(outputResamplerOutput.subspan(deviceFrameOffset * preparedState.streamingLayout.writeFrameSizeInBytes, qa40xFrames.size()), qa40xFrames.begin());
+	}
+
+	void ASIO401::PreparedState::RunningState::CopyFromDevice(long asioBufferIndex, size_t deviceFrameOffset, std::span<const std::byte> qa40xFrames, bool swapChannels) {
+		const auto copy = [&](size_t asioFrameOffset, std::span<const std::byte> source, ::dechamps_cpputil::Endianness sourceEndianness) {
+			preparedState.asio401.WithDevice([&](const auto& device) {
+				CopyFromQA40xBuffer<std::remove_cvref_t<decltype(device)>::inputChannelCount>(
+					preparedState.bufferInfos,
+					asioBufferIndex,
+					asioFrameOffset,
+					source,
+					preparedState.asio401.GetDeviceSampleSizeInBytes(),
+					preparedState.asio401.GetHostSampleType(),
+					sourceEndianness,
+					swapChannels,
+					preparedState.asio401.GetInputCalibration(),
+					inputHighPassFilter.has_value() ? &*inputHighPassFilter : nullptr);
+			});
+		};
+		auto& inputResampler = preparedState.inputResampler;
+		auto& inputDecimator = preparedState.inputDecimator;
+		if (!inputResampler.has_value() && !inputDecimator.has_value()) {
+			copy(deviceFrameOffset, qa40xFrames, preparedState.asio401.GetDeviceSampleEndianness());
+			return;
+		}
+
+		// Each ASIO buffer starts on a resampling period boundary, so the number of host frames the resampler (or decimator) has produced so far for this
+		// ASIO buffer only depends on how many device frames it was given. The high-pass filter and calibration are applied after resampling, at the host rate.
+		const auto& sampleRateRatio = preparedState.streamingLayout.sampleRateRatio;
+		const auto asioFrameOffset = (deviceFrameOffset * sampleRateRatio.hostFrames + sampleRateRatio.deviceFrames - 1) / sampleRateRatio.deviceFrames;
+		copy(asioFrameOffset, inputDecimator.has_value() ? inputDecimator->Process(qa40xFrames) : inputResampler->Process(qa40xFrames), ::dechamps_cpputil::endianness);
+	}
+
+	void ASIO401::PreparedState::RunningState::CloseRings() {
+		if (outputRing.has_value()) outputRing->Close();
+		if (inputRing.has_value()) inputRing->Close();
+	}
+
+	void ASIO401::PreparedState::SetupDevice(ASIOSampleRate sampleRate) {
+		const auto warmSampleRate = std::exchange(this->warmSampleRate, std::nullopt);
+		asio401.WithDevice(
 			[&](QA401& qa401) {
 				// Note: the input high pass filter is not configurable, because there's no clear use case for disabling it.
 				// If you can think of one, feel free to reopen https://github.com/dechamps/ASIO401/issues/7.
 				qa401.Reset(
 					QA401::InputHighPassFilterState::ENGAGED,
-					GetQA401AttenuatorState(preparedState.asio401.config),
+					GetQA401AttenuatorState(asio401.config),
 					*GetQA401SampleRate(sampleRate)
 				);
 			},
 			[&](QA403& qa403) {
-				qa403.Reset(
-					GetQA403FullScaleInputLevel(preparedState.asio401.config),
-					GetQA403FullScaleOutputLevel(preparedState.asio401.config),
-					*GetQA403SampleRate(sampleRate));
+				// The levels come from the config, which cannot change, so the sample rate is the only thing that can be different from last time.
+				if (warmSampleRate == sampleRate)
+					Log() << "QA403 is still configured from the previous stream, skipping reset";
+				else
+					qa403.Reset(
+						GetQA403FullScaleInputLevel(asio401.config),
+						GetQA403FullScaleOutputLevel(asio401.config),
+						*GetQA403SampleRate(sampleRate));
 				qa403.Start();
 			});
 	}
 
-	void ASIO401::PreparedState::RunningState::RunningState::TearDownDevice() {
-		preparedState.asio401.WithDevice([&](QA401& qa401) {
+	void ASIO401::PreparedState::TearDownDevice(ASIOSampleRate sampleRate, bool warm) {
+		assert(!warmSampleRate.has_value());
+		asio401.WithDevice([&](QA401& qa401) {
 			// The QA401 output will exhibit a lingering DC offset if we don't reset it. Also, (re-)engage the attenuator just to be safe.
+			// Note there is no way to stop the QA401 without resetting it, so it never stays warm. See QA401::Reset().
 			qa401.Reset(
 				QA401::InputHighPassFilterState::ENGAGED, QA401::AttenuatorState::ENGAGED, *GetQA401SampleRate(sampleRate)
 			);
 			},
 			[&](QA403& qa403) {
+				if (warm) {
+					// Hosts such as REW start and stop streams many times in a row, and the full reset is slow, so avoid it if we can.
+					// The attenuators will be re-engaged when the buffers are disposed of.
+					Log() << "Stopping QA403, leaving it configured for " << sampleRate << " Hz";
+					qa403.Stop();
+					warmSampleRate = sampleRate;
+					return;
+				}
 				// Re-engage the attenuators just to be safe.
 				qa403.Reset(QA403::FullScaleInputLevel::DBV42, QA403::FullScaleOutputLevel::DBVn12, QA403::SampleRate::KHZ48);
 			});
 	}
 
-	void ASIO401::PreparedState::RunningState::RunningState::BufferSwitch(long driverBufferIndex, SamplePosition currentSamplePosition) {
-		{
-			std::unique_lock outputReadyLock(outputReadyMutex);
-			outputReady = false;
-		}
+	void ASIO401::PreparedState::RunningState::RunningState::BufferSwitch(long driverBufferIndex, SamplePosition currentSamplePosition, double measuredSampleRate) {
+		// Publish the position before calling the host, so that GetSamplePosition() calls made from within bufferSwitch() return the position of that buffer.
+		samplePosition.Store(currentSamplePosition);
+		outputReady.Reset();
+		Trace(TraceEvent::BUFFER_SWITCH_BEGIN, driverBufferIndex, ::dechamps_ASIOUtil::ASIOToInt64(currentSamplePosition.samples));
+		const auto beginTimestampNanoseconds = stats != nullptr ? preparedState.clock.GetTimeNanoseconds() : 0;
 		if (!host_supports_timeinfo) {
 			if (IsLoggingEnabled()) Log() << "Firing ASIO bufferSwitch() callback with buffer index: " << driverBufferIndex;
 			preparedState.callbacks.bufferSwitch(long(driverBufferIndex), ASIOTrue);
@@ -973,11 +1749,21 @@ namespace asio401 {
 			time.timeInfo.flags = kSystemTimeValid | kSamplePositionValid | kSampleRateValid;
 			time.timeInfo.samplePosition = currentSamplePosition.samples;
 			time.timeInfo.systemTime = currentSamplePosition.timestamp;
-			time.timeInfo.sampleRate = sampleRate;
+			// Report the actual rate of the device clock (see ClockEstimator), which can be useful to ASIO Host Applications that need to compensate for drift.
+			// If the stream is resampled, the host sample rate drifts along with the device clock.
+			time.timeInfo.sampleRate = measuredSampleRate * sampleRate / deviceSampleRate;
 			if (IsLoggingEnabled()) Log() << "Firing ASIO bufferSwitchTimeInfo() callback with buffer index: " << driverBufferIndex << ", time info: (" << ::dechamps_ASIOUtil::DescribeASIOTime(time) << ")";
 			const auto timeResult = preparedState.callbacks.bufferSwitchTimeInfo(&time, long(driverBufferIndex), ASIOTrue);
 			if (IsLoggingEnabled()) Log() << "bufferSwitchTimeInfo() complete, returned time info: " << (timeResult == nullptr ? "none" : ::dechamps_ASIOUtil::DescribeASIOTime(*timeResult));
 		}
+		Trace(TraceEvent::BUFFER_SWITCH_END, driverBufferIndex);
+		if (stats != nullptr) {
+			const auto durationNanoseconds = preparedState.clock.GetTimeNanoseconds() - beginTimestampNanoseconds;
+			stats->bufferSwitchCount.fetch_add(1, std::memory_order_relaxed);
+			stats->bufferSwitchDuration.Record(durationNanoseconds);
+			if (double(durationNanoseconds) > double(preparedState.buffers.bufferSizeInFrames) * 1e9 / sampleRate)
+				stats->missedDeadlineCount.fetch_add(1, std::memory_order_relaxed);
+		}
 	}
 
 	void ASIO401::Stop() {
@@ -1004,7 +1790,7 @@ namespace asio401 {
 
 	void ASIO401::PreparedState::RunningState::GetSamplePosition(ASIOSamples* sPos, ASIOTimeStamp* tStamp) const
 	{
-		const auto currentSamplePosition = samplePosition.load();
+		const auto currentSamplePosition = samplePosition.Load();
 		*sPos = currentSamplePosition.samples;
 		*tStamp = currentSamplePosition.timestamp;
 		if (IsLoggingEnabled()) Log() << "Returning: sample position " << ::dechamps_ASIOUtil::ASIOToInt64(*sPos) << ", timestamp " << ::dechamps_ASIOUtil::ASIOToInt64(*tStamp);
@@ -1023,11 +1809,8 @@ namespace asio401 {
 	}
 
 	void ASIO401::PreparedState::RunningState::OutputReady() {
-		{
-			std::scoped_lock outputReadyLock(outputReadyMutex);
-			outputReady = true;
-		}
-		outputReadyCondition.notify_all();
+		Trace(TraceEvent::OUTPUT_READY);
+		outputReady.Set();
 	}
 
 	void ASIO401::PreparedState::RunningState::Abort() {
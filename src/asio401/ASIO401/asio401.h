@@ -1,9 +1,20 @@
 #pragma once
 
+#include "clock_estimator.h"
 #include "config.h"
+#include "conversion.h"
 #include "qa401.h"
 #include "qa403.h"
-
+#include "resampler.h"
+#include "streaming_stats.h"
+#include "trace.h"
+
+#include "../ASIO401Util/atomic_event.h"
+#include "../ASIO401Util/clock.h"
+#include "../ASIO401Util/memory_arena.h"
+#include "../ASIO401Util/reusable_thread.h"
+#include "../ASIO401Util/seqlock.h"
+#include "../ASIO401Util/spsc_ring.h"
 #include "../ASIO401Util/variant.h"
 
 #include <dechamps_ASIOUtil/asiosdk/asiosys.h>
@@ -12,10 +23,10 @@
 #include <windows.h>
 
 #include <atomic>
+#include <bit>
 #include <optional>
+#include <span>
 #include <stdexcept>
-#include <mutex>
-#include <thread>
 #include <variant>
 #include <vector>
 
@@ -55,9 +66,34 @@ namespace asio401 {
 	private:
 		using Device = std::variant<QA401, QA403>;
 
+		// How many device frames correspond to how many host frames, in lowest terms. 1:1 if the device runs at the host sample rate; otherwise, the
+		// stream is resampled. See GetDeviceSampleRate().
+		struct SampleRateRatio {
+			size_t deviceFrames;
+			size_t hostFrames;
+
+			bool operator==(const SampleRateRatio&) const = default;
+			bool IsIdentity() const { return deviceFrames == hostFrames; }
+			// True if the device sample rate is a power-of-two multiple of the host sample rate (see the `deviceSampleRateHz` option). In that case,
+			// input is decimated using a Decimator, which is much cheaper than a Resampler, with GetDecimationStageCount() stages.
+			bool IsDecimation() const { return hostFrames == 1 && deviceFrames > 1 && std::has_single_bit(deviceFrames); }
+			size_t GetDecimationStageCount() const { return size_t(std::countr_zero(deviceFrames)); }
+		};
+
+		// Describes how the stream of ASIO buffers is cut into USB transfers. See the `usbTransferSizeSamples` option.
+		struct UsbTransferLayout {
+			// How many consecutive ASIO buffers are coalesced into a single period. 1 if ASIO buffers are not coalesced.
+			size_t asioBuffersPerPeriod;
+			// How many USB transfers each period is split into. 1 if ASIO buffers are not split.
+			size_t transfersPerPeriod;
+			// The size of every transfer in the period, except the last one which can be smaller.
+			size_t transferSizeInFrames;
+		};
+
 		class PreparedState {
 		public:
 			PreparedState(ASIO401& asio401, ASIOBufferInfo* asioBufferInfos, long numChannels, long bufferSizeInFrames, ASIOCallbacks* callbacks);
+			~PreparedState();
 			PreparedState(const PreparedState&) = delete;
 			PreparedState(PreparedState&&) = delete;
 
@@ -74,10 +110,43 @@ namespace asio401 {
 			void RequestReset();
 
 		private:
+			// Describes how the stream is laid out in USB transfers. This only depends on createBuffers() parameters and on the configuration, so it
+			// is computed in advance. This makes it possible to allocate all streaming buffers before the stream starts.
+			struct StreamingLayout {
+				bool mustPlay;
+				bool mustRecord;
+				// True if we read from the device, which we may have to do even if we are not recording (see the `forceRead` option).
+				bool mustRead;
+				// The sample rate ratio that the layout was computed for. Everything below is in device frames.
+				SampleRateRatio sampleRateRatio;
+				size_t asioBufferSizeInDeviceFrames;
+				size_t writeFrameSizeInBytes;
+				size_t readFrameSizeInBytes;
+				UsbTransferLayout usbTransferLayout;
+				// How many I/O slots (i.e. USB transfer buffers) there are in each direction. See RunThread().
+				size_t transferSlotCount;
+				// The prefix write is made of silence, and is sent before the first ASIO buffer.
+				size_t prefixWriteSizeInFrames;
+				// The prefix read is discarded. It covers the initial input garbage, as well as the prefix write if we need to keep input and output in sync.
+				size_t prefixReadSizeInFrames;
+				// Only used if the `ioThread` option is enabled; zero otherwise. See RunCallbackThread().
+				size_t callbackThreadLeadInAsioBuffers;
+				size_t ringSizeInFrames;
+			};
+			static StreamingLayout ComputeStreamingLayout(const ASIO401& asio401, size_t inputChannelCount, size_t outputChannelCount, size_t bufferSizeInFrames);
+
+			// Called from the streaming thread.
+			void SetupDevice(ASIOSampleRate sampleRate);
+			// If `warm` is true, the device is left configured if possible, so that the next SetupDevice() call can be faster. See `warmSampleRate`.
+			void TearDownDevice(ASIOSampleRate sampleRate, bool warm);
+
 			struct Buffers
 			{
-				Buffers(size_t bufferSetCount, size_t inputChannelCount, size_t outputChannelCount, size_t bufferSizeInFrames, size_t inputSampleSizeInBytes, size_t outputSampleSizeInBytes);
+				Buffers(MemoryArena& memoryArena, size_t bufferSetCount, size_t inputChannelCount, size_t outputChannelCount, size_t bufferSizeInFrames, size_t inputSampleSizeInBytes, size_t outputSampleSizeInBytes);
 				~Buffers();
+				static size_t GetSizeInBytes(size_t bufferSetCount, size_t inputChannelCount, size_t outputChannelCount, size_t bufferSizeInFrames, size_t inputSampleSizeInBytes, size_t outputSampleSizeInBytes) {
+					return bufferSetCount * bufferSizeInFrames * (inputChannelCount * inputSampleSizeInBytes + outputChannelCount * outputSampleSizeInBytes);
+				}
 				std::byte* GetInputBuffer(size_t bufferSetIndex, size_t channelIndex) { return buffers.data() + bufferSetIndex * GetBufferSetSizeInBytes() + channelIndex * GetInputBufferSizeInBytes(); }
 				std::byte* GetOutputBuffer(size_t bufferSetIndex, size_t channelIndex) { return GetInputBuffer(bufferSetIndex, inputChannelCount) + channelIndex * GetOutputBufferSizeInBytes(); }
 				size_t GetBufferSetSizeInBytes() const { return buffers.size() / bufferSetCount; }
@@ -95,7 +164,47 @@ namespace asio401 {
 				// [ input channel 0 buffer 0 ] [ input channel 1 buffer 0 ] ... [ input channel N buffer 0 ] [ output channel 0 buffer 0 ] [ output channel 1 buffer 0 ] .. [ output channel N buffer 0 ]
 				// [ input channel 0 buffer 1 ] [ input channel 1 buffer 1 ] ... [ input channel N buffer 1 ] [ output channel 0 buffer 1 ] [ output channel 1 buffer 1 ] .. [ output channel N buffer 1 ]
 				// The reason why this is a giant blob is to slightly improve performance by (theroretically) improving memory locality.
-				std::vector<std::byte> buffers;
+				const std::span<std::byte> buffers;
+			};
+
+			template <QA40x::ChannelType channelType>
+			class QA40xBuffer final {
+			public:
+				explicit QA40xBuffer(std::span<std::byte> buffer);
+
+				std::span<std::byte> data();
+				std::span<const std::byte> data() const;
+
+				QA40xIOSlot<channelType>& GetIoSlot() { return ioSlot; }
+				const QA40xIOSlot<channelType>& GetIoSlot() const { return ioSlot; }
+
+				// When the last I/O in this slot was started and completed, for statistics. Empty if not measured.
+				struct IoTimes final {
+					std::optional<int64_t> startNanoseconds;
+					std::optional<int64_t> completionNanoseconds;
+				};
+				IoTimes& GetIoTimes() { return ioTimes; }
+
+			private:
+				const std::span<std::byte> buffer;
+				QA40xIOSlot<channelType> ioSlot;
+				IoTimes ioTimes;
+			};
+
+			// The device-facing buffers used by RunThread() and RunCallbackThread(). These are allocated in advance, along with the ASIO buffers, so
+			// that starting the stream does not involve any memory allocation.
+			struct StreamingBuffers {
+				StreamingBuffers(const StreamingLayout&, MemoryArena&);
+				static size_t GetArenaSizeInBytes(const StreamingLayout&);
+
+				// One per I/O slot. Note that the vectors are never resized - their elements are not movable.
+				std::vector<std::optional<QA40xBuffer<QA40x::ChannelType::WRITE>>> writeBuffers;
+				std::vector<std::optional<QA40xBuffer<QA40x::ChannelType::READ>>> readBuffers;
+				std::optional<QA40xBuffer<QA40x::ChannelType::WRITE>> prefixWriteBuffer;
+				std::optional<QA40xBuffer<QA40x::ChannelType::READ>> prefixReadBuffer;
+				// Backing memory for the output and input rings; empty if the rings are not used.
+				std::span<std::byte> outputRingBuffer;
+				std::span<std::byte> inputRingBuffer;
 			};
 
 			class RunningState {
@@ -108,58 +217,98 @@ namespace asio401 {
 				// the ASIO host application may decide to call GetSamplePosition() or OutputReady() as soon
 				// as bufferSwitch() is called without waiting for Start() to return - we don't want these calls
 				// to race with `PreparedState::Start()` constructing `PreparedState::runningState`.
-				void Start() { thread = std::thread([&] { RunThread(); }); }
+				void Start() {
+					preparedState.streamingThread.Start();
+					if (preparedState.callbackThread.has_value()) preparedState.callbackThread->Start();
+				}
 
 				void GetSamplePosition(ASIOSamples* sPos, ASIOTimeStamp* tStamp) const;
 				void OutputReady();
 
+				// Run by the PreparedState threads after Start() is called.
+				void RunThread() noexcept;
+				void RunCallbackThread() noexcept;
+
 			private:
 				struct SamplePosition {
 					ASIOSamples samples = { 0 };
 					ASIOTimeStamp timestamp = { 0 };
 				};
 
-				template <QA40x::ChannelType channelType>
-				class QA40xBuffer final {
-				public:
-					explicit QA40xBuffer(size_t size);
-
-					std::span<std::byte> data();
-					std::span<const std::byte> data() const;
-
-					QA40xIOSlot<channelType>& GetIoSlot() { return ioSlot; }
-					const QA40xIOSlot<channelType>& GetIoSlot() const { return ioSlot; }
-
-				private:
-					std::vector<std::byte> buffer;
-					QA40xIOSlot<channelType> ioSlot;
-				};
-
-				void RunThread() noexcept;
-				void SetupDevice();
-				void TearDownDevice();
-				void BufferSwitch(long driverBufferIndex, SamplePosition currentSamplePosition);
+				void CloseRings();
+				void Trace(TraceEvent event, int64_t arg0 = 0, int64_t arg1 = 0) const noexcept {
+					if (preparedState.tracer != nullptr) preparedState.tracer->Record(event, arg0, arg1);
+				}
+				// `measuredSampleRate` is the measured rate of the device clock.
+				void BufferSwitch(long driverBufferIndex, SamplePosition currentSamplePosition, double measuredSampleRate);
+				// Convert the frames that start at `deviceFrameOffset` device frames into the given ASIO buffer, to or from `qa40xFrames`. The number of
+				// frames is determined by the size of `qa40xFrames`. Frames must be copied in order, starting from the beginning of the ASIO buffer.
+				void CopyToDevice(long asioBufferIndex, size_t deviceFrameOffset, std::span<std::byte> qa40xFrames, bool invertPolarity);
+				void CopyFromDevice(long asioBufferIndex, size_t deviceFrameOffset, std::span<const std::byte> qa40xFrames, bool swapChannels);
 				void Abort();
 
 				PreparedState& preparedState;
+				// Null if statistics are not available.
+				StreamingStatsBlock* const stats;
 				const ASIOSampleRate sampleRate;
+				// The sample rate that the device actually runs at. Differs from `sampleRate` if the stream is resampled.
+				const ASIOSampleRate deviceSampleRate;
 				const bool hostSupportsOutputReady;
 				const bool host_supports_timeinfo;
+				// Used to notify the ASIO host application of discontinuities in the stream. See ClockEstimator.
+				const bool hostSupportsOverload;
+				const bool hostSupportsResyncRequest;
 				std::atomic<bool> stopRequested = false;
-				std::atomic<SamplePosition> samplePosition;
+				// Published by BufferSwitch() for GetSamplePosition().
+				Seqlock<SamplePosition> samplePosition;
+				// Published by RunThread() for RunCallbackThread(), if the `ioThread` option is enabled.
+				Seqlock<std::optional<ClockEstimator::Estimate>> clockEstimate;
+
+				// Note: this is reset on every bufferSwitch() and set on every OutputReady() call, so it has to be cheap - it cannot involve any locks,
+				// lest the streaming thread end up blocking on a lock held by an ASIO host application thread.
+				AtomicEvent outputReady;
 
-				std::mutex outputReadyMutex;
-				std::condition_variable outputReadyCondition;
-				bool outputReady = true;
+				// Only used if the `ioThread` option is enabled, to pass device-format data between RunThread() and RunCallbackThread().
+				std::optional<SpscRing> outputRing;
+				std::optional<SpscRing> inputRing;
 
-				std::thread thread;
+				static_assert(QA401::inputChannelCount == QA403::inputChannelCount);
+				// Only used if the `inputHighPassFilterHz` option is set. Carries the filter state from one input buffer to the next.
+				std::optional<SlotFilter<QA401::inputChannelCount>> inputHighPassFilter;
+
+				// The output of the output resampler for the ASIO buffer being copied to the device. Points into `PreparedState::outputResampler`.
+				std::span<const std::byte> outputResamplerOutput;
 			};
 
 			ASIO401& asio401;
 			
 			const ASIOCallbacks callbacks;
+			const StreamingLayout streamingLayout;
+			// Holds all the memory that is accessed while streaming: the ASIO buffers, and the streaming buffers.
+			MemoryArena memoryArena;
 			Buffers buffers;
+			StreamingBuffers streamingBuffers;
+			// Only used if the stream is resampled, in the directions that are streamed. Like the streaming buffers, these are allocated in advance; their
+			// state is reset when the stream starts. The output resampler consumes whole ASIO buffers, which are first converted to `outputResamplerInput`.
+			static_assert(QA401::outputChannelCount == QA403::outputChannelCount);
+			std::optional<Resampler<QA401::outputChannelCount>> outputResampler;
+			std::vector<std::byte> outputResamplerInput;
+			std::optional<Resampler<QA401::inputChannelCount>> inputResampler;
+			// Used instead of `inputResampler` if the sample rate ratio is a decimation.
+			std::optional<Decimator<QA401::inputChannelCount>> inputDecimator;
+			// Used by RunThread() as a ring buffer of the times at which recent stream recoveries began. There is room for `recoveryLimit` entries,
+			// which is all RunThread() needs to keep track of. Allocated in advance, like the streaming buffers; the ring starts empty on every stream.
+			std::vector<int64_t> recoveryBeginTimes;
+			const HighResolutionClock clock;
+			// Null if tracing is not enabled.
+			const std::unique_ptr<Tracer> tracer;
+			// If set, the device was left configured for this sample rate by the previous stream. Only accessed from the streaming thread while a stream is running.
+			std::optional<ASIOSampleRate> warmSampleRate;
 			const std::vector<ASIOBufferInfo> bufferInfos;
+			// These threads are reused across streams, so that starting the stream doesn't involve creating threads. They run
+			// `runningState->RunThread()` and `runningState->RunCallbackThread()`, respectively. The callback thread only exists if the `ioThread` option is enabled.
+			ReusableThread streamingThread;
+			std::optional<ReusableThread> callbackThread;
 			std::optional<RunningState> runningState;
 		};
 
@@ -172,10 +321,24 @@ namespace asio401 {
 		long GetDeviceOutputChannelCount() const { return WithDevice([](const auto& device) { return device.outputChannelCount; }); }
 		::dechamps_cpputil::Endianness GetDeviceSampleEndianness() const { return WithDevice([](const auto& device) { return device.sampleEndianness; }); }
 		size_t GetDeviceSampleSizeInBytes() const { return WithDevice([](const auto& device) { return device.sampleSizeInBytes; }); }
+		HostSampleType GetHostSampleType() const { return hostSampleType; }
+		size_t GetHostSampleSizeInBytes() const { return ::asio401::GetHostSampleSizeInBytes(hostSampleType); }
+		const std::vector<SampleCalibration>& GetInputCalibration() const { return inputCalibration; }
+		const std::vector<SampleCalibration>& GetOutputCalibration() const { return outputCalibration; }
 		size_t GetHardwareQueueSizeInFrames() const { return WithDevice([](const auto& device) { return device.hardwareQueueSizeInFrames; }); }
 		size_t GetDeviceWriteGranularityInFrames() const { return WithDevice([](const auto& device) { return device.writeGranularityInFrames; }); }
 
+		// Returns the sample rate that the device has to run at for the given host sample rate, or nothing if the host sample rate is not supported.
+		// Host sample rates that the device does not support natively, such as 44.1 kHz, are resampled from/to the next higher native rate. If the
+		// `deviceSampleRateHz` option is set, the device always runs at that rate, and lower host sample rates are resampled from/to it.
+		std::optional<ASIOSampleRate> GetDeviceSampleRate(ASIOSampleRate sampleRate) const;
+		SampleRateRatio GetSampleRateRatio(ASIOSampleRate sampleRate) const;
+		// ASIO buffer sizes must be a multiple of this, so that every ASIO buffer is resampled to a whole number of device frames, and, if `output`
+		// is true, so that these frames are compatible with the device write granularity.
+		size_t GetBufferSizeGranularityInFrames(bool output) const;
+
 		void ValidateConfig() const;
+		std::vector<SampleCalibration> ComputeCalibration(bool input) const;
 
 		struct BufferSizes {
 			long minimum;
@@ -187,11 +350,24 @@ namespace asio401 {
 
 		void ComputeLatencies(long* inputLatency, long* outputLatency, long bufferSizeInFrames, bool outputOnly) const;
 
-		static Device GetDevice();
+		// Note: the ASIO buffer size is in device frames. See GetSampleRateRatio().
+		UsbTransferLayout ComputeUsbTransferLayout(size_t bufferSizeInFrames) const;
+		// USB transfer sizes must be a multiple of this, so that they are compatible with the device write granularity and don't end with a short USB packet.
+		size_t ComputeUsbTransferAlignmentInFrames();
+
+		static Device GetDevice(const Config&);
 
 		const HWND windowHandle = nullptr;
 		const Config config;
 		Device device;
+		// The sample type of the ASIO buffers. The device itself always uses 32-bit integers; conversion happens while copying to and from the device buffers.
+		const HostSampleType hostSampleType;
+		// Indexed by ASIO channel number. Empty if there is no calibration for the current full scale level.
+		const std::vector<SampleCalibration> inputCalibration;
+		const std::vector<SampleCalibration> outputCalibration;
+		const size_t usbTransferAlignmentInFrames;
+		// Null if statistics could not be exported. Outlives streams, so that statistics accumulate across them.
+		const std::unique_ptr<StreamingStats> streamingStats;
 
 		ASIOSampleRate sampleRate = 48000;
 		bool sampleRateWasAccessed = false;
@@ -134,6 +134,8 @@ namespace asio401 {
 			}
 
 		private:
+			// Declared first, so that it keeps writing log messages until everything else is gone.
+			BackgroundLogWriter backgroundLogWriter;
 			std::string lastError;
 			std::optional<ASIO401> asio401;
 
@@ -0,0 +1,85 @@
+#include "clock_estimator.h"
+
+#include <cassert>
+#include <cmath>
+#include <numbers>
+
+namespace asio401 {
+
+	int64_t ClockEstimator::Estimate::GetTimeNanoseconds(int64_t framePosition) const {
+		return referenceTimeNanoseconds + std::llround(double(framePosition - referenceFramePosition) * nanosecondsPerFrame);
+	}
+
+	ClockEstimator::ClockEstimator(double nominalSampleRate, Options options) :
+		nominalNanosecondsPerFrame(1e9 / nominalSampleRate), options(options), nanosecondsPerFrame(nominalNanosecondsPerFrame) {}
+
+	std::optional<int64_t> ClockEstimator::Update(int64_t framePosition, int64_t timeNanoseconds) {
+		if (!originNanoseconds.has_value()) {
+			Reset(framePosition, timeNanoseconds);
+			return std::nullopt;
+		}
+		assert(framePosition > referenceFramePosition);
+		if (framePosition <= referenceFramePosition) return std::nullopt;
+
+		const auto elapsedFrames = double(framePosition - referenceFramePosition);
+		const auto predictedTimeNanoseconds = referenceTimeNanoseconds + elapsedFrames * nanosecondsPerFrame;
+		const auto errorNanoseconds = double(timeNanoseconds - *originNanoseconds) - predictedTimeNanoseconds;
+		if (std::abs(errorNanoseconds) > options.discontinuityThresholdNanoseconds) {
+			if (!discontinuityStartNanoseconds.has_value()) discontinuityStartNanoseconds = timeNanoseconds;
+			if (double(timeNanoseconds - *discontinuityStartNanoseconds) < options.discontinuityConfirmationNanoseconds) return std::nullopt;
+			++resetCount;
+			Reset(framePosition, timeNanoseconds);
+			return std::llround(errorNanoseconds);
+		}
+		discontinuityStartNanoseconds.reset();
+
+		// The loop coefficients depend on the time between updates, which is not necessarily constant (e.g. if ASIO buffers are split into USB
+		// transfers of different sizes). Use the nominal rate for that, so that the loop dynamics don't depend on the estimate itself.
+		const auto omega = 2 * std::numbers::pi * options.bandwidthHz * elapsedFrames * nominalNanosecondsPerFrame * 1e-9;
+		const auto b = std::numbers::sqrt2 * omega;
+		const auto c = omega * omega;
+		referenceTimeNanoseconds = predictedTimeNanoseconds + b * errorNanoseconds;
+		referenceFramePosition = framePosition;
+		nanosecondsPerFrame += c * errorNanoseconds / elapsedFrames;
+
+		if (!longTermReference.has_value() && double(framePosition - resetFramePosition) * nominalNanosecondsPerFrame >= options.settleTimeSeconds * 1e9)
+			longTermReference.emplace(referenceFramePosition, referenceTimeNanoseconds);
+		return std::nullopt;
+	}
+
+	void ClockEstimator::Restart() {
+		originNanoseconds.reset();
+		discontinuityStartNanoseconds.reset();
+	}
+
+	std::optional<ClockEstimator::Estimate> ClockEstimator::GetEstimate() const {
+		if (!originNanoseconds.has_value()) return std::nullopt;
+		return Estimate{
+			.referenceFramePosition = referenceFramePosition,
+			.referenceTimeNanoseconds = *originNanoseconds + std::llround(referenceTimeNanoseconds),
+			.nanosecondsPerFrame = nanosecondsPerFrame,
+			.sampleRate = GetSampleRate(),
+		};
+	}
+
+	double ClockEstimator::GetSampleRate() const {
+		if (longTermReference.has_value() && referenceFramePosition > longTermReference->first)
+			return double(referenceFramePosition - longTermReference->first) * 1e9 / (referenceTimeNanoseconds - longTermReference->second);
+		return 1e9 / nanosecondsPerFrame;
+	}
+
+	double ClockEstimator::GetDriftPPM() const {
+		return (GetSampleRate() * nominalNanosecondsPerFrame / 1e9 - 1) * 1e6;
+	}
+
+	void ClockEstimator::Reset(int64_t framePosition, int64_t timeNanoseconds) {
+		// Keep the current rate estimate, if any - a disruption in the stream doesn't mean the device clock changed.
+		originNanoseconds = timeNanoseconds;
+		referenceFramePosition = framePosition;
+		referenceTimeNanoseconds = 0;
+		longTermReference.reset();
+		resetFramePosition = framePosition;
+		discontinuityStartNanoseconds.reset();
+	}
+
+}
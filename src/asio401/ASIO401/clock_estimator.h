@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <utility>
+
+namespace asio401 {
+
+	// Tracks the QA40x sample clock against the computer clock, using a second order delay-locked loop (DLL). See "Using a DLL to filter time",
+	// F. Adriaensen, 2005.
+	//
+	// The estimator is fed with the times at which USB transfers complete. These are the best information we have on the progress of the device clock,
+	// but they are jittery, as they include the time it took for the operating system to wake up the streaming thread. The DLL filters out that jitter,
+	// while following the actual rate of the device clock, which is slightly different from nominal (typically by a few tens of ppm).
+	//
+	// The estimator also detects discontinuities in the stream, i.e. frames that were lost (or repeated) because the streaming thread fell behind and
+	// the device buffer overflowed (or underflowed). If that happens, the device clock and the frame positions are not in sync anymore: from then on,
+	// frames cross the USB bus later (or earlier) than predicted, by the duration of the lost (or repeated) frames. A single late observation is not
+	// enough to tell, as the streaming thread might have simply been late to observe a completion that happened on time; in that case subsequent
+	// observations will quickly be back on schedule. A discontinuity is only reported if observations are still off after a confirmation period.
+	//
+	// This class does not depend on any particular clock; all times are provided by the caller. This makes it possible to test it deterministically.
+	class ClockEstimator final {
+	public:
+		struct Options {
+			// The loop bandwidth. Lower values filter out more jitter, but make the loop slower to converge and to follow changes in the device clock.
+			double bandwidthHz = 0.5;
+			// If an observation deviates from the prediction by more than this, it is not used to update the loop, as it is either an outlier (e.g.
+			// the streaming thread was late) or the start of a discontinuity.
+			double discontinuityThresholdNanoseconds = 2e6;
+			// If observations still deviate from the prediction by more than the threshold after this time, a discontinuity is reported, and the
+			// estimator starts over from the latest observation.
+			double discontinuityConfirmationNanoseconds = 20e6;
+			// How long to let the loop settle before starting to measure the long-term sample rate. See GetSampleRate().
+			double settleTimeSeconds = 2;
+		};
+
+		// Trivially copyable, so that it can be shared with other threads through a Seqlock.
+		struct Estimate {
+			// A linear mapping between frame positions and (smoothed) times, which follows the device clock closely.
+			int64_t referenceFramePosition;
+			int64_t referenceTimeNanoseconds;
+			double nanosecondsPerFrame;
+			// See GetSampleRate().
+			double sampleRate;
+
+			int64_t GetTimeNanoseconds(int64_t framePosition) const;
+		};
+
+		ClockEstimator(double nominalSampleRate, Options);
+
+		// Notes that the frame at position `framePosition` (i.e. the first frame that was not transferred yet) crossed the USB bus at the given time.
+		// Frame positions must increase between calls.
+		// If this confirms a discontinuity, returns how far off the observation was, in nanoseconds: positive if it was late (i.e. frames were lost),
+		// negative if it was early (i.e. frames were repeated).
+		std::optional<int64_t> Update(int64_t framePosition, int64_t timeNanoseconds);
+		// Notes that the stream was restarted from scratch (e.g. after recovering from an error). Frame positions can start over, and the next call to
+		// Update() is used as the new starting point, without reporting a discontinuity. The rate estimate is kept, as the device clock did not change.
+		void Restart();
+
+		// Empty until the first call to Update(), and from Restart() until the next one.
+		std::optional<Estimate> GetEstimate() const;
+		// The actual device sample rate, as measured by the computer clock.
+		// The DLL rate estimate (i.e. the slope of the Estimate mapping) is too noisy to be reported as is - it varies by several ppm in order to track
+		// the device clock phase. Instead, this is measured over the long term, from the filtered times of two frame positions that are far apart, which
+		// gets more precise the longer the stream runs. Until the loop has settled, this is the DLL rate estimate.
+		double GetSampleRate() const;
+		// Deviation of the device sample rate from the nominal sample rate, in parts per million. Positive if the device clock is running fast.
+		double GetDriftPPM() const;
+		uint64_t GetResetCount() const { return resetCount; }
+
+	private:
+		void Reset(int64_t framePosition, int64_t timeNanoseconds);
+
+		const double nominalNanosecondsPerFrame;
+		const Options options;
+
+		// The filtered time of `referenceFramePosition`, relative to `originNanoseconds`. Times are stored relative to an origin so that double
+		// precision is not wasted on the (large) absolute time values.
+		std::optional<int64_t> originNanoseconds;
+		int64_t referenceFramePosition = 0;
+		double referenceTimeNanoseconds = 0;
+		double nanosecondsPerFrame;
+		// The first filtered reference after the loop has settled, from which the long-term sample rate is measured.
+		std::optional<std::pair<int64_t, double>> longTermReference;
+		int64_t resetFramePosition = 0;
+		uint64_t resetCount = 0;
+		// The time of the first observation of a possible discontinuity that is not confirmed yet.
+		std::optional<int64_t> discontinuityStartNanoseconds;
+	};
+
+}
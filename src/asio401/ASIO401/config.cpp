@@ -2,6 +2,7 @@
 
 #include "config.h"
 
+#include <cmath>
 #include <filesystem>
 
 #include <toml/toml.h>
@@ -81,18 +82,129 @@ namespace asio401 {
 			return SetOption(table, key, option, [](const T&) {});
 		}
 
+		std::vector<double> GetDoubleArray(const toml::Array& array) {
+			std::vector<double> result;
+			for (const auto& element : array) result.push_back(element.as<double>());
+			return result;
+		}
+
+		void ValidateCalibrationGain(const std::vector<double>& gainDB) {
+			for (const auto value : gainDB)
+				if (!std::isfinite(value)) throw std::runtime_error("calibration gain must be finite");
+		}
+
+		void ValidateCalibrationOffset(const std::vector<double>& offset) {
+			for (const auto value : offset)
+				if (!(std::abs(value) <= 1)) throw std::runtime_error("calibration offset must be between -1.0 and +1.0");
+		}
+
+		Config::Calibration GetCalibration(const toml::Table& table) {
+			std::optional<double> fullScaleLevelDBV;
+			SetOption(table, "fullScaleLevelDBV", fullScaleLevelDBV);
+			if (!fullScaleLevelDBV.has_value()) throw std::runtime_error("calibration table must specify 'fullScaleLevelDBV'");
+
+			Config::Calibration calibration;
+			calibration.fullScaleLevelDBV = *fullScaleLevelDBV;
+			ProcessTypedOption<toml::Array>(table, "gainDB", [&](const toml::Array& array) {
+				calibration.gainDB = GetDoubleArray(array);
+				ValidateCalibrationGain(calibration.gainDB);
+			});
+			ProcessTypedOption<toml::Array>(table, "offset", [&](const toml::Array& array) {
+				calibration.offset = GetDoubleArray(array);
+				ValidateCalibrationOffset(calibration.offset);
+			});
+			return calibration;
+		}
+
+		void SetCalibrationOption(const toml::Table& table, const std::string& key, std::vector<Config::Calibration>& option) {
+			ProcessTypedOption<toml::Array>(table, key, [&](const toml::Array& array) {
+				for (const auto& element : array) {
+					const auto calibration = GetCalibration(element.as<toml::Table>());
+					for (const auto& existingCalibration : option)
+						if (existingCalibration.fullScaleLevelDBV == calibration.fullScaleLevelDBV)
+							throw std::runtime_error("more than one calibration table for full scale level " + std::to_string(calibration.fullScaleLevelDBV) + " dBV");
+					option.push_back(calibration);
+				}
+			});
+		}
+
+		void ValidateInputHighPassFilterFrequency(const double& inputHighPassFilterHz) {
+			if (!(inputHighPassFilterHz > 0)) throw std::runtime_error("input high-pass filter cutoff frequency must be strictly positive");
+			if (inputHighPassFilterHz >= 20000) throw std::runtime_error("input high-pass filter cutoff frequency must be below 20000 Hz");
+		}
+
+		void ValidateInputHighPassFilterOrder(const int64_t& inputHighPassFilterOrder) {
+			if (inputHighPassFilterOrder != 1 && inputHighPassFilterOrder != 2) throw std::runtime_error("input high-pass filter order must be 1 or 2");
+		}
+
+		void ValidateSampleType(const std::string& sampleType) {
+			if (sampleType != "Int32" && sampleType != "Int24" && sampleType != "Float32" && sampleType != "Float64") throw std::runtime_error("sample type must be one of Int32, Int24, Float32 or Float64");
+		}
+
+		void ValidateDeviceSampleRate(const int64_t& deviceSampleRateHz) {
+			if (deviceSampleRateHz != 48000 && deviceSampleRateHz != 96000 && deviceSampleRateHz != 192000 && deviceSampleRateHz != 384000) throw std::runtime_error("device sample rate must be one of 48000, 96000, 192000 or 384000");
+		}
+
 		void ValidateBufferSize(const int64_t& bufferSizeSamples) {
 			if (bufferSizeSamples <= 0) throw std::runtime_error("buffer size must be strictly positive");
 			if (bufferSizeSamples >= (std::numeric_limits<long>::max)()) throw std::runtime_error("buffer size is too large");
 		}
 
+		void ValidateInflightTransfers(const int64_t& inflightTransfers) {
+			if (inflightTransfers < 2) throw std::runtime_error("number of inflight transfers must be at least 2");
+			if (inflightTransfers > 64) throw std::runtime_error("number of inflight transfers is too large");
+		}
+
+		void ValidateUsbTransferSize(const int64_t& usbTransferSizeSamples) {
+			if (usbTransferSizeSamples <= 0) throw std::runtime_error("USB transfer size must be strictly positive");
+			if (usbTransferSizeSamples >= (std::numeric_limits<long>::max)()) throw std::runtime_error("USB transfer size is too large");
+		}
+
+		void ValidateIoThreadRingDepth(const int64_t& ioThreadRingDepth) {
+			if (ioThreadRingDepth < 1) throw std::runtime_error("I/O thread ring depth must be at least 1");
+			if (ioThreadRingDepth > 64) throw std::runtime_error("I/O thread ring depth is too large");
+		}
+
+		void ValidateRecoveryLimit(const int64_t& recoveryLimit) {
+			if (recoveryLimit < 0) throw std::runtime_error("recovery limit cannot be negative");
+			if (recoveryLimit > 1000) throw std::runtime_error("recovery limit is too large");
+		}
+
+		void ValidateRecoveryWindow(const double& recoveryWindowSeconds) {
+			if (!(recoveryWindowSeconds > 0)) throw std::runtime_error("recovery window must be strictly positive");
+		}
+
+		void ValidateEmulator(const std::string& emulator) {
+			if (emulator != "QA401" && emulator != "QA402" && emulator != "QA403") throw std::runtime_error("emulated device must be one of QA401, QA402 or QA403");
+		}
+
+		void ValidateEmulatorFaultInterval(const double& emulatorFaultIntervalSeconds) {
+			if (!(emulatorFaultIntervalSeconds > 0)) throw std::runtime_error("emulator fault interval must be strictly positive");
+		}
+
 		void SetConfig(const toml::Table& table, Config& config) {
 			std::optional<bool> attenuator;
 			SetOption(table, "attenuator", attenuator);
 			SetOption(table, "fullScaleInputLevelDBV", config.fullScaleInputLevelDBV);
 			SetOption(table, "fullScaleOutputLevelDBV", config.fullScaleOutputLevelDBV);
+			SetCalibrationOption(table, "inputCalibration", config.inputCalibration);
+			SetCalibrationOption(table, "outputCalibration", config.outputCalibration);
+			SetOption(table, "inputHighPassFilterHz", config.inputHighPassFilterHz, ValidateInputHighPassFilterFrequency);
+			SetOption(table, "inputHighPassFilterOrder", config.inputHighPassFilterOrder, ValidateInputHighPassFilterOrder);
+			SetOption(table, "sampleType", config.sampleType, ValidateSampleType);
+			SetOption(table, "deviceSampleRateHz", config.deviceSampleRateHz, ValidateDeviceSampleRate);
 			SetOption(table, "bufferSizeSamples", config.bufferSizeSamples, ValidateBufferSize);
 			SetOption(table, "forceRead", config.forceRead);
+			SetOption(table, "inflightTransfers", config.inflightTransfers, ValidateInflightTransfers);
+			SetOption(table, "usbTransferSizeSamples", config.usbTransferSizeSamples, ValidateUsbTransferSize);
+			SetOption(table, "ioThread", config.ioThread);
+			SetOption(table, "ioThreadRingDepth", config.ioThreadRingDepth, ValidateIoThreadRingDepth);
+			SetOption(table, "lockMemory", config.lockMemory);
+			SetOption(table, "recoveryLimit", config.recoveryLimit, ValidateRecoveryLimit);
+			SetOption(table, "recoveryWindowSeconds", config.recoveryWindowSeconds, ValidateRecoveryWindow);
+			SetOption(table, "emulator", config.emulator, ValidateEmulator);
+			SetOption(table, "emulatorSampleClockErrorPPM", config.emulatorSampleClockErrorPPM);
+			SetOption(table, "emulatorFaultIntervalSeconds", config.emulatorFaultIntervalSeconds, ValidateEmulatorFaultInterval);
 
 			if (attenuator.has_value()) {
 				if (config.fullScaleInputLevelDBV.has_value())
@@ -2,14 +2,37 @@
 
 #include <optional>
 #include <string>
+#include <vector>
 
 namespace asio401 {
 
 	struct Config {
+		struct Calibration {
+			double fullScaleLevelDBV = 0;
+			std::vector<double> gainDB;
+			std::vector<double> offset;
+		};
+
 		std::optional<double> fullScaleInputLevelDBV;
 		std::optional<double> fullScaleOutputLevelDBV;
+		std::vector<Calibration> inputCalibration;
+		std::vector<Calibration> outputCalibration;
+		std::optional<double> inputHighPassFilterHz;
+		int64_t inputHighPassFilterOrder = 1;
+		std::string sampleType = "Int32";
+		std::optional<int64_t> deviceSampleRateHz;
 		std::optional<int64_t> bufferSizeSamples;
 		bool forceRead = false;
+		int64_t inflightTransfers = 2;
+		std::optional<int64_t> usbTransferSizeSamples;
+		bool ioThread = false;
+		int64_t ioThreadRingDepth = 1;
+		bool lockMemory = false;
+		int64_t recoveryLimit = 3;
+		double recoveryWindowSeconds = 60;
+		std::optional<std::string> emulator;
+		double emulatorSampleClockErrorPPM = 0;
+		std::optional<double> emulatorFaultIntervalSeconds;
 	};
 
 	std::optional<Config> LoadConfig();
@@ -0,0 +1,702 @@
+#include "conversion.h"
+
+#include "../ASIO401Util/cpu.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <numbers>
+#include <type_traits>
+
+#if defined(_M_IX86) || defined(_M_X64)
+#include <intrin.h>
+#define ASIO401_CONVERSION_X86
+#endif
+
+namespace asio401 {
+
+	namespace {
+
+		constexpr size_t deviceSampleSizeInBytes = sizeof(int32_t);
+
+		template <HostSampleType hostSampleType>
+		constexpr size_t hostSampleSizeInBytes = GetHostSampleSizeInBytes(hostSampleType);
+
+		template <HostSampleType hostSampleType>
+		constexpr bool isFloatHostSampleType = hostSampleType == HostSampleType::FLOAT32 || hostSampleType == HostSampleType::FLOAT64;
+
+		template <HostSampleType hostSampleType>
+		using HostFloat = std::conditional_t<hostSampleType == HostSampleType::FLOAT64, double, float>;
+
+		// 2^31, i.e. the device sample value that corresponds to a floating point sample value of 1.0.
+		constexpr double floatFullScale = 2147483648.0;
+		// Full scale in host sample units.
+		template <HostSampleType hostSampleType>
+		constexpr double hostFullScale = isFloatHostSampleType<hostSampleType> ? 1 : floatFullScale;
+		// The range that samples are clipped to before being converted to integers. The upper bound is the largest value representable in `Float` that
+		// does not overflow int32.
+		template <typename Float>
+		constexpr Float floatLowest = Float(-2147483648.0);
+		template <typename Float>
+		constexpr Float floatHighest = std::is_same_v<Float, float> ? Float(2147483520.0) : Float(2147483647.0);
+
+		// What happens to the samples of a given channel slot, for a given direction and host sample type.
+		struct SlotTransform {
+			// Only used for integer host samples that are not calibrated.
+			bool invertPolarity = false;
+			// Used for floating point host samples, and for integer host samples that are calibrated: samples are multiplied by `scale`, then `offset` is
+			// added. This folds conversion between host and device full scale, polarity inversion and calibration into a single multiply-add.
+			double scale = 1;
+			double offset = 0;
+		};
+
+		template <HostSampleType hostSampleType>
+		SlotTransform GetToDeviceSlotTransform(const bool invertPolarity, const SampleCalibration& calibration) {
+			const auto sign = invertPolarity ? -1.0 : 1.0;
+			return {
+				.invertPolarity = invertPolarity,
+				.scale = sign * calibration.gain * floatFullScale / hostFullScale<hostSampleType>,
+				.offset = sign * calibration.offset * floatFullScale,
+			};
+		}
+
+		template <HostSampleType hostSampleType>
+		SlotTransform GetFromDeviceSlotTransform(const bool invertPolarity, const SampleCalibration& calibration) {
+			const auto sign = invertPolarity ? -1.0 : 1.0;
+			return {
+				.invertPolarity = invertPolarity,
+				.scale = sign * calibration.gain * hostFullScale<hostSampleType> / floatFullScale,
+				.offset = calibration.offset * hostFullScale<hostSampleType>,
+			};
+		}
+
+		int32_t LoadSample(const std::byte* const sample) {
+			int32_t value;
+			memcpy(&value, sample, sizeof(value));
+			return value;
+		}
+
+		void StoreSample(std::byte* const sample, const int32_t value) {
+			memcpy(sample, &value, sizeof(value));
+		}
+
+		// 24-bit samples are converted to and from 32-bit samples of the same scale, i.e. they occupy the upper 3 bytes. Conversion to 24-bit truncates.
+		int32_t LoadInt24Sample(const std::byte* const sample) {
+			int32_t value = 0;
+			memcpy(reinterpret_cast<std::byte*>(&value) + (std::endian::native == std::endian::little ? 1 : 0), sample, 3);
+			return value;
+		}
+
+		void StoreInt24Sample(std::byte* const sample, const int32_t value) {
+			memcpy(sample, reinterpret_cast<const std::byte*>(&value) + (std::endian::native == std::endian::little ? 1 : 0), 3);
+		}
+
+		int32_t InvertPolarity(const int32_t sample) {
+			return sample == (std::numeric_limits<int32_t>::min)() ? (std::numeric_limits<int32_t>::max)() : -sample;
+		}
+
+		int32_t SwapEndianness(const int32_t sample) {
+			return int32_t(_byteswap_ulong(uint32_t(sample)));
+		}
+
+		template <bool swapEndianness>
+		int32_t MaybeSwapEndianness(const int32_t sample) {
+			if constexpr (swapEndianness) return SwapEndianness(sample);
+			else return sample;
+		}
+
+		// Samples are clipped the same way as in the SIMD kernels: comparisons are written so that NaN ends up as negative full scale.
+		template <typename Float>
+		int32_t ClipToInt32(Float value) {
+			value = value > floatLowest<Float> ? value : floatLowest<Float>;
+			value = value < floatHighest<Float> ? value : floatHighest<Float>;
+			return int32_t(std::nearbyint(value));
+		}
+
+		// ASIO buffer sample -> native endianness 32-bit integer sample, with polarity and calibration applied.
+		// `calibrated` only makes a difference for integer samples; floating point samples always go through the multiply-add.
+		template <HostSampleType hostSampleType, bool calibrated>
+		int32_t LoadHostSample(const std::byte* const sample, const SlotTransform& slotTransform) {
+			if constexpr (isFloatHostSampleType<hostSampleType>) {
+				using Float = HostFloat<hostSampleType>;
+				Float value;
+				memcpy(&value, sample, sizeof(value));
+				return ClipToInt32<Float>(value * Float(slotTransform.scale) + Float(slotTransform.offset));
+			}
+			else {
+				const auto value = hostSampleType == HostSampleType::INT24 ? LoadInt24Sample(sample) : LoadSample(sample);
+				if constexpr (calibrated) return ClipToInt32<double>(double(value) * slotTransform.scale + slotTransform.offset);
+				else return slotTransform.invertPolarity ? InvertPolarity(value) : value;
+			}
+		}
+
+		// Native endianness 32-bit integer sample -> ASIO buffer sample, with polarity and calibration applied.
+		template <HostSampleType hostSampleType, bool calibrated>
+		void StoreHostSample(std::byte* const sample, int32_t value, const SlotTransform& slotTransform) {
+			if constexpr (isFloatHostSampleType<hostSampleType>) {
+				using Float = HostFloat<hostSampleType>;
+				const Float floatValue = Float(value) * Float(slotTransform.scale) + Float(slotTransform.offset);
+				memcpy(sample, &floatValue, sizeof(floatValue));
+			}
+			else {
+				if constexpr (calibrated) value = ClipToInt32<double>(double(value) * slotTransform.scale + slotTransform.offset);
+				else if (slotTransform.invertPolarity) value = InvertPolarity(value);
+				if constexpr (hostSampleType == HostSampleType::INT24) StoreInt24Sample(sample, value);
+				else StoreSample(sample, value);
+			}
+		}
+
+		// All kernels below process frames [firstFrame, frameCount) and return the index of the first frame they did not process.
+		// SIMD kernels only process whole vectors; the scalar kernels are used to finish the job.
+
+		template <HostSampleType hostSampleType, bool calibrated, bool swapEndianness, bool hasSlot0, bool hasSlot1>
+		void InterleaveInt32x2Scalar(const std::byte* const slot0, const std::byte* const slot1, std::byte* const destination, const std::array<SlotTransform, 2>& slotTransforms, size_t frame, const size_t frameCount) {
+			constexpr auto sourceSampleSizeInBytes = hostSampleSizeInBytes<hostSampleType>;
+			for (; frame < frameCount; ++frame) {
+				std::byte* const destinationFrame = destination + frame * 2 * deviceSampleSizeInBytes;
+				StoreSample(destinationFrame, hasSlot0 ? MaybeSwapEndianness<swapEndianness>(LoadHostSample<hostSampleType, calibrated>(slot0 + frame * sourceSampleSizeInBytes, slotTransforms[0])) : 0);
+				StoreSample(destinationFrame + deviceSampleSizeInBytes, hasSlot1 ? MaybeSwapEndianness<swapEndianness>(LoadHostSample<hostSampleType, calibrated>(slot1 + frame * sourceSampleSizeInBytes, slotTransforms[1])) : 0);
+			}
+		}
+
+		template <HostSampleType hostSampleType, bool calibrated, bool swapEndianness, bool hasSlot0, bool hasSlot1>
+		void DeinterleaveInt32x2Scalar(const std::byte* const source, std::byte* const slot0, std::byte* const slot1, const std::array<SlotTransform, 2>& slotTransforms, size_t frame, const size_t frameCount) {
+			constexpr auto destinationSampleSizeInBytes = hostSampleSizeInBytes<hostSampleType>;
+			for (; frame < frameCount; ++frame) {
+				const std::byte* const sourceFrame = source + frame * 2 * deviceSampleSizeInBytes;
+				if constexpr (hasSlot0) StoreHostSample<hostSampleType, calibrated>(slot0 + frame * destinationSampleSizeInBytes, MaybeSwapEndianness<swapEndianness>(LoadSample(sourceFrame)), slotTransforms[0]);
+				if constexpr (hasSlot1) StoreHostSample<hostSampleType, calibrated>(slot1 + frame * destinationSampleSizeInBytes, MaybeSwapEndianness<swapEndianness>(LoadSample(sourceFrame + deviceSampleSizeInBytes)), slotTransforms[1]);
+			}
+		}
+
+#ifdef ASIO401_CONVERSION_X86
+		// The instruction set used by the 128-bit kernels. SSE2 is always available; SSSE3 adds a byte shuffle instruction (pshufb) which makes endianness swapping cheaper,
+		// and is required for 24-bit samples.
+		enum class Sse { SSE2, SSSE3 };
+
+		// `mask` is all ones in the lanes that need to be inverted, all zeros otherwise.
+		__m128i InvertPolaritySse(__m128i samples, const __m128i mask) {
+			// Turn the most negative value into its successor first, so that it does not wrap around when negated.
+			samples = _mm_sub_epi32(samples, _mm_and_si128(_mm_cmpeq_epi32(samples, _mm_set1_epi32((std::numeric_limits<int32_t>::min)())), mask));
+			// Two's complement negation where the mask is set, no-op elsewhere.
+			return _mm_sub_epi32(_mm_xor_si128(samples, mask), mask);
+		}
+
+		template <Sse sse>
+		__m128i SwapEndiannessSse(__m128i samples) {
+			if constexpr (sse == Sse::SSSE3) {
+				return _mm_shuffle_epi8(samples, _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+			}
+			else {
+				// SSE2 has no byte shuffle instruction, so swap the 16-bit halves of each sample, then the bytes within each half.
+				samples = _mm_or_si128(_mm_slli_epi32(samples, 16), _mm_srli_epi32(samples, 16));
+				return _mm_or_si128(_mm_slli_epi16(samples, 8), _mm_srli_epi16(samples, 8));
+			}
+		}
+
+		template <Sse sse, bool swapEndianness>
+		__m128i MaybeSwapEndiannessSse(const __m128i samples) {
+			if constexpr (swapEndianness) return SwapEndiannessSse<sse>(samples);
+			else return samples;
+		}
+
+		// SlotTransform, broadcast to all lanes in every representation the kernels might need. The compiler drops the ones that are not used.
+		struct SlotTransformSse {
+			__m128i invertPolarityMask;
+			__m128 scaleFloat32;
+			__m128 offsetFloat32;
+			__m128d scaleFloat64;
+			__m128d offsetFloat64;
+		};
+
+		SlotTransformSse GetSlotTransformSse(const SlotTransform& slotTransform) {
+			return {
+				.invertPolarityMask = _mm_set1_epi32(slotTransform.invertPolarity ? -1 : 0),
+				.scaleFloat32 = _mm_set1_ps(float(slotTransform.scale)),
+				.offsetFloat32 = _mm_set1_ps(float(slotTransform.offset)),
+				.scaleFloat64 = _mm_set1_pd(slotTransform.scale),
+				.offsetFloat64 = _mm_set1_pd(slotTransform.offset),
+			};
+		}
+
+		// maxps/minps return the second operand if either is NaN, which matches the scalar code.
+		__m128i ClipToInt32Sse(const __m128 samples) {
+			return _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(samples, _mm_set1_ps(floatLowest<float>)), _mm_set1_ps(floatHighest<float>)));
+		}
+
+		// Converts two doubles into two int32 in the lower half of the result.
+		__m128i ClipToInt32Sse(const __m128d samples) {
+			return _mm_cvtpd_epi32(_mm_min_pd(_mm_max_pd(samples, _mm_set1_pd(floatLowest<double>)), _mm_set1_pd(floatHighest<double>)));
+		}
+
+		__m128d MultiplyAddFloat64Sse(const __m128d samples, const SlotTransformSse& slotTransform) {
+			return _mm_add_pd(_mm_mul_pd(samples, slotTransform.scaleFloat64), slotTransform.offsetFloat64);
+		}
+
+		// Calibrated integer samples go through double precision, which represents every int32 value exactly, and saturate on the way back. This also
+		// sidesteps the lack of a signed 32x32-bit multiply in SSE2.
+		__m128i CalibrateInt32Sse(const __m128i samples, const SlotTransformSse& slotTransform) {
+			return _mm_unpacklo_epi64(
+				ClipToInt32Sse(MultiplyAddFloat64Sse(_mm_cvtepi32_pd(samples), slotTransform)),
+				ClipToInt32Sse(MultiplyAddFloat64Sse(_mm_cvtepi32_pd(_mm_unpackhi_epi64(samples, samples)), slotTransform)));
+		}
+
+		// 4 packed 24-bit samples are exactly 12 bytes. Don't touch the 4 bytes after that, as they could be past the end of the buffer.
+		__m128i LoadInt24x4Sse(const std::byte* const samples) {
+			int32_t last;
+			memcpy(&last, samples + 8, sizeof(last));
+			return _mm_shuffle_epi8(
+				_mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(samples)), _mm_cvtsi32_si128(last)),
+				_mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11));
+		}
+
+		void StoreInt24x4Sse(std::byte* const samples, __m128i values) {
+			values = _mm_shuffle_epi8(values, _mm_setr_epi8(1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, -1, -1, -1, -1));
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(samples), values);
+			const auto last = _mm_cvtsi128_si32(_mm_srli_si128(values, 8));
+			memcpy(samples + 8, &last, sizeof(last));
+		}
+
+		// Loads 4 samples from an ASIO buffer, and returns them as native endianness 32-bit integers with polarity and calibration applied.
+		template <HostSampleType hostSampleType, bool calibrated>
+		__m128i LoadHostSamplesSse(const std::byte* const samples, const SlotTransformSse& slotTransform) {
+			if constexpr (hostSampleType == HostSampleType::FLOAT32) {
+				return ClipToInt32Sse(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(reinterpret_cast<const float*>(samples)), slotTransform.scaleFloat32), slotTransform.offsetFloat32));
+			}
+			else if constexpr (hostSampleType == HostSampleType::FLOAT64) {
+				return _mm_unpacklo_epi64(
+					ClipToInt32Sse(MultiplyAddFloat64Sse(_mm_loadu_pd(reinterpret_cast<const double*>(samples)), slotTransform)),
+					ClipToInt32Sse(MultiplyAddFloat64Sse(_mm_loadu_pd(reinterpret_cast<const double*>(samples) + 2), slotTransform)));
+			}
+			else {
+				const auto values = hostSampleType == HostSampleType::INT24 ? LoadInt24x4Sse(samples) : _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples));
+				if constexpr (calibrated) return CalibrateInt32Sse(values, slotTransform);
+				else return InvertPolaritySse(values, slotTransform.invertPolarityMask);
+			}
+		}
+
+		// The reverse of LoadHostSamplesSse().
+		template <HostSampleType hostSampleType, bool calibrated>
+		void StoreHostSamplesSse(std::byte* const samples, __m128i values, const SlotTransformSse& slotTransform) {
+			if constexpr (hostSampleType == HostSampleType::FLOAT32) {
+				_mm_storeu_ps(reinterpret_cast<float*>(samples), _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(values), slotTransform.scaleFloat32), slotTransform.offsetFloat32));
+			}
+			else if constexpr (hostSampleType == HostSampleType::FLOAT64) {
+				_mm_storeu_pd(reinterpret_cast<double*>(samples), MultiplyAddFloat64Sse(_mm_cvtepi32_pd(values), slotTransform));
+				_mm_storeu_pd(reinterpret_cast<double*>(samples) + 2, MultiplyAddFloat64Sse(_mm_cvtepi32_pd(_mm_unpackhi_epi64(values, values)), slotTransform));
+			}
+			else {
+				if constexpr (calibrated) values = CalibrateInt32Sse(values, slotTransform);
+				else values = InvertPolaritySse(values, slotTransform.invertPolarityMask);
+				if constexpr (hostSampleType == HostSampleType::INT24) StoreInt24x4Sse(samples, values);
+				else _mm_storeu_si128(reinterpret_cast<__m128i*>(samples), values);
+			}
+		}
+
+		template <Sse sse, HostSampleType hostSampleType, bool calibrated, bool swapEndianness, bool hasSlot0, bool hasSlot1>
+		size_t InterleaveInt32x2Sse(const std::byte* const slot0, const std::byte* const slot1, std::byte* const destination, const std::array<SlotTransform, 2>& slotTransforms, const size_t frameCount) {
+			constexpr size_t framesPerIteration = 4;
+			constexpr auto sourceSampleSizeInBytes = hostSampleSizeInBytes<hostSampleType>;
+			const auto slotTransform0 = GetSlotTransformSse(slotTransforms[0]);
+			const auto slotTransform1 = GetSlotTransformSse(slotTransforms[1]);
+			size_t frame = 0;
+			for (; frame + framesPerIteration <= frameCount; frame += framesPerIteration) {
+				const __m128i left = hasSlot0 ? MaybeSwapEndiannessSse<sse, swapEndianness>(LoadHostSamplesSse<hostSampleType, calibrated>(slot0 + frame * sourceSampleSizeInBytes, slotTransform0)) : _mm_setzero_si128();
+				const __m128i right = hasSlot1 ? MaybeSwapEndiannessSse<sse, swapEndianness>(LoadHostSamplesSse<hostSampleType, calibrated>(slot1 + frame * sourceSampleSizeInBytes, slotTransform1)) : _mm_setzero_si128();
+				__m128i* const destinationVector = reinterpret_cast<__m128i*>(destination + frame * 2 * deviceSampleSizeInBytes);
+				_mm_storeu_si128(destinationVector, _mm_unpacklo_epi32(left, right));
+				_mm_storeu_si128(destinationVector + 1, _mm_unpackhi_epi32(left, right));
+			}
+			return frame;
+		}
+
+		template <Sse sse, HostSampleType hostSampleType, bool calibrated, bool swapEndianness, bool hasSlot0, bool hasSlot1>
+		size_t DeinterleaveInt32x2Sse(const std::byte* const source, std::byte* const slot0, std::byte* const slot1, const std::array<SlotTransform, 2>& slotTransforms, const size_t frameCount) {
+			constexpr size_t framesPerIteration = 4;
+			constexpr auto destinationSampleSizeInBytes = hostSampleSizeInBytes<hostSampleType>;
+			const auto slotTransform0 = GetSlotTransformSse(slotTransforms[0]);
+			const auto slotTransform1 = GetSlotTransformSse(slotTransforms[1]);
+			size_t frame = 0;
+			for (; frame + framesPerIteration <= frameCount; frame += framesPerIteration) {
+				const __m128i* const sourceVector = reinterpret_cast<const __m128i*>(source + frame * 2 * deviceSampleSizeInBytes);
+				// L0 R0 L1 R1, L2 R2 L3 R3 -> L0 L1 R0 R1, L2 L3 R2 R3
+				const __m128i first = _mm_shuffle_epi32(_mm_loadu_si128(sourceVector), _MM_SHUFFLE(3, 1, 2, 0));
+				const __m128i second = _mm_shuffle_epi32(_mm_loadu_si128(sourceVector + 1), _MM_SHUFFLE(3, 1, 2, 0));
+				if constexpr (hasSlot0) StoreHostSamplesSse<hostSampleType, calibrated>(slot0 + frame * destinationSampleSizeInBytes, MaybeSwapEndiannessSse<sse, swapEndianness>(_mm_unpacklo_epi64(first, second)), slotTransform0);
+				if constexpr (hasSlot1) StoreHostSamplesSse<hostSampleType, calibrated>(slot1 + frame * destinationSampleSizeInBytes, MaybeSwapEndiannessSse<sse, swapEndianness>(_mm_unpackhi_epi64(first, second)), slotTransform1);
+			}
+			return frame;
+		}
+
+		__m256i InvertPolarityAvx2(__m256i samples, const __m256i mask) {
+			samples = _mm256_sub_epi32(samples, _mm256_and_si256(_mm256_cmpeq_epi32(samples, _mm256_set1_epi32((std::numeric_limits<int32_t>::min)())), mask));
+			return _mm256_sub_epi32(_mm256_xor_si256(samples, mask), mask);
+		}
+
+		__m256i SwapEndiannessAvx2(const __m256i samples) {
+			return _mm256_shuffle_epi8(samples, _mm256_setr_epi8(
+				3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+				3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+		}
+
+		template <bool swapEndianness>
+		__m256i MaybeSwapEndiannessAvx2(const __m256i samples) {
+			if constexpr (swapEndianness) return SwapEndiannessAvx2(samples);
+			else return samples;
+		}
+
+		struct SlotTransformAvx2 {
+			__m256i invertPolarityMask;
+			__m256 scaleFloat32;
+			__m256 offsetFloat32;
+			__m256d scaleFloat64;
+			__m256d offsetFloat64;
+		};
+
+		SlotTransformAvx2 GetSlotTransformAvx2(const SlotTransform& slotTransform) {
+			return {
+				.invertPolarityMask = _mm256_set1_epi32(slotTransform.invertPolarity ? -1 : 0),
+				.scaleFloat32 = _mm256_set1_ps(float(slotTransform.scale)),
+				.offsetFloat32 = _mm256_set1_ps(float(slotTransform.offset)),
+				.scaleFloat64 = _mm256_set1_pd(slotTransform.scale),
+				.offsetFloat64 = _mm256_set1_pd(slotTransform.offset),
+			};
+		}
+
+		__m256i ClipToInt32Avx2(const __m256 samples) {
+			return _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(samples, _mm256_set1_ps(floatLowest<float>)), _mm256_set1_ps(floatHighest<float>)));
+		}
+
+		__m128i ClipToInt32Avx2(const __m256d samples) {
+			return _mm256_cvtpd_epi32(_mm256_min_pd(_mm256_max_pd(samples, _mm256_set1_pd(floatLowest<double>)), _mm256_set1_pd(floatHighest<double>)));
+		}
+
+		__m256d MultiplyAddFloat64Avx2(const __m256d samples, const SlotTransformAvx2& slotTransform) {
+			return _mm256_add_pd(_mm256_mul_pd(samples, slotTransform.scaleFloat64), slotTransform.offsetFloat64);
+		}
+
+		__m256i CombineInt32x4Avx2(const __m128i low, const __m128i high) {
+			return _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+		}
+
+		__m256i CalibrateInt32Avx2(const __m256i samples, const SlotTransformAvx2& slotTransform) {
+			return CombineInt32x4Avx2(
+				ClipToInt32Avx2(MultiplyAddFloat64Avx2(_mm256_cvtepi32_pd(_mm256_castsi256_si128(samples)), slotTransform)),
+				ClipToInt32Avx2(MultiplyAddFloat64Avx2(_mm256_cvtepi32_pd(_mm256_extracti128_si256(samples, 1)), slotTransform)));
+		}
+
+		// Each 128-bit lane holds 4 samples, which come from (or go to) consecutive 12-byte blocks.
+		__m256i LoadInt24x8Avx2(const std::byte* const samples) {
+			return CombineInt32x4Avx2(LoadInt24x4Sse(samples), LoadInt24x4Sse(samples + 12));
+		}
+
+		void StoreInt24x8Avx2(std::byte* const samples, const __m256i values) {
+			StoreInt24x4Sse(samples, _mm256_castsi256_si128(values));
+			StoreInt24x4Sse(samples + 12, _mm256_extracti128_si256(values, 1));
+		}
+
+		// Same as LoadHostSamplesSse(), but for 8 samples.
+		template <HostSampleType hostSampleType, bool calibrated>
+		__m256i LoadHostSamplesAvx2(const std::byte* const samples, const SlotTransformAvx2& slotTransform) {
+			if constexpr (hostSampleType == HostSampleType::FLOAT32) {
+				return ClipToInt32Avx2(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(reinterpret_cast<const float*>(samples)), slotTransform.scaleFloat32), slotTransform.offsetFloat32));
+			}
+			else if constexpr (hostSampleType == HostSampleType::FLOAT64) {
+				return CombineInt32x4Avx2(
+					ClipToInt32Avx2(MultiplyAddFloat64Avx2(_mm256_loadu_pd(reinterpret_cast<const double*>(samples)), slotTransform)),
+					ClipToInt32Avx2(MultiplyAddFloat64Avx2(_mm256_loadu_pd(reinterpret_cast<const double*>(samples) + 4), slotTransform)));
+			}
+			else {
+				const auto values = hostSampleType == HostSampleType::INT24 ? LoadInt24x8Avx2(samples) : _mm256_loadu_si256(reinterpret_cast<const __m256i*>(samples));
+				if constexpr (calibrated) return CalibrateInt32Avx2(values, slotTransform);
+				else return InvertPolarityAvx2(values, slotTransform.invertPolarityMask);
+			}
+		}
+
+		template <HostSampleType hostSampleType, bool calibrated>
+		void StoreHostSamplesAvx2(std::byte* const samples, __m256i values, const SlotTransformAvx2& slotTransform) {
+			if constexpr (hostSampleType == HostSampleType::FLOAT32) {
+				_mm256_storeu_ps(reinterpret_cast<float*>(samples), _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(values), slotTransform.scaleFloat32), slotTransform.offsetFloat32));
+			}
+			else if constexpr (hostSampleType == HostSampleType::FLOAT64) {
+				_mm256_storeu_pd(reinterpret_cast<double*>(samples), MultiplyAddFloat64Avx2(_mm256_cvtepi32_pd(_mm256_castsi256_si128(values)), slotTransform));
+				_mm256_storeu_pd(reinterpret_cast<double*>(samples) + 4, MultiplyAddFloat64Avx2(_mm256_cvtepi32_pd(_mm256_extracti128_si256(values, 1)), slotTransform));
+			}
+			else {
+				if constexpr (calibrated) values = CalibrateInt32Avx2(values, slotTransform);
+				else values = InvertPolarityAvx2(values, slotTransform.invertPolarityMask);
+				if constexpr (hostSampleType == HostSampleType::INT24) StoreInt24x8Avx2(samples, values);
+				else _mm256_storeu_si256(reinterpret_cast<__m256i*>(samples), values);
+			}
+		}
+
+		template <HostSampleType hostSampleType, bool calibrated, bool swapEndianness, bool hasSlot0, bool hasSlot1>
+		size_t InterleaveInt32x2Avx2(const std::byte* const slot0, const std::byte* const slot1, std::byte* const destination, const std::array<SlotTransform, 2>& slotTransforms, const size_t frameCount) {
+			constexpr size_t framesPerIteration = 8;
+			constexpr auto sourceSampleSizeInBytes = hostSampleSizeInBytes<hostSampleType>;
+			const auto slotTransform0 = GetSlotTransformAvx2(slotTransforms[0]);
+			const auto slotTransform1 = GetSlotTransformAvx2(slotTransforms[1]);
+			size_t frame = 0;
+			for (; frame + framesPerIteration <= frameCount; frame += framesPerIteration) {
+				const __m256i left = hasSlot0 ? MaybeSwapEndiannessAvx2<swapEndianness>(LoadHostSamplesAvx2<hostSampleType, calibrated>(slot0 + frame * sourceSampleSizeInBytes, slotTransform0)) : _mm256_setzero_si256();
+				const __m256i right = hasSlot1 ? MaybeSwapEndiannessAvx2<swapEndianness>(LoadHostSamplesAvx2<hostSampleType, calibrated>(slot1 + frame * sourceSampleSizeInBytes, slotTransform1)) : _mm256_setzero_si256();
+				// Unpacking works within 128-bit lanes, so we end up with frames 0-1 and 4-5 in `low`, and frames 2-3 and 6-7 in `high`.
+				const __m256i low = _mm256_unpacklo_epi32(left, right);
+				const __m256i high = _mm256_unpackhi_epi32(left, right);
+				__m256i* const destinationVector = reinterpret_cast<__m256i*>(destination + frame * 2 * deviceSampleSizeInBytes);
+				_mm256_storeu_si256(destinationVector, _mm256_permute2x128_si256(low, high, 0x20));
+				_mm256_storeu_si256(destinationVector + 1, _mm256_permute2x128_si256(low, high, 0x31));
+			}
+			// Avoid AVX-SSE transition penalties in the code that runs after us.
+			_mm256_zeroupper();
+			return frame;
+		}
+
+		template <HostSampleType hostSampleType, bool calibrated, bool swapEndianness, bool hasSlot0, bool hasSlot1>
+		size_t DeinterleaveInt32x2Avx2(const std::byte* const source, std::byte* const slot0, std::byte* const slot1, const std::array<SlotTransform, 2>& slotTransforms, const size_t frameCount) {
+			constexpr size_t framesPerIteration = 8;
+			constexpr auto destinationSampleSizeInBytes = hostSampleSizeInBytes<hostSampleType>;
+			const __m256i permutation = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+			const auto slotTransform0 = GetSlotTransformAvx2(slotTransforms[0]);
+			const auto slotTransform1 = GetSlotTransformAvx2(slotTransforms[1]);
+			size_t frame = 0;
+			for (; frame + framesPerIteration <= frameCount; frame += framesPerIteration) {
+				const __m256i* const sourceVector = reinterpret_cast<const __m256i*>(source + frame * 2 * deviceSampleSizeInBytes);
+				// L0 R0 L1 R1 L2 R2 L3 R3 -> L0 L1 L2 L3 R0 R1 R2 R3
+				const __m256i first = _mm256_permutevar8x32_epi32(_mm256_loadu_si256(sourceVector), permutation);
+				const __m256i second = _mm256_permutevar8x32_epi32(_mm256_loadu_si256(sourceVector + 1), permutation);
+				if constexpr (hasSlot0) StoreHostSamplesAvx2<hostSampleType, calibrated>(slot0 + frame * destinationSampleSizeInBytes, MaybeSwapEndiannessAvx2<swapEndianness>(_mm256_permute2x128_si256(first, second, 0x20)), slotTransform0);
+				if constexpr (hasSlot1) StoreHostSamplesAvx2<hostSampleType, calibrated>(slot1 + frame * destinationSampleSizeInBytes, MaybeSwapEndiannessAvx2<swapEndianness>(_mm256_permute2x128_si256(first, second, 0x31)), slotTransform1);
+			}
+			_mm256_zeroupper();
+			return frame;
+		}
+#endif
+
+		template <HostSampleType hostSampleType, bool calibrated, bool swapEndianness, bool hasSlot0, bool hasSlot1>
+		void InterleaveInt32x2Slots(const std::byte* const slot0, const std::byte* const slot1, std::byte* const destination, const std::array<SlotTransform, 2>& slotTransforms, const size_t frameCount, const CpuFeatures& cpuFeatures) {
+			size_t frame = 0;
+#ifdef ASIO401_CONVERSION_X86
+			if (cpuFeatures.avx2) frame = InterleaveInt32x2Avx2<hostSampleType, calibrated, swapEndianness, hasSlot0, hasSlot1>(slot0, slot1, destination, slotTransforms, frameCount);
+			// The SSSE3 kernel only differs from the SSE2 kernel in the way it swaps endianness and packs 24-bit samples.
+			else if (cpuFeatures.ssse3 && (swapEndianness || hostSampleType == HostSampleType::INT24)) frame = InterleaveInt32x2Sse<Sse::SSSE3, hostSampleType, calibrated, swapEndianness, hasSlot0, hasSlot1>(slot0, slot1, destination, slotTransforms, frameCount);
+			// Packing 24-bit samples without a byte shuffle instruction is not worth it; leave them to the scalar kernel.
+			else if constexpr (hostSampleType != HostSampleType::INT24) frame = InterleaveInt32x2Sse<Sse::SSE2, hostSampleType, calibrated, swapEndianness, hasSlot0, hasSlot1>(slot0, slot1, destination, slotTransforms, frameCount);
+#endif
+			InterleaveInt32x2Scalar<hostSampleType, calibrated, swapEndianness, hasSlot0, hasSlot1>(slot0, slot1, destination, slotTransforms, frame, frameCount);
+		}
+
+		template <HostSampleType hostSampleType, bool calibrated, bool swapEndianness, bool hasSlot0, bool hasSlot1>
+		void DeinterleaveInt32x2Slots(const std::byte* const source, std::byte* const slot0, std::byte* const slot1, const std::array<SlotTransform, 2>& slotTransforms, const size_t frameCount, const CpuFeatures& cpuFeatures) {
+			size_t frame = 0;
+#ifdef ASIO401_CONVERSION_X86
+			if (cpuFeatures.avx2) frame = DeinterleaveInt32x2Avx2<hostSampleType, calibrated, swapEndianness, hasSlot0, hasSlot1>(source, slot0, slot1, slotTransforms, frameCount);
+			else if (cpuFeatures.ssse3 && (swapEndianness || hostSampleType == HostSampleType::INT24)) frame = DeinterleaveInt32x2Sse<Sse::SSSE3, hostSampleType, calibrated, swapEndianness, hasSlot0, hasSlot1>(source, slot0, slot1, slotTransforms, frameCount);
+			else if constexpr (hostSampleType != HostSampleType::INT24) frame = DeinterleaveInt32x2Sse<Sse::SSE2, hostSampleType, calibrated, swapEndianness, hasSlot0, hasSlot1>(source, slot0, slot1, slotTransforms, frameCount);
+#endif
+			DeinterleaveInt32x2Scalar<hostSampleType, calibrated, swapEndianness, hasSlot0, hasSlot1>(source, slot0, slot1, slotTransforms, frame, frameCount);
+		}
+
+		template <HostSampleType hostSampleType, bool calibrated, bool swapEndianness>
+		void InterleaveInt32x2(const std::array<const std::byte*, 2>& sources, std::byte* const destination, const std::array<SlotTransform, 2>& slotTransforms, const size_t frameCount, const CpuFeatures& cpuFeatures) {
+			const auto slot0 = sources[0];
+			const auto slot1 = sources[1];
+			if (slot0 != nullptr && slot1 != nullptr) InterleaveInt32x2Slots<hostSampleType, calibrated, swapEndianness, true, true>(slot0, slot1, destination, slotTransforms, frameCount, cpuFeatures);
+			else if (slot0 != nullptr) InterleaveInt32x2Slots<hostSampleType, calibrated, swapEndianness, true, false>(slot0, slot1, destination, slotTransforms, frameCount, cpuFeatures);
+			else if (slot1 != nullptr) InterleaveInt32x2Slots<hostSampleType, calibrated, swapEndianness, false, true>(slot0, slot1, destination, slotTransforms, frameCount, cpuFeatures);
+			// Silence looks the same regardless of endianness and polarity. Calibration is not applied to slots that have no source.
+			else memset(destination, 0, frameCount * 2 * deviceSampleSizeInBytes);
+		}
+
+		template <HostSampleType hostSampleType, bool calibrated, bool swapEndianness>
+		void DeinterleaveInt32x2(const std::byte* const source, const std::array<std::byte*, 2>& destinations, const std::array<SlotTransform, 2>& slotTransforms, const size_t frameCount, const CpuFeatures& cpuFeatures) {
+			const auto slot0 = destinations[0];
+			const auto slot1 = destinations[1];
+			if (slot0 != nullptr && slot1 != nullptr) DeinterleaveInt32x2Slots<hostSampleType, calibrated, swapEndianness, true, true>(source, slot0, slot1, slotTransforms, frameCount, cpuFeatures);
+			else if (slot0 != nullptr) DeinterleaveInt32x2Slots<hostSampleType, calibrated, swapEndianness, true, false>(source, slot0, slot1, slotTransforms, frameCount, cpuFeatures);
+			else if (slot1 != nullptr) DeinterleaveInt32x2Slots<hostSampleType, calibrated, swapEndianness, false, true>(source, slot0, slot1, slotTransforms, frameCount, cpuFeatures);
+		}
+
+		template <HostSampleType hostSampleType, bool calibrated, bool swapEndianness, size_t channelCount>
+		void InterleaveInt32Generic(const std::array<const std::byte*, channelCount>& sources, std::byte* const destination, const std::array<SlotTransform, channelCount>& slotTransforms, const size_t frameCount) {
+			for (size_t frame = 0; frame < frameCount; ++frame)
+				for (size_t slot = 0; slot < channelCount; ++slot)
+					StoreSample(destination + (frame * channelCount + slot) * deviceSampleSizeInBytes, sources[slot] == nullptr ? 0 : MaybeSwapEndianness<swapEndianness>(LoadHostSample<hostSampleType, calibrated>(sources[slot] + frame * hostSampleSizeInBytes<hostSampleType>, slotTransforms[slot])));
+		}
+
+		template <HostSampleType hostSampleType, bool calibrated, bool swapEndianness, size_t channelCount>
+		void DeinterleaveInt32Generic(const std::byte* const source, const std::array<std::byte*, channelCount>& destinations, const std::array<SlotTransform, channelCount>& slotTransforms, const size_t frameCount) {
+			for (size_t frame = 0; frame < frameCount; ++frame)
+				for (size_t slot = 0; slot < channelCount; ++slot)
+					if (destinations[slot] != nullptr) StoreHostSample<hostSampleType, calibrated>(destinations[slot] + frame * hostSampleSizeInBytes<hostSampleType>, MaybeSwapEndianness<swapEndianness>(LoadSample(source + (frame * channelCount + slot) * deviceSampleSizeInBytes)), slotTransforms[slot]);
+		}
+
+		template <size_t channelCount>
+		bool IsCalibrated(const SampleTransform<channelCount>& transform) {
+			return std::any_of(transform.calibration.begin(), transform.calibration.end(), [](const SampleCalibration& calibration) { return calibration != SampleCalibration(); });
+		}
+
+		template <HostSampleType hostSampleType, bool calibrated, size_t channelCount>
+		void InterleaveSlotTransforms(const std::array<const std::byte*, channelCount>& sources, std::byte* const destination, const size_t frameCount, const bool swapEndianness, const std::array<SlotTransform, channelCount>& slotTransforms, const CpuFeatures& cpuFeatures) {
+			if constexpr (channelCount == 2) {
+				if (swapEndianness) InterleaveInt32x2<hostSampleType, calibrated, true>(sources, destination, slotTransforms, frameCount, cpuFeatures);
+				else InterleaveInt32x2<hostSampleType, calibrated, false>(sources, destination, slotTransforms, frameCount, cpuFeatures);
+			}
+			else {
+				if (swapEndianness) InterleaveInt32Generic<hostSampleType, calibrated, true>(sources, destination, slotTransforms, frameCount);
+				else InterleaveInt32Generic<hostSampleType, calibrated, false>(sources, destination, slotTransforms, frameCount);
+			}
+		}
+
+		template <HostSampleType hostSampleType, bool calibrated, size_t channelCount>
+		void DeinterleaveSlotTransforms(const std::byte* const source, const std::array<std::byte*, channelCount>& destinations, const size_t frameCount, const bool swapEndianness, const std::array<SlotTransform, channelCount>& slotTransforms, const CpuFeatures& cpuFeatures) {
+			if constexpr (channelCount == 2) {
+				if (swapEndianness) DeinterleaveInt32x2<hostSampleType, calibrated, true>(source, destinations, slotTransforms, frameCount, cpuFeatures);
+				else DeinterleaveInt32x2<hostSampleType, calibrated, false>(source, destinations, slotTransforms, frameCount, cpuFeatures);
+			}
+			else {
+				if (swapEndianness) DeinterleaveInt32Generic<hostSampleType, calibrated, true>(source, destinations, slotTransforms, frameCount);
+				else DeinterleaveInt32Generic<hostSampleType, calibrated, false>(source, destinations, slotTransforms, frameCount);
+			}
+		}
+
+		template <HostSampleType hostSampleType, size_t channelCount>
+		void InterleaveHostSampleType(const std::array<const std::byte*, channelCount>& sources, std::byte* const destination, const size_t frameCount, const SampleTransform<channelCount>& transform, const CpuFeatures& cpuFeatures) {
+			std::array<SlotTransform, channelCount> slotTransforms;
+			for (size_t slot = 0; slot < channelCount; ++slot) slotTransforms[slot] = GetToDeviceSlotTransform<hostSampleType>(transform.invertPolarity[slot], transform.calibration[slot]);
+			// Uncalibrated integer samples stay on a purely integer path, which is cheaper.
+			if constexpr (isFloatHostSampleType<hostSampleType>) InterleaveSlotTransforms<hostSampleType, false>(sources, destination, frameCount, transform.swapEndianness, slotTransforms, cpuFeatures);
+			else if (IsCalibrated(transform)) InterleaveSlotTransforms<hostSampleType, true>(sources, destination, frameCount, transform.swapEndianness, slotTransforms, cpuFeatures);
+			else InterleaveSlotTransforms<hostSampleType, false>(sources, destination, frameCount, transform.swapEndianness, slotTransforms, cpuFeatures);
+		}
+
+		template <HostSampleType hostSampleType, size_t channelCount>
+		void DeinterleaveHostSampleType(const std::byte* const source, const std::array<std::byte*, channelCount>& destinations, const size_t frameCount, const SampleTransform<channelCount>& transform, const CpuFeatures& cpuFeatures) {
+			std::array<SlotTransform, channelCount> slotTransforms;
+			for (size_t slot = 0; slot < channelCount; ++slot) slotTransforms[slot] = GetFromDeviceSlotTransform<hostSampleType>(transform.invertPolarity[slot], transform.calibration[slot]);
+			if constexpr (isFloatHostSampleType<hostSampleType>) DeinterleaveSlotTransforms<hostSampleType, false>(source, destinations, frameCount, transform.swapEndianness, slotTransforms, cpuFeatures);
+			else if (IsCalibrated(transform)) DeinterleaveSlotTransforms<hostSampleType, true>(source, destinations, frameCount, transform.swapEndianness, slotTransforms, cpuFeatures);
+			else DeinterleaveSlotTransforms<hostSampleType, false>(source, destinations, frameCount, transform.swapEndianness, slotTransforms, cpuFeatures);
+		}
+
+		template <bool swapEndianness, size_t channelCount>
+		void FilterInt32Scalar(const std::byte* const source, std::byte* const destination, const size_t frameCount, SlotFilter<channelCount>& filter) {
+			const auto& biquad = filter.biquad;
+			for (size_t frame = 0; frame < frameCount; ++frame)
+				for (size_t slot = 0; slot < channelCount; ++slot) {
+					const auto offset = (frame * channelCount + slot) * deviceSampleSizeInBytes;
+					const auto x = double(MaybeSwapEndianness<swapEndianness>(LoadSample(source + offset)));
+					const auto y = biquad.b0 * x + filter.z1[slot];
+					filter.z1[slot] = (biquad.b1 * x + filter.z2[slot]) - biquad.a1 * y;
+					filter.z2[slot] = biquad.b2 * x - biquad.a2 * y;
+					StoreSample(destination + offset, ClipToInt32<double>(y));
+				}
+		}
+
+#ifdef ASIO401_CONVERSION_X86
+		// An IIR filter cannot be vectorized across time, but the two slots can be processed in parallel. The operations are the same as in the scalar
+		// kernel, in the same order, so the results are identical. Speed is bound by the latency of the feedback path (y -> z1 -> y), which is why the
+		// terms that do not depend on y are summed first.
+		template <bool swapEndianness>
+		void FilterInt32x2Sse(const std::byte* const source, std::byte* const destination, const size_t frameCount, SlotFilter<2>& filter) {
+			const auto b0 = _mm_set1_pd(filter.biquad.b0);
+			const auto b1 = _mm_set1_pd(filter.biquad.b1);
+			const auto b2 = _mm_set1_pd(filter.biquad.b2);
+			const auto a1 = _mm_set1_pd(filter.biquad.a1);
+			const auto a2 = _mm_set1_pd(filter.biquad.a2);
+			__m128d z1 = _mm_loadu_pd(filter.z1.data());
+			__m128d z2 = _mm_loadu_pd(filter.z2.data());
+			for (size_t frame = 0; frame < frameCount; ++frame) {
+				const auto x = _mm_cvtepi32_pd(MaybeSwapEndiannessSse<Sse::SSE2, swapEndianness>(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(source + frame * 2 * deviceSampleSizeInBytes))));
+				const auto y = _mm_add_pd(_mm_mul_pd(b0, x), z1);
+				z1 = _mm_sub_pd(_mm_add_pd(_mm_mul_pd(b1, x), z2), _mm_mul_pd(a1, y));
+				z2 = _mm_sub_pd(_mm_mul_pd(b2, x), _mm_mul_pd(a2, y));
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(destination + frame * 2 * deviceSampleSizeInBytes), ClipToInt32Sse(y));
+			}
+			_mm_storeu_pd(filter.z1.data(), z1);
+			_mm_storeu_pd(filter.z2.data(), z2);
+		}
+#endif
+
+		// Filters device samples into native endianness samples.
+		template <bool swapEndianness, size_t channelCount>
+		void FilterInt32(const std::byte* const source, std::byte* const destination, const size_t frameCount, SlotFilter<channelCount>& filter) {
+#ifdef ASIO401_CONVERSION_X86
+			if constexpr (channelCount == 2) FilterInt32x2Sse<swapEndianness>(source, destination, frameCount, filter);
+			else
+#endif
+			FilterInt32Scalar<swapEndianness>(source, destination, frameCount, filter);
+		}
+
+		// If the input stays perfectly silent for a long time, the filter state decays into the denormal range, where arithmetic is very slow on x86 CPUs.
+		// Values this small have no effect on the output anyway.
+		template <size_t channelCount>
+		void FlushFilterState(SlotFilter<channelCount>& filter) {
+			for (auto* const state : { &filter.z1, &filter.z2 })
+				for (auto& value : *state)
+					if (std::abs(value) < 1e-20) value = 0;
+		}
+
+	}
+
+	Biquad GetFirstOrderHighPass(const double cutoffFrequency, const double sampleRate) {
+		const auto k = std::tan(std::numbers::pi * cutoffFrequency / sampleRate);
+		const auto b0 = 1 / (1 + k);
+		return { .b0 = b0, .b1 = -b0, .a1 = (k - 1) / (k + 1) };
+	}
+
+	Biquad GetSecondOrderHighPass(const double cutoffFrequency, const double sampleRate) {
+		const auto k = std::tan(std::numbers::pi * cutoffFrequency / sampleRate);
+		const auto norm = 1 / (1 + std::numbers::sqrt2 * k + k * k);
+		return { .b0 = norm, .b1 = -2 * norm, .b2 = norm, .a1 = 2 * (k * k - 1) * norm, .a2 = (1 - std::numbers::sqrt2 * k + k * k) * norm };
+	}
+
+	template <size_t channelCount>
+	void Interleave(const std::array<const std::byte*, channelCount>& sources, std::byte* const destination, const size_t frameCount, const SampleTransform<channelCount>& transform, const CpuFeatures& cpuFeatures) {
+		switch (transform.hostSampleType) {
+		case HostSampleType::INT32: InterleaveHostSampleType<HostSampleType::INT32>(sources, destination, frameCount, transform, cpuFeatures); break;
+		case HostSampleType::INT24: InterleaveHostSampleType<HostSampleType::INT24>(sources, destination, frameCount, transform, cpuFeatures); break;
+		case HostSampleType::FLOAT32: InterleaveHostSampleType<HostSampleType::FLOAT32>(sources, destination, frameCount, transform, cpuFeatures); break;
+		case HostSampleType::FLOAT64: InterleaveHostSampleType<HostSampleType::FLOAT64>(sources, destination, frameCount, transform, cpuFeatures); break;
+		}
+	}
+
+	template <size_t channelCount>
+	void Deinterleave(const std::byte* const source, const std::array<std::byte*, channelCount>& destinations, const size_t frameCount, const SampleTransform<channelCount>& transform, const CpuFeatures& cpuFeatures) {
+		switch (transform.hostSampleType) {
+		case HostSampleType::INT32: DeinterleaveHostSampleType<HostSampleType::INT32>(source, destinations, frameCount, transform, cpuFeatures); break;
+		case HostSampleType::INT24: DeinterleaveHostSampleType<HostSampleType::INT24>(source, destinations, frameCount, transform, cpuFeatures); break;
+		case HostSampleType::FLOAT32: DeinterleaveHostSampleType<HostSampleType::FLOAT32>(source, destinations, frameCount, transform, cpuFeatures); break;
+		case HostSampleType::FLOAT64: DeinterleaveHostSampleType<HostSampleType::FLOAT64>(source, destinations, frameCount, transform, cpuFeatures); break;
+		}
+	}
+
+	template <size_t channelCount>
+	void FilterAndDeinterleave(const std::byte* const source, const std::array<std::byte*, channelCount>& destinations, const size_t frameCount, const SampleTransform<channelCount>& transform, SlotFilter<channelCount>& filter, const CpuFeatures& cpuFeatures) {
+		constexpr size_t blockSizeInFrames = 256;
+		alignas(32) std::array<std::byte, blockSizeInFrames * channelCount * deviceSampleSizeInBytes> block;
+		auto blockTransform = transform;
+		blockTransform.swapEndianness = false;
+		// The filter removes DC, so a calibration offset would just reintroduce some after the fact.
+		for (auto& calibration : blockTransform.calibration) calibration.offset = 0;
+		for (size_t frame = 0; frame < frameCount; frame += blockSizeInFrames) {
+			const auto blockFrameCount = (std::min)(blockSizeInFrames, frameCount - frame);
+			const auto blockSource = source + frame * channelCount * deviceSampleSizeInBytes;
+			if (transform.swapEndianness) FilterInt32<true>(blockSource, block.data(), blockFrameCount, filter);
+			else FilterInt32<false>(blockSource, block.data(), blockFrameCount, filter);
+			FlushFilterState(filter);
+			std::array<std::byte*, channelCount> blockDestinations;
+			for (size_t slot = 0; slot < channelCount; ++slot) blockDestinations[slot] = destinations[slot] == nullptr ? nullptr : destinations[slot] + frame * GetHostSampleSizeInBytes(transform.hostSampleType);
+			Deinterleave(block.data(), blockDestinations, blockFrameCount, blockTransform, cpuFeatures);
+		}
+	}
+
+	template void Interleave<2>(const std::array<const std::byte*, 2>&, std::byte*, size_t, const SampleTransform<2>&, const CpuFeatures&);
+	template void Deinterleave<2>(const std::byte*, const std::array<std::byte*, 2>&, size_t, const SampleTransform<2>&, const CpuFeatures&);
+	template void FilterAndDeinterleave<2>(const std::byte*, const std::array<std::byte*, 2>&, size_t, const SampleTransform<2>&, SlotFilter<2>&, const CpuFeatures&);
+
+}
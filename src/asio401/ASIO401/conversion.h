@@ -0,0 +1,94 @@
+#pragma once
+
+#include "../ASIO401Util/cpu.h"
+
+#include <array>
+#include <cstddef>
+
+namespace asio401 {
+
+	// The sample format of the ASIO buffers, i.e. what the host sees. Device buffers always use 32-bit integer samples.
+	// 24-bit integer samples are packed (3 bytes per sample). They map to the upper 24 bits of device samples; the lower 8 bits are truncated on their way to the host.
+	// Floating point samples use a full scale of 1.0, i.e. 1.0 corresponds to 2^31 in the device buffer. They are clipped on their way to the device.
+	enum class HostSampleType { INT32, INT24, FLOAT32, FLOAT64 };
+
+	constexpr size_t GetHostSampleSizeInBytes(HostSampleType hostSampleType) {
+		switch (hostSampleType) {
+		case HostSampleType::INT32: return 4;
+		case HostSampleType::INT24: return 3;
+		case HostSampleType::FLOAT32: return 4;
+		case HostSampleType::FLOAT64: return 8;
+		}
+		return 0;
+	}
+
+	// A linear correction applied to the samples of a channel in either direction: samples are multiplied by `gain`, then `offset` (relative to full scale)
+	// is added. Integer results saturate.
+	struct SampleCalibration {
+		double gain = 1;
+		double offset = 0;
+
+		bool operator==(const SampleCalibration&) const = default;
+	};
+
+	// Describes how samples are transformed on their way between the ASIO buffers, which are always in native endianness, and the device buffer.
+	template <size_t channelCount>
+	struct SampleTransform {
+		// Whether samples in the device buffer use the opposite endianness from the ASIO buffers.
+		bool swapEndianness = false;
+		// Indexed by interleaved channel slot. Polarity inversion always operates on native endianness samples. On integer samples, it saturates (the most negative value becomes the most positive value).
+		std::array<bool, channelCount> invertPolarity = {};
+		// The sample format of the ASIO buffers.
+		HostSampleType hostSampleType = HostSampleType::INT32;
+		// Indexed by interleaved channel slot. On the way to the host, calibration is applied after polarity inversion; on the way to the device, before.
+		std::array<SampleCalibration, channelCount> calibration = {};
+	};
+
+	// Interleaves `frameCount` frames of samples from separate channel buffers into `destination`, applying `transform` along the way.
+	// `sources[slot]` points to the samples for the given interleaved channel slot, or is null if that slot should be filled with silence.
+	// Conversion from the host sample type to 32-bit integers, as well as calibration, happens in the same pass.
+	// The source buffers are not modified.
+	// `cpuFeatures` determines which kernel is used. It only makes sense to override it for testing and benchmarking purposes.
+	template <size_t channelCount>
+	void Interleave(const std::array<const std::byte*, channelCount>& sources, std::byte* destination, size_t frameCount, const SampleTransform<channelCount>& transform = {}, const CpuFeatures& cpuFeatures = GetCpuFeatures());
+
+	// The reverse of Interleave(). Slots for which `destinations[slot]` is null are skipped.
+	template <size_t channelCount>
+	void Deinterleave(const std::byte* source, const std::array<std::byte*, channelCount>& destinations, size_t frameCount, const SampleTransform<channelCount>& transform = {}, const CpuFeatures& cpuFeatures = GetCpuFeatures());
+
+	// Coefficients of a second-order IIR filter (biquad), normalized so that a0 = 1. First-order filters have b2 = a2 = 0.
+	struct Biquad {
+		double b0 = 1;
+		double b1 = 0;
+		double b2 = 0;
+		double a1 = 0;
+		double a2 = 0;
+	};
+
+	// High-pass filters designed through the bilinear transform, with a -3 dB point at `cutoffFrequency`. The second-order filter is a Butterworth filter.
+	Biquad GetFirstOrderHighPass(double cutoffFrequency, double sampleRate);
+	Biquad GetSecondOrderHighPass(double cutoffFrequency, double sampleRate);
+
+	// A filter that is applied independently to each interleaved channel slot. The state carries over from one call to the next, so that the filter
+	// runs continuously across buffers.
+	template <size_t channelCount>
+	struct SlotFilter {
+		Biquad biquad;
+		// Transposed direct form II state, in device sample units.
+		std::array<double, channelCount> z1 = {};
+		std::array<double, channelCount> z2 = {};
+	};
+
+	// Same as Deinterleave(), but runs `filter` on the device samples first. The filter sees native endianness samples, before polarity inversion,
+	// calibration and conversion to the host sample type; its output is rounded back to 32-bit integers, with saturation. Calibration offsets are
+	// ignored, as `filter` is expected to be a high-pass filter whose purpose is to remove DC.
+	// This is done in small blocks that stay in cache, so the data is still only read from and written to memory once.
+	template <size_t channelCount>
+	void FilterAndDeinterleave(const std::byte* source, const std::array<std::byte*, channelCount>& destinations, size_t frameCount, const SampleTransform<channelCount>& transform, SlotFilter<channelCount>& filter, const CpuFeatures& cpuFeatures = GetCpuFeatures());
+
+	// Both the QA401 and QA403 are stereo devices, so that's the only channel count we need to instantiate.
+	extern template void Interleave<2>(const std::array<const std::byte*, 2>&, std::byte*, size_t, const SampleTransform<2>&, const CpuFeatures&);
+	extern template void Deinterleave<2>(const std::byte*, const std::array<std::byte*, 2>&, size_t, const SampleTransform<2>&, const CpuFeatures&);
+	extern template void FilterAndDeinterleave<2>(const std::byte*, const std::array<std::byte*, 2>&, size_t, const SampleTransform<2>&, SlotFilter<2>&, const CpuFeatures&);
+
+}
@@ -5,12 +5,111 @@
 
 #include <dechamps_CMakeUtils/version.h>
 
+#include "../ASIO401Util/atomic_event.h"
+#include "../ASIO401Util/mpsc_queue.h"
 #include "../ASIO401Util/shell.h"
 
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
 namespace asio401 {
 
 	namespace {
 
+		// Writes to the backend sink from a background thread while started; synchronously otherwise. See BackgroundLogWriter.
+		class AsyncLogSink final : public ::dechamps_cpplog::LogSink {
+			public:
+				explicit AsyncLogSink(::dechamps_cpplog::LogSink& backend) : backend(backend) {}
+
+				~AsyncLogSink() {
+					if (writerThread.joinable()) Stop();
+				}
+
+				void Start() {
+					writerStopRequested.store(false, std::memory_order_relaxed);
+					writerThread = std::thread([&] { RunWriterThread(); });
+					enabled.store(true, std::memory_order_release);
+				}
+
+				void Stop() {
+					enabled.store(false, std::memory_order_seq_cst);
+					// Wait for writers that saw `enabled` before it was cleared to finish pushing their record. Writers that come after that write
+					// synchronously, so once this is done, nothing can be pushed into the queue anymore.
+					while (pushingWriterCount.load(std::memory_order_seq_cst) > 0) std::this_thread::yield();
+					writerStopRequested.store(true, std::memory_order_release);
+					std::atomic_thread_fence(std::memory_order_seq_cst);
+					recordsAvailable.Set();
+					writerThread.join();
+					std::scoped_lock lock(backendMutex);
+					// Catch any message that was pushed after the writer thread last looked at the queue.
+					DrainQueue();
+				}
+
+				void Write(const std::string_view str) override {
+					// Pairs with Stop(): either Stop() sees this writer, or this writer sees `enabled` cleared.
+					pushingWriterCount.fetch_add(1, std::memory_order_seq_cst);
+					if (!enabled.load(std::memory_order_seq_cst)) {
+						pushingWriterCount.fetch_sub(1, std::memory_order_release);
+						std::scoped_lock lock(backendMutex);
+						DrainQueue();
+						backend.Write(str);
+						return;
+					}
+
+					if (queue.TryPush([&](std::string& record) { record.assign(str); })) {
+						// Pairs with the fence in RunWriterThread(); ensures that either the writer thread sees the record, or we see the event reset (and set it).
+						std::atomic_thread_fence(std::memory_order_seq_cst);
+						recordsAvailable.Set();
+					}
+					else droppedRecordCount.fetch_add(1, std::memory_order_relaxed);
+					pushingWriterCount.fetch_sub(1, std::memory_order_release);
+				}
+
+			private:
+				static constexpr size_t queueCapacity = 4096;
+				static constexpr size_t initialRecordCapacity = 256;
+
+				void RunWriterThread() {
+					for (;;) {
+						recordsAvailable.Reset();
+						std::atomic_thread_fence(std::memory_order_seq_cst);
+						const auto stopRequested = writerStopRequested.load(std::memory_order_acquire);
+						{
+							std::scoped_lock lock(backendMutex);
+							DrainQueue();
+						}
+						if (stopRequested) return;
+						recordsAvailable.Wait();
+					}
+				}
+
+				// Must be called with backendMutex held, as the queue only supports one consumer at a time.
+				void DrainQueue() {
+					while (queue.TryPop([&](std::string& record) {
+						backend.Write(record);
+						record.clear();
+					}));
+					const auto droppedCount = droppedRecordCount.exchange(0, std::memory_order_relaxed);
+					if (droppedCount > 0) ::dechamps_cpplog::Logger(&droppedNoticeSink) << "!!! " << droppedCount << " log messages were dropped because the log queue was full";
+				}
+
+				::dechamps_cpplog::LogSink& backend;
+				::dechamps_cpplog::PreambleLogSink droppedNoticeSink{ backend };
+				std::mutex backendMutex;
+				// Most messages fit in the initial record capacity, so that pushing them into the queue does not allocate memory.
+				BoundedMpscQueue<std::string> queue{ queueCapacity, [](std::string& record) { record.reserve(initialRecordCapacity); } };
+				std::atomic<uint64_t> droppedRecordCount = 0;
+				std::atomic<bool> enabled = false;
+				// The number of Write() calls that are about to push a record into the queue, or might be.
+				std::atomic<size_t> pushingWriterCount = 0;
+				std::atomic<bool> writerStopRequested = false;
+				AtomicEvent recordsAvailable{ false };
+				std::thread writerThread;
+		};
+
 		class ASIO401LogSink final : public ::dechamps_cpplog::LogSink {
 			public:
 				static std::unique_ptr<ASIO401LogSink> Open() {
@@ -34,12 +133,25 @@ namespace asio401 {
 					::dechamps_cpplog::Logger(this) << "ASIO401 " << BUILD_CONFIGURATION << " " << BUILD_PLATFORM << " " << ::dechamps_CMakeUtils_gitDescriptionDirty << " built on " << ::dechamps_CMakeUtils_buildTime;
 				}
 
+				// The preamble (time, thread ID) is formatted on the calling thread, as it describes the calling thread.
 				void Write(const std::string_view str) override { return preamble_sink.Write(str); }
 
+				void AddBackgroundWriter() {
+					std::scoped_lock lock(backgroundWriterMutex);
+					if (backgroundWriterCount++ == 0) async_sink.Start();
+				}
+
+				void RemoveBackgroundWriter() {
+					std::scoped_lock lock(backgroundWriterMutex);
+					if (--backgroundWriterCount == 0) async_sink.Stop();
+				}
+
 			private:
 				::dechamps_cpplog::FileLogSink file_sink;
-				::dechamps_cpplog::ThreadSafeLogSink thread_safe_sink{ file_sink };
-				::dechamps_cpplog::PreambleLogSink preamble_sink{ thread_safe_sink };
+				AsyncLogSink async_sink{ file_sink };
+				::dechamps_cpplog::PreambleLogSink preamble_sink{ async_sink };
+				std::mutex backgroundWriterMutex;
+				size_t backgroundWriterCount = 0;
 		};
 
 	}
@@ -47,4 +159,14 @@ namespace asio401 {
 	bool IsLoggingEnabled() { return ASIO401LogSink::Get() != nullptr;  }
 	::dechamps_cpplog::Logger Log() { return ::dechamps_cpplog::Logger(ASIO401LogSink::Get()); }
 
-}
\ No newline at end of file
+	BackgroundLogWriter::BackgroundLogWriter() {
+		const auto sink = ASIO401LogSink::Get();
+		if (sink != nullptr) sink->AddBackgroundWriter();
+	}
+
+	BackgroundLogWriter::~BackgroundLogWriter() {
+		const auto sink = ASIO401LogSink::Get();
+		if (sink != nullptr) sink->RemoveBackgroundWriter();
+	}
+
+}
@@ -8,4 +8,18 @@ namespace asio401 {
 	bool IsLoggingEnabled();
 	::dechamps_cpplog::Logger Log();
 
+	// While at least one instance of this class exists, log messages are not written to the log file by the thread that logs them. Instead, they are
+	// queued in a bounded lock-free queue and written by a background thread, so that logging from a real-time thread does not wait for a lock or for
+	// file I/O. If the queue is full, messages are dropped, and the number of dropped messages is logged later.
+	//
+	// The background thread cannot be stopped while the DLL is being unloaded (because of the loader lock), which is why its lifetime is tied to
+	// instances of this class instead of the logging system itself. When no instance exists, messages are written synchronously.
+	class BackgroundLogWriter final {
+	public:
+		BackgroundLogWriter();
+		~BackgroundLogWriter();
+		BackgroundLogWriter(const BackgroundLogWriter&) = delete;
+		BackgroundLogWriter& operator=(const BackgroundLogWriter&) = delete;
+	};
+
 }
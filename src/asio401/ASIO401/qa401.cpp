@@ -2,11 +2,16 @@
 
 #include "log.h"
 
+#include "../ASIO401Util/clock.h"
+
 namespace asio401 {
 
 	QA401::QA401(std::string_view devicePath) :
 		qa40x(devicePath, /*registerPipeId*/0x02, /*writePipeId*/0x04, /*readPipeId*/0x88, /*requiresApp*/true) {}
 
+	QA401::QA401(QA40xEmulator::Options emulatorOptions) :
+		qa40x(QA40xEmulator::Model::QA401, emulatorOptions) {}
+
 	QA401::~QA401() {
 		AbortPing();
 	}
@@ -16,26 +21,40 @@ namespace asio401 {
 
 		AbortPing();
 
+		const auto startTime = std::chrono::steady_clock::now();
 		// Black magic incantations provided by QuantAsylum.
-		WriteRegister(4, 1);
-		WriteRegister(4, 0);
-		WriteRegister(4, 3);
-		WriteRegister(4, 1);
-		WriteRegister(4, 3);
-		WriteRegister(4, 0);
-		// Note: according to QuantAsylum these parameters can be changed at any time, except the sample rate, which can only be changed on reset.
-		WriteRegister(5,
-			(inputHighPassFilterState == InputHighPassFilterState::ENGAGED ? 0x01 : 0) |
-			(attenuatorState == AttenuatorState::DISENGAGED ? 0x02 : 0) |
-			(sampleRate == SampleRate::KHZ48 ? 0x04 : 0)
-		);
-		WriteRegister(6, 4);
-		::Sleep(10);
-		WriteRegister(6, 6);
-		WriteRegister(6, 0);
-		WriteRegister(4, 5);
-
-		Log() << "QA401 is reset";
+		// The writes are batched to avoid waiting for a USB round trip between each one, except where the hardware needs a delay.
+		WriteRegisters({
+			{ 4, 1 },
+			{ 4, 0 },
+			{ 4, 3 },
+			{ 4, 1 },
+			{ 4, 3 },
+			{ 4, 0 },
+			// Note: according to QuantAsylum these parameters can be changed at any time, except the sample rate, which can only be changed on reset.
+			{ 5,
+				(inputHighPassFilterState == InputHighPassFilterState::ENGAGED ? 0x01u : 0) |
+				(attenuatorState == AttenuatorState::DISENGAGED ? 0x02u : 0) |
+				(sampleRate == SampleRate::KHZ48 ? 0x04u : 0) },
+			{ 6, 4 },
+		});
+		// There is no way to tell when the hardware is ready for the rest of the sequence, so we have to wait for a fixed amount of time.
+		// Measure the delay from the completion of the last write though, as opposed to just calling Sleep() which can overshoot by a timer tick.
+		const auto settleStartTime = std::chrono::steady_clock::now();
+		SleepUntil(settleStartTime + std::chrono::milliseconds(10));
+		const auto settleEndTime = std::chrono::steady_clock::now();
+		WriteRegisters({
+			{ 6, 6 },
+			{ 6, 0 },
+			{ 4, 5 },
+		});
+		const auto endTime = std::chrono::steady_clock::now();
+
+		resetDurationStats.Record(endTime - startTime);
+		Log() << "QA401 is reset; took " << DurationStats::DescribeDuration(endTime - startTime)
+			<< " (register writes: " << DurationStats::DescribeDuration((settleStartTime - startTime) + (endTime - settleEndTime))
+			<< ", settling: " << DurationStats::DescribeDuration(settleEndTime - settleStartTime)
+			<< "); reset durations so far: " << resetDurationStats.Describe();
 	}
 
 	void QA401::Ping() {
@@ -2,8 +2,11 @@
 
 #include "qa40x.h"
 
+#include "../ASIO401Util/duration_stats.h"
+
 #include <dechamps_cpputil/endian.h>
 
+#include <initializer_list>
 #include <string_view>
 
 namespace asio401 {
@@ -22,6 +25,7 @@ namespace asio401 {
 		static constexpr auto writeGranularityInFrames = 32u;  // Measured empirically
 		
 		QA401(std::string_view devicePath);
+		explicit QA401(QA40xEmulator::Options);
 		~QA401();
 
 		// Note that there is no Start() call. Technically we could implement one by writing 5 into register 4 but that has rather nasty side effects. See https://github.com/dechamps/ASIO401/issues/9
@@ -36,11 +40,13 @@ namespace asio401 {
 	private:
 		void AbortPing();
 
-		void WriteRegister(uint8_t registerNumber, uint32_t value) { registerIOSlot.Execute(QA40x::RegisterChannel(qa40x), registerNumber, value); }
+		void WriteRegisters(std::initializer_list<QA40xRegisterBatch::Write> writes) { registerBatch.Execute(QA40x::RegisterChannel(qa40x), writes); }
 
 		QA40x qa40x;
 		RegisterQA40xIOSlot registerIOSlot;
+		QA40xRegisterBatch registerBatch;
 		bool pinging = false;
+		DurationStats resetDurationStats;
 	};
 
 }
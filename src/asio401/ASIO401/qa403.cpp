@@ -2,30 +2,56 @@
 
 #include "log.h"
 
+#include "../ASIO401Util/clock.h"
+
 namespace asio401 {
 
 	QA403::QA403(std::string_view devicePath) :
 		qa40x(devicePath, /*registerPipeId*/0x01, /*writePipeId*/0x02, /*readPipeId*/0x82, /*requiresApp*/false) {}
 
+	QA403::QA403(QA40xEmulator::Options emulatorOptions) :
+		qa40x(QA40xEmulator::Model::QA403, emulatorOptions) {}
+
 	void QA403::Reset(FullScaleInputLevel fullScaleInputLevel, FullScaleOutputLevel fullScaleOutputLevel, SampleRate sampleRate) {
 		Log() << "Resetting QA403";
 
-		// Reset the hardware. This is especially important in case of a previous unclean stop,
-		// where the hardware could be left in an inconsistent state.
-		WriteRegister(8, 0);
-		WriteRegister(5, uint32_t(fullScaleInputLevel));
-		WriteRegister(6, uint32_t(fullScaleOutputLevel));
-		// QuantAsylum did not publicly document sample rate setting, this is from private correspondence with them.
-		WriteRegister(9, uint32_t(sampleRate));
-		// Wait for a bit before setting the register again, otherwise it looks like the hardware
-		// "skips past" the zero state (some kind of ABA problem?)
-		::Sleep(50);
-
-		Log() << "QA403 is reset";
+		const auto startTime = std::chrono::steady_clock::now();
+		// The writes are batched to avoid waiting for a USB round trip between each one.
+		WriteRegisters({
+			// Reset the hardware. This is especially important in case of a previous unclean stop,
+			// where the hardware could be left in an inconsistent state.
+			{ 8, 0 },
+			{ 5, uint32_t(fullScaleInputLevel) },
+			{ 6, uint32_t(fullScaleOutputLevel) },
+			// QuantAsylum did not publicly document sample rate setting, this is from private correspondence with them.
+			{ 9, uint32_t(sampleRate) },
+		});
+		// See Start().
+		stopTime = std::chrono::steady_clock::now();
+
+		resetDurationStats.Record(*stopTime - startTime);
+		Log() << "QA403 is reset; took " << DurationStats::DescribeDuration(*stopTime - startTime) << "; reset durations so far: " << resetDurationStats.Describe();
 	}
 
 	void QA403::Start() {
+		// Wait for a bit after stopping before setting the register again, otherwise it looks like the hardware
+		// "skips past" the zero state (some kind of ABA problem?)
+		// There is no way to tell when the hardware is ready, so this is a fixed delay. Note we only wait for whatever is left of that delay, which is
+		// nothing if the device was stopped a while ago.
+		constexpr auto stopToStartDelay = std::chrono::milliseconds(50);
+		if (stopTime.has_value()) {
+			const auto settleStartTime = std::chrono::steady_clock::now();
+			SleepUntil(*stopTime + stopToStartDelay);
+			const auto settleDuration = std::chrono::steady_clock::now() - settleStartTime;
+			startSettleDurationStats.Record(settleDuration);
+			Log() << "Waited " << DurationStats::DescribeDuration(settleDuration) << " for the QA403 to settle before starting; settle durations so far: " << startSettleDurationStats.Describe();
+		}
 		WriteRegister(8, 5);
 	}
 
+	void QA403::Stop() {
+		WriteRegister(8, 0);
+		stopTime = std::chrono::steady_clock::now();
+	}
+
 }
\ No newline at end of file
@@ -2,8 +2,13 @@
 
 #include "qa40x.h"
 
+#include "../ASIO401Util/duration_stats.h"
+
 #include <dechamps_cpputil/endian.h>
 
+#include <chrono>
+#include <initializer_list>
+#include <optional>
 #include <string_view>
 
 namespace asio401 {
@@ -44,18 +49,27 @@ namespace asio401 {
 		static constexpr auto writeGranularityInFrames = 64u;  // Measured empirically
 		
 		QA403(std::string_view devicePath);
+		explicit QA403(QA40xEmulator::Options);
 
 		void Reset(FullScaleInputLevel fullScaleInputLevel, FullScaleOutputLevel fullScaleOutputLevel, SampleRate sampleRate);
 		void Start();
+		// Stops streaming, but leaves the device configured. Start() can be called again without a Reset() in between.
+		void Stop();
 
 		QA40x::WriteChannel GetWriteChannel() { return QA40x::WriteChannel(qa40x); }
 		QA40x::ReadChannel GetReadChannel() { return QA40x::ReadChannel(qa40x); };
 
 	private:
 		void WriteRegister(uint8_t registerNumber, uint32_t value) { registerIOSlot.Execute(QA40x::RegisterChannel(qa40x), registerNumber, value); }
+		void WriteRegisters(std::initializer_list<QA40xRegisterBatch::Write> writes) { registerBatch.Execute(QA40x::RegisterChannel(qa40x), writes); }
 
 		QA40x qa40x;
 		RegisterQA40xIOSlot registerIOSlot;
+		QA40xRegisterBatch registerBatch;
+		// The last time streaming was stopped, i.e. register 8 was set to zero. See Start().
+		std::optional<std::chrono::steady_clock::time_point> stopTime;
+		DurationStats resetDurationStats;
+		DurationStats startSettleDurationStats;
 	};
 
 }
@@ -10,6 +10,8 @@
 #include <winusb.h>
 
 #include <cassert>
+#include <cstdlib>
+#include <exception>
 #include <set>
 #include <string_view>
 
@@ -26,15 +28,29 @@ namespace asio401 {
 			}
 		}();
 
+		template <QA40x::ChannelType channelType>
+		constexpr QA40xEmulator::Pipe emulatorPipe = [] {
+			switch (channelType) {
+			case QA40x::ChannelType::REGISTER: return QA40xEmulator::Pipe::REGISTER;
+			case QA40x::ChannelType::WRITE: return QA40xEmulator::Pipe::WRITE;
+			case QA40x::ChannelType::READ: return QA40xEmulator::Pipe::READ;
+			}
+		}();
+
 	}
 
 	QA40x::QA40x(std::string_view devicePath, UCHAR registerPipeId, UCHAR writePipeId, UCHAR readPipeId, const bool requiresApp) :
-		registerPipeId(registerPipeId), writePipeId(writePipeId), readPipeId(readPipeId),
-		winUsb(WinUsbOpen(devicePath)) {
-		Validate(requiresApp);
+		transport(std::in_place_type<WinUsbDevice>, WinUsbDevice{
+			.winUsb = WinUsbOpen(devicePath),
+			.registerPipeId = registerPipeId, .writePipeId = writePipeId, .readPipeId = readPipeId }) {
+		Validate(std::get<WinUsbDevice>(transport), requiresApp);
 	}
 
-	void QA40x::Validate(const bool requiresApp) {
+	QA40x::QA40x(QA40xEmulator::Model model, QA40xEmulator::Options options) :
+		transport(std::in_place_type<QA40xEmulator>, model, options) {}
+
+	void QA40x::Validate(WinUsbDevice& winUsbDevice, const bool requiresApp) {
+		auto& winUsb = winUsbDevice.winUsb;
 		Log() << "Querying QA40x USB interface descriptor";
 		USB_INTERFACE_DESCRIPTOR usbInterfaceDescriptor = { 0 };
 		if (WinUsb_QueryInterfaceSettings(winUsb.InterfaceHandle(), 0, &usbInterfaceDescriptor) != TRUE) {
@@ -49,7 +65,7 @@ namespace asio401 {
 				"No USB endpoints");
 		}
 
-		std::set<UCHAR> missingPipeIds = { registerPipeId, writePipeId, readPipeId };
+		std::set<UCHAR> missingPipeIds = { winUsbDevice.registerPipeId, winUsbDevice.writePipeId, winUsbDevice.readPipeId };
 		for (UCHAR endpointIndex = 0; endpointIndex < usbInterfaceDescriptor.bNumEndpoints; ++endpointIndex) {
 			Log() << "Querying pipe #" << int(endpointIndex);
 			WINUSB_PIPE_INFORMATION pipeInformation = { 0 };
@@ -58,6 +74,7 @@ namespace asio401 {
 			}
 			Log() << "Pipe (" << GetUsbPipeIdString(pipeInformation.PipeId) << ") information: " << DescribeWinUsbPipeInformation(pipeInformation);
 			missingPipeIds.erase(pipeInformation.PipeId);
+			winUsbDevice.maximumPacketSizes[pipeInformation.PipeId] = pipeInformation.MaximumPacketSize;
 		}
 		if (!missingPipeIds.empty()) {
 			throw std::runtime_error("Could not find WinUSB pipes: " + ::dechamps_cpputil::Join(missingPipeIds, ", ", GetUsbPipeIdString));
@@ -68,26 +85,45 @@ namespace asio401 {
 
 	template <QA40x::ChannelType channelType>
 	QA40x::Channel<channelType>::Channel(QA40x& qa40x) :
-		winUsbInterfaceHandle(qa40x.winUsb.InterfaceHandle()),
-		pipeId([&] {
-			if constexpr (channelType == ChannelType::REGISTER) {
-				return qa40x.registerPipeId;
-			}
-			else if constexpr (channelType == ChannelType::WRITE) {
-				return qa40x.writePipeId;
-			}
-			else if constexpr (channelType == ChannelType::READ) {
-				return qa40x.readPipeId;
-			}
-		}()) {}
+		pipe(OnVariant(qa40x.transport,
+			[&](WinUsbDevice& winUsbDevice) -> decltype(pipe) {
+				const auto pipeId = [&] {
+					if constexpr (channelType == ChannelType::REGISTER) {
+						return winUsbDevice.registerPipeId;
+					}
+					else if constexpr (channelType == ChannelType::WRITE) {
+						return winUsbDevice.writePipeId;
+					}
+					else if constexpr (channelType == ChannelType::READ) {
+						return winUsbDevice.readPipeId;
+					}
+				}();
+				return WinUsbPipe{
+					.interfaceHandle = winUsbDevice.winUsb.InterfaceHandle(),
+					.pipeId = pipeId,
+					.maximumPacketSize = winUsbDevice.maximumPacketSizes.at(pipeId),
+				};
+			},
+			[&](QA40xEmulator& emulator) -> decltype(pipe) { return &emulator; })) {}
 
 	template <QA40x::ChannelType channelType>
 	void QA40x::Channel<channelType>::Abort() {
 		if (IsLoggingEnabled()) Log() << "Aborting all QA40x " << channelName<channelType> << " pending operations";
-		// According to some sources, it would be a good idea to also call WinUsb_ResetPipe() here, as otherwise WinUsb_AbortPipe() may hang, e.g.:
-		//   https://android.googlesource.com/platform/development/+/487b1deae9082ff68833adf9eb47d57557f8bf16/host/windows/usb/winusb/adb_winusb_endpoint_object.cpp#66
-		// However in practice, if we implement this suggestion, and the process is abruptly terminated, then the next instance will hang on the first read from the read pipe! No idea why...
-		WinUsbAbort(winUsbInterfaceHandle, pipeId);
+		OnVariant(pipe,
+			[&](const WinUsbPipe& winUsbPipe) {
+				// According to some sources, it would be a good idea to also call WinUsb_ResetPipe() here, as otherwise WinUsb_AbortPipe() may hang, e.g.:
+				//   https://android.googlesource.com/platform/development/+/487b1deae9082ff68833adf9eb47d57557f8bf16/host/windows/usb/winusb/adb_winusb_endpoint_object.cpp#66
+				// However in practice, if we implement this suggestion, and the process is abruptly terminated, then the next instance will hang on the first read from the read pipe! No idea why...
+				WinUsbAbort(winUsbPipe.interfaceHandle, winUsbPipe.pipeId);
+			},
+			[&](QA40xEmulator* emulator) { emulator->Abort(emulatorPipe<channelType>); });
+	}
+
+	template <QA40x::ChannelType channelType>
+	size_t QA40x::Channel<channelType>::GetMaximumPacketSizeInBytes() const {
+		return OnVariant(pipe,
+			[&](const WinUsbPipe& winUsbPipe) { return size_t(winUsbPipe.maximumPacketSize); },
+			[&](QA40xEmulator*) { return QA40xEmulator::maximumPacketSizeInBytes; });
 	}
 
 	template <QA40x::ChannelType channelType>
@@ -95,8 +131,9 @@ namespace asio401 {
 		typeSpecific([&] {
 			if (IsLoggingEnabled()) Log() << "Writing " << value << " to QA40x register #" << int(registerNumber) << " as pending operation " << this;
 			return TypeSpecific<>{ .buffer = { std::byte(registerNumber), std::byte(value >> 24), std::byte(value >> 16), std::byte(value >> 8), std::byte(value >> 0) } };
-		}()),
-		winUsbOverlappedIO(channel.winUsbInterfaceHandle, channel.pipeId, WinUsbOverlappedIO::Write(typeSpecific.buffer), windowsReusableEvent) {}
+		}()) {
+		Start(channel, WinUsbOverlappedIO::Write(typeSpecific.buffer), windowsReusableEvent);
+	}
 
 	template <QA40x::ChannelType channelType>
 	QA40x::Channel<channelType>::Pending::Pending(Channel channel, std::span<const std::byte> buffer, WindowsReusableEvent& windowsReusableEvent) requires (channelType == ChannelType::WRITE) :
@@ -104,8 +141,9 @@ namespace asio401 {
 			if (IsLoggingEnabled()) Log() << "Writing " << buffer.size() << " bytes to QA40x" << " as pending operation " << this;
 			assert(!buffer.empty());
 			return TypeSpecific<>{};
-		}()),
-		winUsbOverlappedIO(channel.winUsbInterfaceHandle, channel.pipeId, WinUsbOverlappedIO::Write(buffer), windowsReusableEvent) {}
+		}()) {
+		Start(channel, WinUsbOverlappedIO::Write(buffer), windowsReusableEvent);
+	}
 
 	template <QA40x::ChannelType channelType>
 	QA40x::Channel<channelType>::Pending::Pending(Channel channel, std::span<std::byte> buffer, WindowsReusableEvent& windowsReusableEvent) requires (channelType == ChannelType::READ) :
@@ -113,13 +151,32 @@ namespace asio401 {
 			if (IsLoggingEnabled()) Log() << "Reading " << buffer.size() << " bytes from QA40x" << " as pending operation " << this;
 			assert(!buffer.empty());
 			return TypeSpecific<>{};
-		}()),
-		winUsbOverlappedIO(channel.winUsbInterfaceHandle, channel.pipeId, WinUsbOverlappedIO::Read(buffer), windowsReusableEvent) {}
+		}()) {
+		Start(channel, WinUsbOverlappedIO::Read(buffer), windowsReusableEvent);
+	}
+
+	template <QA40x::ChannelType channelType>
+	void QA40x::Channel<channelType>::Pending::Start(Channel channel, WinUsbOverlappedIO::Operation operation, WindowsReusableEvent& windowsReusableEvent) {
+		OnVariant(channel.pipe,
+			[&](const WinUsbPipe& winUsbPipe) {
+				transfer.template emplace<WinUsbOverlappedIO>(winUsbPipe.interfaceHandle, winUsbPipe.pipeId, operation, windowsReusableEvent);
+			},
+			[&](QA40xEmulator* emulator) {
+				OnVariant(operation,
+					[&](WinUsbOverlappedIO::Write write) { transfer.template emplace<QA40xEmulator::Transfer>(*emulator, emulatorPipe<channelType>, write.buffer); },
+					[&](WinUsbOverlappedIO::Read read) { transfer.template emplace<QA40xEmulator::Transfer>(*emulator, read.buffer); });
+			});
+	}
 
 	template <QA40x::ChannelType channelType>
 	_Check_return_ QA40x::AwaitResult QA40x::Channel<channelType>::Pending::Await() {
 		if (IsLoggingEnabled()) Log() << "Awaiting result of QA40x pending " << channelName<channelType> << " operation " << this;
-		return winUsbOverlappedIO.Await();
+		return OnVariant(transfer,
+			[](std::monostate) -> AwaitResult { abort(); },
+			[](WinUsbOverlappedIO& winUsbOverlappedIO) { return winUsbOverlappedIO.Await(); },
+			[](QA40xEmulator::Transfer& emulatorTransfer) {
+				return emulatorTransfer.Await() == QA40xEmulator::AwaitResult::ABORTED ? AwaitResult::ABORTED : AwaitResult::SUCCESSFUL;
+			});
 	}
 
 	template QA40x::RegisterChannel;
@@ -129,7 +186,15 @@ namespace asio401 {
 	template <QA40x::ChannelType channelType>
 	QA40x::AwaitResult QA40xIOSlot<channelType>::Await() {
 		assert(pending.has_value());
-		auto result = pending->Await();
+		QA40x::AwaitResult result;
+		try {
+			result = pending->Await();
+		}
+		catch (...) {
+			// The operation is over even if it failed, so make sure the slot can be reused.
+			pending.reset();
+			throw;
+		}
 		pending.reset();
 		return result;
 	}
@@ -150,4 +215,30 @@ namespace asio401 {
 	template WriteQA40xIOSlot;
 	template ReadQA40xIOSlot;
 
+	void QA40xRegisterBatch::Execute(QA40x::RegisterChannel channel, std::span<const Write> writes) {
+		assert(writes.size() <= ioSlots.size());
+		if (writes.size() > ioSlots.size()) throw std::runtime_error("Too many writes in QA40x register batch: " + std::to_string(writes.size()));
+
+		// Whatever happens, we need to await all the writes we started before we can return; rethrow the first error after that.
+		std::exception_ptr error;
+		size_t startedCount = 0;
+		try {
+			for (; startedCount < writes.size(); ++startedCount)
+				ioSlots[startedCount].Start(channel, writes[startedCount].registerNumber, writes[startedCount].value);
+		}
+		catch (...) {
+			error = std::current_exception();
+		}
+		for (size_t slotIndex = 0; slotIndex < startedCount; ++slotIndex) {
+			try {
+				if (ioSlots[slotIndex].Await() == QA40x::AwaitResult::ABORTED)
+					throw std::runtime_error("QA40x register write was unexpectedly aborted");
+			}
+			catch (...) {
+				if (!error) error = std::current_exception();
+			}
+		}
+		if (error) std::rethrow_exception(error);
+	}
+
 }
\ No newline at end of file
@@ -1,9 +1,12 @@
 #pragma once
 
+#include "qa40x_emulator.h"
 #include "winusb.h"
 
 #include <array>
+#include <map>
 #include <span>
+#include <variant>
 #include <vector>
 
 namespace asio401 {
@@ -11,6 +14,8 @@ namespace asio401 {
 	class QA40x final {
 	public:
 		QA40x(std::string_view devicePath, UCHAR registerPipeId, UCHAR writePipeId, UCHAR readPipeId, bool requiresApp);
+		// Talks to an in-process software emulation of the device instead of actual hardware.
+		QA40x(QA40xEmulator::Model, QA40xEmulator::Options);
 
 		using AwaitResult = WinUsbOverlappedIO::AwaitResult;
 
@@ -21,6 +26,9 @@ namespace asio401 {
 			explicit Channel(QA40x& qa40x);
 			void Abort();
 
+			// Transfers that are a multiple of this size do not end with a short USB packet.
+			size_t GetMaximumPacketSizeInBytes() const;
+
 			class Pending {
 			public:
 				Pending(Channel, uint8_t registerNumber, uint32_t value, WindowsReusableEvent&) requires (channelType == ChannelType::REGISTER);
@@ -33,7 +41,7 @@ namespace asio401 {
 				_Check_return_ AwaitResult Await();
 
 			private:
-				Pending(QA40x&, UCHAR pipeId, WinUsbOverlappedIO::Operation, WindowsReusableEvent&);
+				void Start(Channel, WinUsbOverlappedIO::Operation, WindowsReusableEvent&);
 
 				template <ChannelType = channelType> struct TypeSpecific final { TypeSpecific() = delete; };
 				template <> struct TypeSpecific<ChannelType::REGISTER> {
@@ -43,25 +51,34 @@ namespace asio401 {
 				template <> struct TypeSpecific<ChannelType::READ> { };
 				[[no_unique_address, msvc::no_unique_address]] TypeSpecific<> typeSpecific;
 
-				WinUsbOverlappedIO winUsbOverlappedIO;
+				std::variant<std::monostate, WinUsbOverlappedIO, QA40xEmulator::Transfer> transfer;
 			};
 
 		private:
-			WINUSB_INTERFACE_HANDLE winUsbInterfaceHandle;
-			UCHAR pipeId;
+			struct WinUsbPipe final {
+				WINUSB_INTERFACE_HANDLE interfaceHandle;
+				UCHAR pipeId;
+				USHORT maximumPacketSize;
+			};
+
+			std::variant<WinUsbPipe, QA40xEmulator*> pipe;
 		};
 		using RegisterChannel = Channel<ChannelType::REGISTER>;
 		using WriteChannel = Channel<ChannelType::WRITE>;
 		using ReadChannel = Channel<ChannelType::READ>;
 
 	private:
-		void Validate(bool requiresApp);
+		struct WinUsbDevice final {
+			WinUsbHandle winUsb;
+			UCHAR registerPipeId;
+			UCHAR writePipeId;
+			UCHAR readPipeId;
+			std::map<UCHAR, USHORT> maximumPacketSizes;
+		};
 
-		const UCHAR registerPipeId;
-		const UCHAR writePipeId;
-		const UCHAR readPipeId;
+		static void Validate(WinUsbDevice&, bool requiresApp);
 
-		WinUsbHandle winUsb;
+		std::variant<WinUsbDevice, QA40xEmulator> transport;
 	};
 	extern template QA40x::RegisterChannel;
 	extern template QA40x::WriteChannel;
@@ -101,4 +118,26 @@ namespace asio401 {
 	extern template WriteQA40xIOSlot;
 	extern template ReadQA40xIOSlot;
 
+	// Writes a sequence of registers as back-to-back overlapped transfers, then awaits them all. The device processes the writes in order, just as if
+	// they were executed one by one, but we save a USB round trip per write by not waiting for each write to complete before starting the next one.
+	// Any delays the hardware needs between writes have to be done by splitting the sequence into multiple batches.
+	class QA40xRegisterBatch final {
+	public:
+		struct Write final {
+			uint8_t registerNumber;
+			uint32_t value;
+		};
+		static constexpr size_t maxWrites = 8;
+
+		QA40xRegisterBatch() = default;
+		QA40xRegisterBatch(const QA40xRegisterBatch&) = delete;
+		QA40xRegisterBatch& operator=(const QA40xRegisterBatch&) = delete;
+
+		// All writes have completed when this returns, even if it throws.
+		void Execute(QA40x::RegisterChannel, std::span<const Write>);
+
+	private:
+		std::array<RegisterQA40xIOSlot, maxWrites> ioSlots;
+	};
+
 }
@@ -0,0 +1,308 @@
+#include "qa40x_emulator.h"
+
+#include "log.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace asio401 {
+
+	namespace {
+
+		constexpr std::string_view GetModelName(QA40xEmulator::Model model) {
+			switch (model) {
+			case QA40xEmulator::Model::QA401: return "QA401";
+			case QA40xEmulator::Model::QA403: return "QA403";
+			}
+			return "QA40x";
+		}
+
+		constexpr size_t GetWriteGranularityInFrames(QA40xEmulator::Model model) {
+			return model == QA40xEmulator::Model::QA401 ? 32 : 64;
+		}
+
+		// The QA401 uses big endian samples, the QA403 uses little endian samples.
+		int32_t LoadSample(QA40xEmulator::Model model, const std::byte* const sample) {
+			uint32_t value = 0;
+			for (size_t byteIndex = 0; byteIndex < QA40xEmulator::sampleSizeInBytes; ++byteIndex) {
+				const auto shift = 8 * (model == QA40xEmulator::Model::QA401 ? QA40xEmulator::sampleSizeInBytes - 1 - byteIndex : byteIndex);
+				value |= uint32_t(sample[byteIndex]) << shift;
+			}
+			return int32_t(value);
+		}
+
+		void StoreSample(QA40xEmulator::Model model, std::byte* const sample, const int32_t value) {
+			for (size_t byteIndex = 0; byteIndex < QA40xEmulator::sampleSizeInBytes; ++byteIndex) {
+				const auto shift = 8 * (model == QA40xEmulator::Model::QA401 ? QA40xEmulator::sampleSizeInBytes - 1 - byteIndex : byteIndex);
+				sample[byteIndex] = std::byte(uint32_t(value) >> shift);
+			}
+		}
+
+		int32_t InvertPolarity(const int32_t sample) {
+			return sample == (std::numeric_limits<int32_t>::min)() ? (std::numeric_limits<int32_t>::max)() : -sample;
+		}
+
+	}
+
+	QA40xEmulator::QA40xEmulator(Model model, Options options) : model(model), options(options) {
+		Log() << "Starting emulated " << GetModelName(model) << " with a sample clock error of " << options.sampleClockErrorPPM << " ppm";
+		if (options.faultIntervalSeconds.has_value()) Log() << "Emulated " << GetModelName(model) << " will inject a fault every " << *options.faultIntervalSeconds << " seconds of streaming";
+		clockThread = std::thread([&] { RunClock(); });
+	}
+
+	QA40xEmulator::~QA40xEmulator() {
+		{
+			std::scoped_lock lock(mutex);
+			StopStreaming();
+			shutdown = true;
+		}
+		stateChanged.notify_all();
+		clockThread.join();
+		Log() << "Emulated " << GetModelName(model) << " stopped";
+		assert(pendingWrites.empty());
+		assert(pendingReads.empty());
+	}
+
+	QA40xEmulator::Transfer::Transfer(QA40xEmulator& emulator, Pipe pipe, std::span<const std::byte> source) : emulator(emulator), pipe(pipe), source(source) {
+		assert(pipe != Pipe::READ);
+		std::scoped_lock lock(emulator.mutex);
+		emulator.Start(*this);
+	}
+
+	QA40xEmulator::Transfer::Transfer(QA40xEmulator& emulator, std::span<std::byte> destination) : emulator(emulator), pipe(Pipe::READ), destination(destination) {
+		std::scoped_lock lock(emulator.mutex);
+		emulator.Start(*this);
+	}
+
+	QA40xEmulator::Transfer::~Transfer() {
+		std::scoped_lock lock(emulator.mutex);
+		// This can only happen if the transfer was never awaited, which is a bug in the caller. Just make sure we don't leave a dangling pointer behind.
+		if (!result.has_value()) emulator.Cancel(*this);
+	}
+
+	QA40xEmulator::AwaitResult QA40xEmulator::Transfer::Await() {
+		std::unique_lock lock(emulator.mutex);
+		emulator.stateChanged.wait(lock, [&] { return result.has_value(); });
+		return *result;
+	}
+
+	void QA40xEmulator::Abort(Pipe pipe) {
+		if (IsLoggingEnabled()) Log() << "Aborting all transfers on emulated " << GetModelName(model) << " pipe";
+		std::scoped_lock lock(mutex);
+		auto& pendingTransfers = pipe == Pipe::WRITE ? pendingWrites : pendingReads;
+		// Register transfers complete immediately, so there is never anything to abort on the register pipe.
+		if (pipe == Pipe::REGISTER) return;
+		for (const auto transfer : pendingTransfers) Complete(*transfer, AwaitResult::ABORTED);
+		pendingTransfers.clear();
+	}
+
+	void QA40xEmulator::Start(Transfer& transfer) {
+		switch (transfer.pipe) {
+		case Pipe::REGISTER: {
+			if (transfer.source.size() != 5) throw std::runtime_error("Invalid emulated QA40x register write size: " + std::to_string(transfer.source.size()) + " bytes");
+			const auto value = uint32_t(transfer.source[1]) << 24 | uint32_t(transfer.source[2]) << 16 | uint32_t(transfer.source[3]) << 8 | uint32_t(transfer.source[4]);
+			WriteRegister(uint8_t(transfer.source[0]), value);
+			Complete(transfer, AwaitResult::SUCCESSFUL);
+			break;
+		}
+		case Pipe::WRITE: {
+			if (transfer.source.empty() || transfer.source.size() % frameSizeInBytes != 0) throw std::runtime_error("Invalid emulated QA40x write size: " + std::to_string(transfer.source.size()) + " bytes");
+			const auto sizeInFrames = transfer.source.size() / frameSizeInBytes;
+			if (sizeInFrames % GetWriteGranularityInFrames(model) != 0) {
+				++statistics.misalignedWrites;
+				Log() << "WARNING: write of " << sizeInFrames << " frames to emulated " << GetModelName(model) << " is not a multiple of " << GetWriteGranularityInFrames(model) << " frames; real hardware would garble the output";
+			}
+			pendingWrites.push_back(&transfer);
+			FillOutputQueue();
+			MaybeStartStreaming();
+			break;
+		}
+		case Pipe::READ: {
+			if (transfer.destination.empty() || transfer.destination.size() % frameSizeInBytes != 0) throw std::runtime_error("Invalid emulated QA40x read size: " + std::to_string(transfer.destination.size()) + " bytes");
+			pendingReads.push_back(&transfer);
+			DrainInputQueue();
+			break;
+		}
+		}
+	}
+
+	void QA40xEmulator::Cancel(Transfer& transfer) {
+		for (auto* pendingTransfers : { &pendingWrites, &pendingReads })
+			pendingTransfers->erase(std::remove(pendingTransfers->begin(), pendingTransfers->end(), &transfer), pendingTransfers->end());
+	}
+
+	void QA40xEmulator::Complete(Transfer& transfer, AwaitResult result) {
+		assert(!transfer.result.has_value());
+		transfer.result = result;
+		stateChanged.notify_all();
+	}
+
+	void QA40xEmulator::WriteRegister(uint8_t registerNumber, uint32_t value) {
+		if (IsLoggingEnabled()) Log() << "Emulated " << GetModelName(model) << " register #" << int(registerNumber) << " set to " << value;
+		switch (model) {
+		case Model::QA401:
+			if (registerNumber == 4) {
+				// Writing 5 is the last step of the reset sequence (see QA401::Reset()); anything else means a reset is in progress.
+				if (value == 5) {
+					armed = true;
+					MaybeStartStreaming();
+				}
+				else StopStreaming();
+			}
+			if (registerNumber == 5) sampleRate = value & 0x04 ? 48000 : 192000;
+			break;
+		case Model::QA403:
+			if (registerNumber == 8) {
+				if (value == 5) {
+					armed = true;
+					MaybeStartStreaming();
+				}
+				else StopStreaming();
+			}
+			if (registerNumber == 9) {
+				constexpr std::array<uint32_t, 4> sampleRates = { 48000, 96000, 192000, 384000 };
+				if (value >= sampleRates.size()) throw std::runtime_error("Invalid emulated QA403 sample rate register value: " + std::to_string(value));
+				sampleRate = sampleRates[value];
+			}
+			break;
+		}
+	}
+
+	void QA40xEmulator::StopStreaming() {
+		armed = false;
+		outputQueue.clear();
+		inputQueue.clear();
+		if (!streamStartTime.has_value()) return;
+		streamStartTime.reset();
+		Log() << "Emulated " << GetModelName(model) << " stopped streaming after " << elapsedFrames << " frames at " << sampleRate << " Hz; "
+			<< statistics.outputUnderrunFrames << " frames played from an empty output queue, "
+			<< statistics.inputOverflowFrames << " frames lost to input queue overflow, "
+			<< statistics.misalignedWrites << " misaligned writes, "
+			<< statistics.injectedFaults << " injected faults";
+		statistics = {};
+	}
+
+	void QA40xEmulator::MaybeStartStreaming() {
+		if (!armed || streamStartTime.has_value()) return;
+		// The QA401 starts as soon as it has something to play, while the QA403 waits for its queue to fill up.
+		const size_t outputQueueStartThresholdInFrames = model == Model::QA401 ? 1 : hardwareQueueSizeInFrames;
+		if (outputQueue.size() < outputQueueStartThresholdInFrames) return;
+
+		if (IsLoggingEnabled()) Log() << "Emulated " << GetModelName(model) << " starts streaming at " << sampleRate << " Hz";
+		// The QA401 replays the last 64 frames of the previous stream, followed by silence. See https://github.com/dechamps/ASIO401/issues/5
+		std::rotate(lastInputFrames.begin(), lastInputFrames.begin() + elapsedFrames % lastInputFrames.size(), lastInputFrames.end());
+		staleInputFrames = lastInputFrames;
+		inputGarbageRemainingFrames = model == Model::QA401 ? 1088 : 0;
+		elapsedFrames = 0;
+		if (options.faultIntervalSeconds.has_value()) nextFaultFrame = (std::max)(uint64_t(*options.faultIntervalSeconds * sampleRate), uint64_t(1));
+		streamStartTime = Clock::now();
+		stateChanged.notify_all();
+	}
+
+	void QA40xEmulator::FillOutputQueue() {
+		while (!pendingWrites.empty() && outputQueue.size() < hardwareQueueSizeInFrames) {
+			auto& transfer = *pendingWrites.front();
+			auto& frame = outputQueue.emplace_back();
+			memcpy(frame.data(), transfer.source.data() + transfer.transferredBytes, frameSizeInBytes);
+			transfer.transferredBytes += frameSizeInBytes;
+			if (transfer.transferredBytes < transfer.source.size()) continue;
+			pendingWrites.pop_front();
+			Complete(transfer, AwaitResult::SUCCESSFUL);
+		}
+	}
+
+	void QA40xEmulator::DrainInputQueue() {
+		while (!pendingReads.empty() && !inputQueue.empty()) {
+			auto& transfer = *pendingReads.front();
+			memcpy(transfer.destination.data() + transfer.transferredBytes, inputQueue.front().data(), frameSizeInBytes);
+			inputQueue.pop_front();
+			transfer.transferredBytes += frameSizeInBytes;
+			if (transfer.transferredBytes < transfer.destination.size()) continue;
+			pendingReads.pop_front();
+			Complete(transfer, AwaitResult::SUCCESSFUL);
+		}
+	}
+
+	void QA40xEmulator::RunClock() {
+		// How often the emulated device catches up with the passage of time. This is similar in spirit to the USB frame interval.
+		constexpr auto tickPeriod = std::chrono::milliseconds(1);
+
+		std::unique_lock lock(mutex);
+		while (!shutdown) {
+			if (!streamStartTime.has_value()) {
+				stateChanged.wait(lock);
+				continue;
+			}
+			stateChanged.wait_for(lock, tickPeriod);
+			if (streamStartTime.has_value()) AdvanceClock(Clock::now());
+		}
+	}
+
+	void QA40xEmulator::AdvanceClock(Clock::time_point now) {
+		assert(streamStartTime.has_value());
+		const auto actualSampleRate = sampleRate * (1 + options.sampleClockErrorPPM / 1e6);
+		const auto dueFrames = uint64_t(std::chrono::duration<double>(now - *streamStartTime).count() * actualSampleRate);
+		for (; elapsedFrames < dueFrames; ++elapsedFrames) {
+			Frame playedFrame = {};
+			if (outputQueue.empty()) ++statistics.outputUnderrunFrames;
+			else {
+				playedFrame = outputQueue.front();
+				outputQueue.pop_front();
+			}
+
+			auto recordedFrame = Loopback(playedFrame);
+			if (inputGarbageRemainingFrames > 0) {
+				const auto garbageFrameIndex = 1088 - inputGarbageRemainingFrames;
+				recordedFrame = garbageFrameIndex < staleInputFrames.size() ? staleInputFrames[garbageFrameIndex] : Frame{};
+				--inputGarbageRemainingFrames;
+			}
+			lastInputFrames[elapsedFrames % lastInputFrames.size()] = recordedFrame;
+
+			if (inputQueue.size() >= hardwareQueueSizeInFrames) {
+				++statistics.inputOverflowFrames;
+				inputQueue.pop_front();
+			}
+			inputQueue.push_back(recordedFrame);
+		}
+		FillOutputQueue();
+		DrainInputQueue();
+		if (options.faultIntervalSeconds.has_value() && elapsedFrames >= nextFaultFrame) {
+			nextFaultFrame += (std::max)(uint64_t(*options.faultIntervalSeconds * sampleRate), uint64_t(1));
+			InjectFault();
+		}
+	}
+
+	void QA40xEmulator::InjectFault() {
+		// Prefer reads, as the driver does not await the prefix write while streaming.
+		auto& pendingTransfers = pendingReads.empty() ? pendingWrites : pendingReads;
+		if (pendingTransfers.empty()) return;
+		Log() << "Emulated " << GetModelName(model) << " injecting a fault at frame " << elapsedFrames << ": aborting a pending " << (&pendingTransfers == &pendingReads ? "read" : "write");
+		++statistics.injectedFaults;
+		Complete(*pendingTransfers.front(), AwaitResult::ABORTED);
+		pendingTransfers.pop_front();
+	}
+
+	QA40xEmulator::Frame QA40xEmulator::Loopback(const Frame& playedFrame) {
+		const auto loadOutputSample = [&](size_t slot) {
+			const auto sample = LoadSample(model, playedFrame.data() + slot * sampleSizeInBytes);
+			// The QA401 inverts the polarity of its outputs. See https://github.com/dechamps/ASIO401/issues/14
+			return model == Model::QA401 ? InvertPolarity(sample) : sample;
+		};
+		// Both the QA401 and QA403 have their output channels swapped.
+		const auto left = loadOutputSample(1);
+		const auto right = loadOutputSample(0);
+
+		Frame recordedFrame;
+		// The right input channel has its polarity inverted. See https://github.com/dechamps/ASIO401/issues/14
+		// The QA401 also has its input channels swapped. See https://github.com/dechamps/ASIO401/issues/13
+		const size_t leftSlot = model == Model::QA401 ? 1 : 0;
+		StoreSample(model, recordedFrame.data() + leftSlot * sampleSizeInBytes, left);
+		StoreSample(model, recordedFrame.data() + (1 - leftSlot) * sampleSizeInBytes, InvertPolarity(right));
+		return recordedFrame;
+	}
+
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <thread>
+
+namespace asio401 {
+
+	// An in-process software emulation of the QA40x USB protocol, for use in lieu of actual hardware.
+	// This makes it possible to exercise and profile the entire streaming engine without a QA40x device.
+	//
+	// The emulator implements the device behaviour ASIO401 relies on (see the comments in qa401.h, qa403.h and RunThread()):
+	//  - 1024-frame hardware output and input queues, drained and filled in real time according to the configured sample rate;
+	//  - the QA401 starts streaming as soon as it has something to play, the QA403 only once its output queue is full;
+	//  - the QA401 produces 1088 frames of garbage at the beginning of the input stream;
+	//  - writes that are not a multiple of the device write granularity are flagged.
+	// The output is looped back to the input, i.e. whatever is played on the emulated output connectors is recorded on the emulated input connectors.
+	// This includes the per-device quirks of channel ordering and polarity, so that the driver's compensation for them can be verified end-to-end.
+	// Optionally, USB errors can be injected at regular intervals, to exercise error handling in the driver.
+	//
+	// This class does not depend on Windows.
+	class QA40xEmulator final {
+	public:
+		enum class Model { QA401, QA403 };
+		enum class Pipe { REGISTER, WRITE, READ };
+		enum class AwaitResult { SUCCESSFUL, ABORTED };
+
+		struct Options {
+			// Deviation of the emulated sample clock from its nominal frequency, in parts per million. Positive values make the emulated device run faster.
+			double sampleClockErrorPPM = 0;
+			// If set, a pending transfer is aborted every that many seconds of streaming, as if a transient USB error occurred.
+			std::optional<double> faultIntervalSeconds;
+		};
+
+		static constexpr size_t channelCount = 2;
+		static constexpr size_t sampleSizeInBytes = 4;
+		static constexpr size_t frameSizeInBytes = channelCount * sampleSizeInBytes;
+		static constexpr size_t hardwareQueueSizeInFrames = 1024;
+		static constexpr size_t maximumPacketSizeInBytes = 512;  // Same as the real hardware, which uses USB 2.0 High Speed bulk endpoints
+
+		QA40xEmulator(Model, Options);
+		~QA40xEmulator();
+		QA40xEmulator(const QA40xEmulator&) = delete;
+		QA40xEmulator& operator=(const QA40xEmulator&) = delete;
+
+		// Equivalent to an overlapped I/O operation on a USB pipe. The transfer starts on construction and must be awaited before destruction.
+		class Transfer final {
+		public:
+			// For the REGISTER and WRITE pipes.
+			Transfer(QA40xEmulator&, Pipe, std::span<const std::byte>);
+			// For the READ pipe.
+			Transfer(QA40xEmulator&, std::span<std::byte>);
+			~Transfer();
+			Transfer(const Transfer&) = delete;
+			Transfer& operator=(const Transfer&) = delete;
+
+			AwaitResult Await();
+
+		private:
+			friend QA40xEmulator;
+
+			QA40xEmulator& emulator;
+			const Pipe pipe;
+			const std::span<const std::byte> source;
+			const std::span<std::byte> destination;
+			size_t transferredBytes = 0;
+			std::optional<AwaitResult> result;
+		};
+
+		// Completes all pending transfers on the pipe with AwaitResult::ABORTED.
+		void Abort(Pipe);
+
+	private:
+		using Clock = std::chrono::steady_clock;
+		using Frame = std::array<std::byte, frameSizeInBytes>;
+
+		void Start(Transfer&);
+		void Cancel(Transfer&);
+		void Complete(Transfer&, AwaitResult);
+		void WriteRegister(uint8_t registerNumber, uint32_t value);
+		void StopStreaming();
+		void MaybeStartStreaming();
+		void FillOutputQueue();
+		void DrainInputQueue();
+		void RunClock();
+		void AdvanceClock(Clock::time_point now);
+		void InjectFault();
+		Frame Loopback(const Frame&);
+
+		const Model model;
+		const Options options;
+
+		std::mutex mutex;
+		std::condition_variable stateChanged;
+
+		uint32_t sampleRate = 48000;
+		bool armed = false;
+		std::optional<Clock::time_point> streamStartTime;
+		uint64_t elapsedFrames = 0;
+		// Only used if `faultIntervalSeconds` is set.
+		uint64_t nextFaultFrame = 0;
+		size_t inputGarbageRemainingFrames = 0;
+		std::array<Frame, 64> lastInputFrames = {};
+		std::array<Frame, 64> staleInputFrames = {};
+
+		std::deque<Transfer*> pendingWrites;
+		std::deque<Transfer*> pendingReads;
+		std::deque<Frame> outputQueue;
+		std::deque<Frame> inputQueue;
+
+		struct Statistics {
+			uint64_t outputUnderrunFrames = 0;
+			uint64_t inputOverflowFrames = 0;
+			uint64_t misalignedWrites = 0;
+			uint64_t injectedFaults = 0;
+		};
+		Statistics statistics;
+
+		bool shutdown = false;
+		std::thread clockThread;
+	};
+
+}
@@ -0,0 +1,411 @@
+#include "resampler.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <numbers>
+#include <stdexcept>
+
+#if defined(_M_IX86) || defined(_M_X64)
+#include <intrin.h>
+#define ASIO401_RESAMPLER_X86
+#endif
+
+namespace asio401 {
+
+	namespace {
+
+		constexpr size_t sampleSizeInBytes = sizeof(int32_t);
+
+		// Stopband attenuation, in dB. This is well below the noise floor of the QA40x, so that resampling does not get in the way of measurements.
+		constexpr double stopbandAttenuation = 140;
+		// Width of the transition band, relative to the lower of the two sample rates. The transition band is centered on the Nyquist frequency of that
+		// sample rate, so the passband extends to 45.35% of it (20 kHz at 44.1 kHz).
+		constexpr double transitionWidth = 0.093;
+		// The number of taps per phase is rounded up to a multiple of this, so that SIMD kernels do not need to deal with leftovers.
+		constexpr size_t tapGranularity = 8;
+		// Kaiser's formula underestimates the length of filters with very wide transition bands, such as the first stages of a Decimator. Half-band
+		// filters with fewer nonzero coefficients than this do not quite reach the stopband attenuation.
+		constexpr size_t minimumHalfBandTapCount = 24;
+
+		double GetKaiserBeta() {
+			return 0.1102 * (stopbandAttenuation - 8.7);
+		}
+
+		// Modified Bessel function of the first kind, order 0, computed from its power series. Converges quickly for the arguments used here.
+		double BesselI0(const double x) {
+			double sum = 1;
+			double term = 1;
+			for (int k = 1; k < 1000; ++k) {
+				term *= (x / (2 * k)) * (x / (2 * k));
+				sum += term;
+				if (term < sum * 1e-17) break;
+			}
+			return sum;
+		}
+
+		// `position` goes from -1 (first tap) to +1 (last tap).
+		double GetKaiserWindow(const double position) {
+			const auto beta = GetKaiserBeta();
+			return BesselI0(beta * std::sqrt((std::max)(0.0, 1 - position * position))) / BesselI0(beta);
+		}
+
+		// Kaiser's formula for the length of a filter with the given transition width, relative to the sample rate it runs at.
+		double GetFilterLength(const double transitionWidth) {
+			return (stopbandAttenuation - 7.95) / (2.285 * 2 * std::numbers::pi * transitionWidth) + 1;
+		}
+
+		// Returns the filter in the layout that Resampler::coefficients expects. See the Resampler class for the design criteria.
+		std::vector<double> DesignCoefficients(const size_t upFactor, const size_t downFactor, const size_t tapsPerPhase) {
+			const auto length = upFactor * tapsPerPhase;
+			// Cutoff frequency, in cycles per sample at the upsampled rate.
+			const auto cutoff = 0.5 / double((std::max)(upFactor, downFactor));
+			const auto center = double(length - 1) / 2;
+			std::vector<double> filter(length);
+			for (size_t tap = 0; tap < length; ++tap) {
+				const auto t = double(tap) - center;
+				const auto sinc = t == 0 ? 1 : std::sin(2 * std::numbers::pi * cutoff * t) / (2 * std::numbers::pi * cutoff * t);
+				filter[tap] = 2 * cutoff * sinc * GetKaiserWindow(t / center);
+			}
+			// Normalize for unity gain at DC. Upsampling inserts `upFactor - 1` zeros between input samples, so the filter also has to make up for that.
+			double sum = 0;
+			for (const auto coefficient : filter) sum += coefficient;
+			for (auto& coefficient : filter) coefficient *= double(upFactor) / sum;
+
+			std::vector<double> coefficients(length);
+			for (size_t phase = 0; phase < upFactor; ++phase)
+				for (size_t tap = 0; tap < tapsPerPhase; ++tap)
+					coefficients[phase * tapsPerPhase + tap] = filter[phase + (tapsPerPhase - 1 - tap) * upFactor];
+			return coefficients;
+		}
+
+		// Returns the coefficients that Decimator::Stage::coefficients expects. The full filter has `2 * tapCount - 1` taps, and its cutoff is at half
+		// the Nyquist frequency, which is what makes it a half-band filter: the sinc is zero at every even distance from the center. The nonzero taps
+		// are at odd distances from the center, which correspond to even distances from the first tap. The filter is symmetric, so there is no need to
+		// reverse them.
+		std::vector<double> DesignHalfBandCoefficients(const size_t tapCount) {
+			const auto center = double(tapCount - 1);
+			std::vector<double> coefficients(tapCount);
+			for (size_t index = 0; index < tapCount; ++index) {
+				const auto t = double(2 * index) - center;
+				coefficients[index] = 0.5 * std::sin(std::numbers::pi * t / 2) / (std::numbers::pi * t / 2) * GetKaiserWindow(t / center);
+			}
+			// Normalize for unity gain at DC, taking the center tap (1/2) into account.
+			double sum = 0;
+			for (const auto coefficient : coefficients) sum += coefficient;
+			for (auto& coefficient : coefficients) coefficient *= 0.5 / sum;
+			return coefficients;
+		}
+
+		int32_t LoadSample(const std::byte* const sample, const bool swapEndianness) {
+			uint32_t value;
+			memcpy(&value, sample, sizeof(value));
+			return int32_t(swapEndianness ? _byteswap_ulong(value) : value);
+		}
+
+		void StoreSample(std::byte* const sample, const int32_t value, const bool swapEndianness) {
+			const uint32_t swapped = swapEndianness ? _byteswap_ulong(uint32_t(value)) : uint32_t(value);
+			memcpy(sample, &swapped, sizeof(swapped));
+		}
+
+		// Comparisons are written so that NaN ends up as negative full scale, like in sample conversion.
+		int32_t ClipToInt32(double value) {
+			value = value > -2147483648.0 ? value : -2147483648.0;
+			value = value < 2147483647.0 ? value : 2147483647.0;
+			return int32_t(std::nearbyint(value));
+		}
+
+		enum class Kernel { SCALAR, SSE2, AVX2 };
+
+		// All kernels add up the products in the same order (eight partial sums, one for each tap modulo 8, combined pairwise), so the results are
+		// identical regardless of which kernel is used. Several partial sums are needed anyway, so that the additions do not all wait on each other.
+		template <Kernel kernel>
+		double DotProduct(const double* const coefficients, const double* const samples, const size_t count) {
+			if constexpr (kernel == Kernel::SCALAR) {
+				std::array<double, tapGranularity> sums = {};
+				for (size_t index = 0; index < count; index += tapGranularity)
+					for (size_t lane = 0; lane < tapGranularity; ++lane)
+						sums[lane] += coefficients[index + lane] * samples[index + lane];
+				return ((sums[0] + sums[4]) + (sums[2] + sums[6])) + ((sums[1] + sums[5]) + (sums[3] + sums[7]));
+			}
+#ifdef ASIO401_RESAMPLER_X86
+			else if constexpr (kernel == Kernel::SSE2) {
+				auto sum01 = _mm_setzero_pd();
+				auto sum23 = _mm_setzero_pd();
+				auto sum45 = _mm_setzero_pd();
+				auto sum67 = _mm_setzero_pd();
+				for (size_t index = 0; index < count; index += tapGranularity) {
+					sum01 = _mm_add_pd(sum01, _mm_mul_pd(_mm_loadu_pd(coefficients + index), _mm_loadu_pd(samples + index)));
+					sum23 = _mm_add_pd(sum23, _mm_mul_pd(_mm_loadu_pd(coefficients + index + 2), _mm_loadu_pd(samples + index + 2)));
+					sum45 = _mm_add_pd(sum45, _mm_mul_pd(_mm_loadu_pd(coefficients + index + 4), _mm_loadu_pd(samples + index + 4)));
+					sum67 = _mm_add_pd(sum67, _mm_mul_pd(_mm_loadu_pd(coefficients + index + 6), _mm_loadu_pd(samples + index + 6)));
+				}
+				const auto sum = _mm_add_pd(_mm_add_pd(sum01, sum45), _mm_add_pd(sum23, sum67));
+				return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+			}
+			else {
+				auto sum0123 = _mm256_setzero_pd();
+				auto sum4567 = _mm256_setzero_pd();
+				for (size_t index = 0; index < count; index += tapGranularity) {
+					sum0123 = _mm256_add_pd(sum0123, _mm256_mul_pd(_mm256_loadu_pd(coefficients + index), _mm256_loadu_pd(samples + index)));
+					sum4567 = _mm256_add_pd(sum4567, _mm256_mul_pd(_mm256_loadu_pd(coefficients + index + 4), _mm256_loadu_pd(samples + index + 4)));
+				}
+				const auto sum256 = _mm256_add_pd(sum0123, sum4567);
+				const auto sum = _mm_add_pd(_mm256_castpd256_pd128(sum256), _mm256_extractf128_pd(sum256, 1));
+				return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+			}
+#endif
+		}
+
+		// Computes output frames until the filter window reaches `end`. Returns the number of frames written to `output`.
+		template <Kernel kernel, size_t channelCount>
+		size_t Resample(const double* const coefficients, const size_t tapsPerPhase, const size_t upFactor, const size_t downFactor, const double* const history, const size_t historyCapacityInFrames, size_t& position, size_t& phase, const size_t end, std::byte* const output, const bool swapOutputEndianness) {
+			size_t frameCount = 0;
+			while (position < end) {
+				const auto phaseCoefficients = coefficients + phase * tapsPerPhase;
+				const auto windowBegin = position + 1 - tapsPerPhase;
+				for (size_t channel = 0; channel < channelCount; ++channel)
+					StoreSample(output + (frameCount * channelCount + channel) * sampleSizeInBytes, ClipToInt32(DotProduct<kernel>(phaseCoefficients, history + channel * historyCapacityInFrames + windowBegin, tapsPerPhase)), swapOutputEndianness);
+				++frameCount;
+				phase += downFactor;
+				position += phase / upFactor;
+				phase %= upFactor;
+			}
+			return frameCount;
+		}
+
+		// Computes `frameCount` output frames of a Decimator stage, from the dense and center frames at the beginning of each row.
+		//
+		// Unlike the Resampler, all output frames use the same coefficients, so the SIMD kernels compute several consecutive output frames at once,
+		// one per lane. This way, there is no need to add up the lanes at the end of each dot product, which matters for the short filters of the
+		// first stages. The products are still added up in the same order as in DotProduct(), so the results are the same as the scalar kernel's.
+		template <Kernel kernel, size_t channelCount>
+		void DecimateHalfBand(const double* const coefficients, const size_t tapCount, const double* const dense, const double* const center, double* const output, const size_t capacityInFrames, const size_t frameCount) {
+			for (size_t channel = 0; channel < channelCount; ++channel) {
+				const auto row = channel * capacityInFrames;
+				size_t frame = 0;
+#ifdef ASIO401_RESAMPLER_X86
+				if constexpr (kernel == Kernel::SSE2) {
+					for (; frame + 2 <= frameCount; frame += 2) {
+						const auto window = dense + row + frame;
+						auto sum0 = _mm_setzero_pd(); auto sum1 = _mm_setzero_pd(); auto sum2 = _mm_setzero_pd(); auto sum3 = _mm_setzero_pd();
+						auto sum4 = _mm_setzero_pd(); auto sum5 = _mm_setzero_pd(); auto sum6 = _mm_setzero_pd(); auto sum7 = _mm_setzero_pd();
+						for (size_t index = 0; index < tapCount; index += tapGranularity) {
+							sum0 = _mm_add_pd(sum0, _mm_mul_pd(_mm_set1_pd(coefficients[index]), _mm_loadu_pd(window + index)));
+							sum1 = _mm_add_pd(sum1, _mm_mul_pd(_mm_set1_pd(coefficients[index + 1]), _mm_loadu_pd(window + index + 1)));
+							sum2 = _mm_add_pd(sum2, _mm_mul_pd(_mm_set1_pd(coefficients[index + 2]), _mm_loadu_pd(window + index + 2)));
+							sum3 = _mm_add_pd(sum3, _mm_mul_pd(_mm_set1_pd(coefficients[index + 3]), _mm_loadu_pd(window + index + 3)));
+							sum4 = _mm_add_pd(sum4, _mm_mul_pd(_mm_set1_pd(coefficients[index + 4]), _mm_loadu_pd(window + index + 4)));
+							sum5 = _mm_add_pd(sum5, _mm_mul_pd(_mm_set1_pd(coefficients[index + 5]), _mm_loadu_pd(window + index + 5)));
+							sum6 = _mm_add_pd(sum6, _mm_mul_pd(_mm_set1_pd(coefficients[index + 6]), _mm_loadu_pd(window + index + 6)));
+							sum7 = _mm_add_pd(sum7, _mm_mul_pd(_mm_set1_pd(coefficients[index + 7]), _mm_loadu_pd(window + index + 7)));
+						}
+						const auto sum = _mm_add_pd(_mm_add_pd(_mm_add_pd(sum0, sum4), _mm_add_pd(sum2, sum6)), _mm_add_pd(_mm_add_pd(sum1, sum5), _mm_add_pd(sum3, sum7)));
+						_mm_storeu_pd(output + row + frame, _mm_add_pd(sum, _mm_mul_pd(_mm_set1_pd(0.5), _mm_loadu_pd(center + row + frame))));
+					}
+				}
+				else if constexpr (kernel == Kernel::AVX2) {
+					for (; frame + 4 <= frameCount; frame += 4) {
+						const auto window = dense + row + frame;
+						auto sum0 = _mm256_setzero_pd(); auto sum1 = _mm256_setzero_pd(); auto sum2 = _mm256_setzero_pd(); auto sum3 = _mm256_setzero_pd();
+						auto sum4 = _mm256_setzero_pd(); auto sum5 = _mm256_setzero_pd(); auto sum6 = _mm256_setzero_pd(); auto sum7 = _mm256_setzero_pd();
+						for (size_t index = 0; index < tapCount; index += tapGranularity) {
+							sum0 = _mm256_add_pd(sum0, _mm256_mul_pd(_mm256_broadcast_sd(coefficients + index), _mm256_loadu_pd(window + index)));
+							sum1 = _mm256_add_pd(sum1, _mm256_mul_pd(_mm256_broadcast_sd(coefficients + index + 1), _mm256_loadu_pd(window + index + 1)));
+							sum2 = _mm256_add_pd(sum2, _mm256_mul_pd(_mm256_broadcast_sd(coefficients + index + 2), _mm256_loadu_pd(window + index + 2)));
+							sum3 = _mm256_add_pd(sum3, _mm256_mul_pd(_mm256_broadcast_sd(coefficients + index + 3), _mm256_loadu_pd(window + index + 3)));
+							sum4 = _mm256_add_pd(sum4, _mm256_mul_pd(_mm256_broadcast_sd(coefficients + index + 4), _mm256_loadu_pd(window + index + 4)));
+							sum5 = _mm256_add_pd(sum5, _mm256_mul_pd(_mm256_broadcast_sd(coefficients + index + 5), _mm256_loadu_pd(window + index + 5)));
+							sum6 = _mm256_add_pd(sum6, _mm256_mul_pd(_mm256_broadcast_sd(coefficients + index + 6), _mm256_loadu_pd(window + index + 6)));
+							sum7 = _mm256_add_pd(sum7, _mm256_mul_pd(_mm256_broadcast_sd(coefficients + index + 7), _mm256_loadu_pd(window + index + 7)));
+						}
+						const auto sum = _mm256_add_pd(_mm256_add_pd(_mm256_add_pd(sum0, sum4), _mm256_add_pd(sum2, sum6)), _mm256_add_pd(_mm256_add_pd(sum1, sum5), _mm256_add_pd(sum3, sum7)));
+						_mm256_storeu_pd(output + row + frame, _mm256_add_pd(sum, _mm256_mul_pd(_mm256_set1_pd(0.5), _mm256_loadu_pd(center + row + frame))));
+					}
+				}
+#endif
+				// Leftover frames, if any.
+				for (; frame < frameCount; ++frame)
+					output[row + frame] = DotProduct<kernel>(coefficients, dense + row + frame, tapCount) + 0.5 * center[row + frame];
+			}
+		}
+
+	}
+
+	size_t GetResamplerTapsPerPhase(const size_t upFactor, const size_t downFactor) {
+		// The filter runs at the upsampled rate.
+		const auto length = GetFilterLength(transitionWidth / double((std::max)(upFactor, downFactor)));
+		const auto tapsPerPhase = size_t(std::ceil(length / double(upFactor)));
+		return (tapsPerPhase + tapGranularity - 1) / tapGranularity * tapGranularity;
+	}
+
+	double GetResamplerDelayInOutputFrames(const size_t upFactor, const size_t downFactor) {
+		// The filter is symmetric, so its group delay is half its length at the upsampled rate.
+		return double(upFactor * GetResamplerTapsPerPhase(upFactor, downFactor) - 1) / double(2 * downFactor);
+	}
+
+	template <size_t channelCount>
+	Resampler<channelCount>::Resampler(const size_t upFactor, const size_t downFactor, const size_t maximumInputFrameCount, const bool swapInputEndianness, const bool swapOutputEndianness) :
+		upFactor(upFactor), downFactor(downFactor), tapsPerPhase(GetResamplerTapsPerPhase(upFactor, downFactor)),
+		swapInputEndianness(swapInputEndianness), swapOutputEndianness(swapOutputEndianness),
+		coefficients(DesignCoefficients(upFactor, downFactor, tapsPerPhase)),
+		historyCapacityInFrames(tapsPerPhase - 1 + maximumInputFrameCount), history(channelCount * historyCapacityInFrames),
+		output((maximumInputFrameCount * upFactor / downFactor + 1) * channelCount * sampleSizeInBytes), position(tapsPerPhase - 1) {}
+
+	template <size_t channelCount>
+	std::span<const std::byte> Resampler<channelCount>::Process(const std::span<const std::byte> input, [[maybe_unused]] const CpuFeatures& cpuFeatures) {
+		const auto inputFrameCount = input.size() / (channelCount * sampleSizeInBytes);
+		if (inputFrameCount > historyCapacityInFrames - (tapsPerPhase - 1)) throw std::runtime_error("Resampler input is too large");
+
+		for (size_t frame = 0; frame < inputFrameCount; ++frame)
+			for (size_t channel = 0; channel < channelCount; ++channel)
+				history[channel * historyCapacityInFrames + tapsPerPhase - 1 + frame] = double(LoadSample(input.data() + (frame * channelCount + channel) * sampleSizeInBytes, swapInputEndianness));
+
+		const auto end = tapsPerPhase - 1 + inputFrameCount;
+		size_t outputFrameCount;
+#ifdef ASIO401_RESAMPLER_X86
+		if (cpuFeatures.avx2) outputFrameCount = Resample<Kernel::AVX2, channelCount>(coefficients.data(), tapsPerPhase, upFactor, downFactor, history.data(), historyCapacityInFrames, position, phase, end, output.data(), swapOutputEndianness);
+		else outputFrameCount = Resample<Kernel::SSE2, channelCount>(coefficients.data(), tapsPerPhase, upFactor, downFactor, history.data(), historyCapacityInFrames, position, phase, end, output.data(), swapOutputEndianness);
+#else
+		outputFrameCount = Resample<Kernel::SCALAR, channelCount>(coefficients.data(), tapsPerPhase, upFactor, downFactor, history.data(), historyCapacityInFrames, position, phase, end, output.data(), swapOutputEndianness);
+#endif
+
+		// Keep the input frames that the next output frames will need at the beginning of the history.
+		for (size_t channel = 0; channel < channelCount; ++channel) {
+			const auto row = history.data() + channel * historyCapacityInFrames;
+			std::copy(row + inputFrameCount, row + inputFrameCount + tapsPerPhase - 1, row);
+		}
+		position -= inputFrameCount;
+
+		return std::span(output).first(outputFrameCount * channelCount * sampleSizeInBytes);
+	}
+
+	template <size_t channelCount>
+	void Resampler<channelCount>::Reset() {
+		std::fill(history.begin(), history.end(), 0.0);
+		position = tapsPerPhase - 1;
+		phase = 0;
+	}
+
+	size_t GetDecimatorTapCount(const size_t stageCount, const size_t stageIndex) {
+		// Relative to the output sample rate of the last stage, the passband extends to `0.5 - transitionWidth / 2`. Each stage has to keep that
+		// passband intact, and get rid of everything that would alias into it, i.e. everything above its own output sample rate minus the
+		// passband. Relative to the input sample rate of the stage, this makes for a transition band centered on 1/4, as required of a half-band
+		// filter, that gets narrower towards the last stage.
+		const auto passband = (0.5 - transitionWidth / 2) / double(size_t(1) << (stageCount - 1 - stageIndex));
+		const auto length = GetFilterLength(0.5 - passband);
+		// Only every other tap is nonzero.
+		const auto tapCount = (std::max)(size_t(std::ceil(length / 2)), minimumHalfBandTapCount);
+		return (tapCount + tapGranularity - 1) / tapGranularity * tapGranularity;
+	}
+
+	double GetDecimatorDelayInOutputFrames(const size_t stageCount) {
+		// Each filter is symmetric, with `2 * tapCount - 1` taps, so its group delay is `tapCount - 1` input frames. An output frame is computed as
+		// soon as the most recent input frame it depends on is available, so there is no additional delay.
+		double delayInFrames = 0;
+		for (size_t stageIndex = 0; stageIndex < stageCount; ++stageIndex)
+			delayInFrames += double(GetDecimatorTapCount(stageCount, stageIndex) - 1) / double(size_t(1) << (stageCount - stageIndex));
+		return delayInFrames;
+	}
+
+	template <size_t channelCount>
+	Decimator<channelCount>::Decimator(const size_t stageCount, const size_t maximumInputFrameCount, const bool swapInputEndianness, const bool swapOutputEndianness) :
+		maximumInputFrameCount(maximumInputFrameCount), swapInputEndianness(swapInputEndianness), swapOutputEndianness(swapOutputEndianness),
+		input(channelCount * maximumInputFrameCount) {
+		auto maximumStageInputFrameCount = maximumInputFrameCount;
+		for (size_t stageIndex = 0; stageIndex < stageCount; ++stageIndex) {
+			const auto tapCount = GetDecimatorTapCount(stageCount, stageIndex);
+			const auto maximumStageOutputFrameCount = (maximumStageInputFrameCount + 1) / 2;
+			const auto capacityInFrames = tapCount - 1 + maximumStageOutputFrameCount;
+			stages.push_back({
+				.coefficients = DesignHalfBandCoefficients(tapCount),
+				.capacityInFrames = capacityInFrames,
+				.dense = std::vector<double>(channelCount * capacityInFrames),
+				.center = std::vector<double>(channelCount * capacityInFrames),
+				.centerFrameCount = tapCount / 2,
+				.output = std::vector<double>(channelCount * capacityInFrames),
+				.nextFrameIsOdd = false,
+			});
+			maximumStageInputFrameCount = maximumStageOutputFrameCount;
+		}
+		output.resize(maximumStageInputFrameCount * channelCount * sampleSizeInBytes);
+	}
+
+	template <size_t channelCount>
+	std::span<const std::byte> Decimator<channelCount>::Process(const std::span<const std::byte> inputFrames, const CpuFeatures& cpuFeatures) {
+		const auto inputFrameCount = inputFrames.size() / (channelCount * sampleSizeInBytes);
+		if (inputFrameCount > maximumInputFrameCount) throw std::runtime_error("Decimator input is too large");
+
+		for (size_t frame = 0; frame < inputFrameCount; ++frame)
+			for (size_t channel = 0; channel < channelCount; ++channel)
+				input[channel * maximumInputFrameCount + frame] = double(LoadSample(inputFrames.data() + (frame * channelCount + channel) * sampleSizeInBytes, swapInputEndianness));
+
+		const double* stageInput = input.data();
+		auto stageInputCapacityInFrames = maximumInputFrameCount;
+		auto frameCount = inputFrameCount;
+		for (auto& stage : stages) {
+			frameCount = ProcessStage(stage, stageInput, stageInputCapacityInFrames, frameCount, cpuFeatures);
+			stageInput = stage.output.data();
+			stageInputCapacityInFrames = stage.capacityInFrames;
+		}
+
+		for (size_t frame = 0; frame < frameCount; ++frame)
+			for (size_t channel = 0; channel < channelCount; ++channel)
+				StoreSample(output.data() + (frame * channelCount + channel) * sampleSizeInBytes, ClipToInt32(stageInput[channel * stageInputCapacityInFrames + frame]), swapOutputEndianness);
+		return std::span(output).first(frameCount * channelCount * sampleSizeInBytes);
+	}
+
+	template <size_t channelCount>
+	size_t Decimator<channelCount>::ProcessStage(Stage& stage, const double* const stageInput, const size_t inputCapacityInFrames, const size_t inputFrameCount, [[maybe_unused]] const CpuFeatures& cpuFeatures) {
+		const auto tapCount = stage.coefficients.size();
+		const size_t firstDenseFrame = stage.nextFrameIsOdd ? 1 : 0;
+		const auto denseFrameCount = (inputFrameCount + 1 - firstDenseFrame) / 2;
+		const auto centerFrameCount = inputFrameCount - denseFrameCount;
+		for (size_t channel = 0; channel < channelCount; ++channel) {
+			const auto inputRow = stageInput + channel * inputCapacityInFrames;
+			const auto row = channel * stage.capacityInFrames;
+			for (size_t frame = 0; frame < denseFrameCount; ++frame)
+				stage.dense[row + tapCount - 1 + frame] = inputRow[firstDenseFrame + 2 * frame];
+			for (size_t frame = 0; frame < centerFrameCount; ++frame)
+				stage.center[row + stage.centerFrameCount + frame] = inputRow[1 - firstDenseFrame + 2 * frame];
+		}
+
+		// Each dense frame completes an output frame.
+#ifdef ASIO401_RESAMPLER_X86
+		if (cpuFeatures.avx2) DecimateHalfBand<Kernel::AVX2, channelCount>(stage.coefficients.data(), tapCount, stage.dense.data(), stage.center.data(), stage.output.data(), stage.capacityInFrames, denseFrameCount);
+		else DecimateHalfBand<Kernel::SSE2, channelCount>(stage.coefficients.data(), tapCount, stage.dense.data(), stage.center.data(), stage.output.data(), stage.capacityInFrames, denseFrameCount);
+#else
+		DecimateHalfBand<Kernel::SCALAR, channelCount>(stage.coefficients.data(), tapCount, stage.dense.data(), stage.center.data(), stage.output.data(), stage.capacityInFrames, denseFrameCount);
+#endif
+
+		// Keep the frames that the next output frames will need at the beginning of each row.
+		const auto remainingCenterFrameCount = stage.centerFrameCount + centerFrameCount - denseFrameCount;
+		for (size_t channel = 0; channel < channelCount; ++channel) {
+			const auto dense = stage.dense.data() + channel * stage.capacityInFrames;
+			std::copy(dense + denseFrameCount, dense + denseFrameCount + tapCount - 1, dense);
+			const auto center = stage.center.data() + channel * stage.capacityInFrames;
+			std::copy(center + denseFrameCount, center + denseFrameCount + remainingCenterFrameCount, center);
+		}
+		stage.centerFrameCount = remainingCenterFrameCount;
+		stage.nextFrameIsOdd = stage.nextFrameIsOdd != (inputFrameCount % 2 == 1);
+
+		return denseFrameCount;
+	}
+
+	template <size_t channelCount>
+	void Decimator<channelCount>::Reset() {
+		for (auto& stage : stages) {
+			std::fill(stage.dense.begin(), stage.dense.end(), 0.0);
+			std::fill(stage.center.begin(), stage.center.end(), 0.0);
+			stage.centerFrameCount = stage.coefficients.size() / 2;
+			stage.nextFrameIsOdd = false;
+		}
+	}
+
+	template class Resampler<2>;
+	template class Decimator<2>;
+
+}
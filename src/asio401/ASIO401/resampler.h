@@ -0,0 +1,128 @@
+#pragma once
+
+#include "../ASIO401Util/cpu.h"
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace asio401 {
+
+	// Resampler and Decimator share the following conventions.
+	//
+	// Frames are interleaved, 32-bit integer samples, which are clipped on their way out. Computation is done in double precision. Filters are
+	// designed, and all memory is allocated, upfront when the object is constructed: `maximumInputFrameCount` is the largest number of frames that
+	// will be passed to a single Process() call. If `swapInputEndianness` (resp. `swapOutputEndianness`) is true, input (resp. output) samples use
+	// the opposite endianness from the platform.
+	//
+	// Process() consumes the input frames, and returns the output frames that could be computed as a result. The returned buffer is owned by the
+	// object, and is only valid until the next call. Reset() forgets all previous input, as if the object was just constructed.
+	//
+	// Filters are linear phase and causal: each output frame only depends on input frames that came before it. The resulting group delay is a fixed
+	// property of the filters, so it is known in advance, and is reported by GetResamplerDelayInOutputFrames() and GetDecimatorDelayInOutputFrames().
+
+	// Converts a stream of frames from one sample rate to another, using a polyphase FIR filter. The output sample rate is `upFactor / downFactor`
+	// times the input sample rate; the factors are expected to be in lowest terms (e.g. 160 and 147 for 44.1 kHz to 48 kHz).
+	//
+	// The filter is a Kaiser-windowed sinc. Its cutoff is at the Nyquist frequency of the lower of the two sample rates, and it reaches full stopband
+	// attenuation (about 140 dB) by the time aliases would fold back into the lowest 90% of that band (i.e. up to 20 kHz at 44.1 kHz).
+	//
+	// Output frames are produced as soon as the input frames they depend on are available. This has a useful property: if the resampler is fed
+	// input frames in blocks that each correspond to a whole number of output frames (i.e. a multiple of `downFactor` frames), then it outputs
+	// exactly that number of frames for each block, no matter how the blocks are split between calls.
+	template <size_t channelCount>
+	class Resampler final {
+	public:
+		Resampler(size_t upFactor, size_t downFactor, size_t maximumInputFrameCount, bool swapInputEndianness, bool swapOutputEndianness);
+
+		std::span<const std::byte> Process(std::span<const std::byte> input, const CpuFeatures& cpuFeatures = GetCpuFeatures());
+		void Reset();
+
+		size_t GetTapsPerPhase() const { return tapsPerPhase; }
+
+	private:
+		const size_t upFactor;
+		const size_t downFactor;
+		const size_t tapsPerPhase;
+		const bool swapInputEndianness;
+		const bool swapOutputEndianness;
+		// `upFactor` rows of `tapsPerPhase` coefficients, one row per phase. Rows are reversed, so that each row can be applied to input frames in
+		// chronological order.
+		const std::vector<double> coefficients;
+		// The input frames that the filter needs to look at: the last `tapsPerPhase - 1` frames from previous calls, followed by the frames from the
+		// current call. One row per channel (i.e. not interleaved), of `historyCapacityInFrames` frames each, so that filter windows are contiguous.
+		const size_t historyCapacityInFrames;
+		std::vector<double> history;
+		std::vector<std::byte> output;
+		// The position in `history` of the most recent input frame that the next output frame depends on, and the phase of that output frame.
+		size_t position;
+		size_t phase = 0;
+	};
+
+	// The number of coefficients in each phase of a Resampler with the given factors.
+	size_t GetResamplerTapsPerPhase(size_t upFactor, size_t downFactor);
+
+	// The group delay of a Resampler with the given factors, in output frames.
+	double GetResamplerDelayInOutputFrames(size_t upFactor, size_t downFactor);
+
+	// Decimates a stream of frames by a power of two (`2^stageCount`), using a cascade of half-band FIR filters, each of which halves the sample rate.
+	// This is much cheaper than a Resampler with the same ratio: about half the coefficients of a half-band filter are zero, and only the last stage,
+	// which runs at the lowest rate, needs a narrow transition band. Earlier stages only need to remove what would alias into the final passband.
+	//
+	// Filters are Kaiser-windowed sincs, designed to the same criteria as the Resampler filter: the final passband extends to 45.35% of the output
+	// Nyquist frequency, and everything that would alias into it is attenuated by about 140 dB. Samples stay in double precision between stages.
+	//
+	// Each stage outputs a frame as soon as it gets an even-numbered input frame. This means that, if the decimator is fed input frames in blocks of
+	// `2^stageCount` frames, then it outputs exactly one frame for each block, no matter how the blocks are split between calls.
+	template <size_t channelCount>
+	class Decimator final {
+	public:
+		Decimator(size_t stageCount, size_t maximumInputFrameCount, bool swapInputEndianness, bool swapOutputEndianness);
+
+		std::span<const std::byte> Process(std::span<const std::byte> inputFrames, const CpuFeatures& cpuFeatures = GetCpuFeatures());
+		void Reset();
+
+	private:
+		// A half-band filter has an odd number of taps. The center tap is 1/2, and every other tap from there is zero. The remaining taps, which
+		// are the only ones that need to be computed, all apply to input frames of the same parity. The input frames are therefore split into
+		// "dense" frames (the even-numbered ones, which the nonzero coefficients apply to) and "center" frames (the odd-numbered ones, each of which
+		// is only used once, by the center tap).
+		//
+		// All buffers hold one row per channel (i.e. not interleaved), of `capacityInFrames` frames each.
+		struct Stage {
+			// The nonzero coefficients, except for the center one. Their count is a multiple of 8 (see GetDecimatorTapCount()).
+			std::vector<double> coefficients;
+			size_t capacityInFrames;
+			// The last `coefficients.size() - 1` dense frames from previous calls, followed by the dense frames from the current call.
+			std::vector<double> dense;
+			// The center frames that have not been used yet: `centerFrameCount` frames, starting with the one the next output frame needs.
+			std::vector<double> center;
+			size_t centerFrameCount;
+			std::vector<double> output;
+			bool nextFrameIsOdd;
+		};
+
+		// Returns the number of frames written to `stage.output`.
+		size_t ProcessStage(Stage& stage, const double* stageInput, size_t inputCapacityInFrames, size_t inputFrameCount, const CpuFeatures& cpuFeatures);
+
+		const size_t maximumInputFrameCount;
+		const bool swapInputEndianness;
+		const bool swapOutputEndianness;
+		// The input frames, one row per channel, of `maximumInputFrameCount` frames each.
+		std::vector<double> input;
+		// First stage first, i.e. from the highest sample rate to the lowest.
+		std::vector<Stage> stages;
+		std::vector<std::byte> output;
+	};
+
+	// The number of nonzero coefficients (not counting the center one) in the half-band filter of the given stage of a Decimator. Stage 0 is the
+	// first stage.
+	size_t GetDecimatorTapCount(size_t stageCount, size_t stageIndex);
+
+	// The group delay of a Decimator with the given number of stages, in output frames.
+	double GetDecimatorDelayInOutputFrames(size_t stageCount);
+
+	extern template class Resampler<2>;
+	extern template class Decimator<2>;
+
+}
@@ -0,0 +1,78 @@
+#include "streaming_stats.h"
+
+#include "log.h"
+
+#include "../ASIO401Util/windows_error.h"
+
+#include <windows.h>
+
+#include <atomic>
+#include <cassert>
+#include <new>
+#include <stdexcept>
+
+namespace asio401 {
+
+	namespace {
+
+		// See StreamingStats::InstanceGuard.
+		std::atomic<bool> instanceExists = false;
+
+	}
+
+	std::unique_ptr<StreamingStats> StreamingStats::Create() {
+		try {
+			return std::make_unique<StreamingStats>();
+		}
+		catch (const std::exception& exception) {
+			Log() << "WARNING: unable to export streaming statistics: " << exception.what();
+			return nullptr;
+		}
+	}
+
+	StreamingStats::StreamingStats() :
+		fileMapping([&] {
+			const auto name = GetStreamingStatsSharedMemoryName(GetCurrentProcessId());
+			const auto fileMapping = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, DWORD(sizeof(StreamingStatsBlock)), name.c_str());
+			if (fileMapping == NULL) throw std::runtime_error("unable to create shared memory block: " + GetWindowsErrorString(GetLastError()));
+			// If the block already exists, it was created by a previous driver instance in this process, and a reader is still holding on to it.
+			// We take it over below.
+			if (GetLastError() == ERROR_ALREADY_EXISTS) Log() << "Taking over the streaming statistics shared memory block from a previous driver instance";
+			return WindowsHandleUniquePtr(fileMapping);
+		}()),
+		block([&] {
+			const auto view = MapViewOfFile(fileMapping.get(), FILE_MAP_WRITE, 0, 0, sizeof(StreamingStatsBlock));
+			if (view == NULL) throw std::runtime_error("unable to map shared memory block: " + GetWindowsErrorString(GetLastError()));
+			// A new block is zero-filled, so this also works for the first generation.
+			const auto previousBlock = static_cast<const StreamingStatsBlock*>(view);
+			const auto previousGeneration = previousBlock->magic == StreamingStatsBlock::expectedMagic ? previousBlock->generation.load(std::memory_order_relaxed) : 0;
+			const auto block = new (view) StreamingStatsBlock();
+			block->magic = StreamingStatsBlock::expectedMagic;
+			block->version = StreamingStatsBlock::currentVersion;
+			block->sizeInBytes = sizeof(StreamingStatsBlock);
+			block->generation.store(previousGeneration + 1, std::memory_order_release);
+			return std::unique_ptr<StreamingStatsBlock, UnmapViewOfFileDeleter>(block);
+		}()) {
+		Log() << "Exporting streaming statistics through shared memory for process ID " << GetCurrentProcessId() << ", generation " << block->generation.load(std::memory_order_relaxed);
+	}
+
+	StreamingStats::~StreamingStats() = default;
+
+	StreamingStats::InstanceGuard::InstanceGuard() {
+		// Another instance of the driver is already exporting statistics from this process; we would end up mixing them up.
+		if (instanceExists.exchange(true)) throw std::runtime_error("streaming statistics are already exported by another driver instance");
+	}
+
+	StreamingStats::InstanceGuard::~InstanceGuard() {
+		instanceExists.store(false);
+	}
+
+	void StreamingStats::UnmapViewOfFileDeleter::operator()(StreamingStatsBlock* block) {
+		// A reader might keep the block around after we are gone; make sure it doesn't look like a live stream.
+		block->running.store(0, std::memory_order_relaxed);
+		block->~StreamingStatsBlock();
+		const auto result = UnmapViewOfFile(block);
+		assert(result != 0);
+	}
+
+}
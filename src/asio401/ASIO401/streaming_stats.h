@@ -0,0 +1,45 @@
+#pragma once
+
+#include "streaming_stats_format.h"
+
+#include "../ASIO401Util/windows_handle.h"
+
+#include <memory>
+
+namespace asio401 {
+
+	// Exports live streaming statistics through a named shared memory block, so that they can be watched from another process (see ASIO401Stats)
+	// while the driver is running. See streaming_stats_format.h for the layout.
+	//
+	// Updating the statistics does not involve any locks or system calls: the block is updated in place, using atomic operations.
+	class StreamingStats final {
+	public:
+		// Returns nullptr if the shared memory block could not be created. Statistics are not essential, so this is logged but otherwise ignored.
+		static std::unique_ptr<StreamingStats> Create();
+
+		StreamingStats();
+		~StreamingStats();
+		StreamingStats(const StreamingStats&) = delete;
+		StreamingStats& operator=(const StreamingStats&) = delete;
+
+		StreamingStatsBlock& Get() { return *block; }
+
+	private:
+		struct UnmapViewOfFileDeleter final {
+			void operator()(StreamingStatsBlock*);
+		};
+
+		// The shared memory block is per process, so only one instance can use it at a time. This throws if another instance already exists.
+		struct InstanceGuard final {
+			InstanceGuard();
+			~InstanceGuard();
+			InstanceGuard(const InstanceGuard&) = delete;
+			InstanceGuard& operator=(const InstanceGuard&) = delete;
+		};
+
+		const InstanceGuard instanceGuard;
+		const WindowsHandleUniquePtr fileMapping;
+		const std::unique_ptr<StreamingStatsBlock, UnmapViewOfFileDeleter> block;
+	};
+
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <string>
+
+// The layout of the shared memory block through which the driver exports live streaming statistics (see streaming_stats.h). This is shared between
+// the driver and the reader (ASIO401Stats).
+//
+// The block is named after the ID of the process that the driver is loaded in; see GetStreamingStatsSharedMemoryName(). All fields after the header
+// are atomic, so that the reader can read them while the driver is updating them. Counters only ever go up, for as long as the driver is loaded; the
+// reader is expected to compute differences between successive reads. The layout is only ever extended at the end, and `version` is bumped whenever
+// that happens.
+//
+// The block outlives the driver instance that created it for as long as a reader keeps it mapped. If the driver is initialized again in the same
+// process in the meantime (e.g. after a reset request), the new instance takes over the existing block: it resets all fields, and increments
+// `generation`, so that the reader can tell that counters started over.
+
+namespace asio401 {
+
+	inline std::wstring GetStreamingStatsSharedMemoryName(uint32_t processId) {
+		return L"Local\\ASIO401Stats-" + std::to_wstring(processId);
+	}
+
+	// A histogram of durations, with logarithmic buckets. Bucket 0 counts durations under 1 microsecond. Bucket N counts durations in
+	// [2^(N-1), 2^N) microseconds. The last bucket also counts all larger durations.
+	struct StreamingStatsHistogram final {
+		static constexpr size_t bucketCount = 24;
+
+		static size_t GetBucketIndex(int64_t nanoseconds) {
+			if (nanoseconds < 0) return 0;
+			return (std::min)(size_t(std::bit_width(uint64_t(nanoseconds) / 1000)), bucketCount - 1);
+		}
+		// The lowest duration that the bucket counts, in microseconds.
+		static uint64_t GetBucketFloorMicroseconds(size_t bucketIndex) { return bucketIndex == 0 ? 0 : uint64_t(1) << (bucketIndex - 1); }
+
+		void Record(int64_t nanoseconds) {
+			buckets[GetBucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+			count.fetch_add(1, std::memory_order_relaxed);
+			sumNanoseconds.fetch_add(uint64_t((std::max)(nanoseconds, int64_t(0))), std::memory_order_relaxed);
+			auto currentMaximum = maximumNanoseconds.load(std::memory_order_relaxed);
+			while (nanoseconds > currentMaximum && !maximumNanoseconds.compare_exchange_weak(currentMaximum, nanoseconds, std::memory_order_relaxed));
+		}
+
+		std::array<std::atomic<uint64_t>, bucketCount> buckets;
+		std::atomic<uint64_t> count;
+		std::atomic<uint64_t> sumNanoseconds;
+		std::atomic<int64_t> maximumNanoseconds;
+	};
+
+	struct StreamingStatsBlock final {
+		static constexpr std::array<char, 8> expectedMagic = { 'A', 'S', 'I', 'O', '4', '0', '1', 'S' };
+		static constexpr uint32_t currentVersion = 1;
+
+		// Header; constant after initialization.
+		std::array<char, 8> magic;
+		uint32_t version;
+		uint32_t sizeInBytes;
+		// Incremented every time a driver instance (re)initializes the block. Written last, with release semantics.
+		std::atomic<uint64_t> generation;
+
+		// Current state. The configuration fields describe the current (or last) stream.
+		std::atomic<uint64_t> running;
+		std::atomic<uint64_t> sampleRate;
+		std::atomic<uint64_t> bufferSizeInFrames;
+		// Number of transfers that have been started and not completed yet, including the prefix transfers.
+		std::atomic<int64_t> inflightWrites;
+		std::atomic<int64_t> inflightReads;
+
+		// Counters.
+		std::atomic<uint64_t> streamCount;
+		std::atomic<uint64_t> writeCount;
+		std::atomic<uint64_t> readCount;
+		std::atomic<uint64_t> bufferSwitchCount;
+		// bufferSwitch() calls that took longer than the duration of an ASIO buffer. If that happens repeatedly, the stream will eventually glitch.
+		std::atomic<uint64_t> missedDeadlineCount;
+		std::atomic<uint64_t> resetRequestCount;
+		// Discontinuities in the stream, i.e. frames that were lost or repeated because the streaming thread fell behind. See ClockEstimator.
+		std::atomic<uint64_t> discontinuityCount;
+		std::atomic<uint64_t> lostFrameCount;
+		std::atomic<uint64_t> repeatedFrameCount;
+		// In-place recoveries from streaming errors. See RunThread().
+		std::atomic<uint64_t> recoveryCount;
+
+		// Histograms. Transfer latencies are measured from the time the transfer is started to the time the streaming thread observes its completion.
+		// Transfers that are started before the stream is primed are not included, as they include the time it takes for the hardware to start.
+		StreamingStatsHistogram writeLatency;
+		StreamingStatsHistogram readLatency;
+		StreamingStatsHistogram bufferSwitchDuration;
+		// Time between the completion of a read and the start of the next read in the same I/O slot. During that time, one less read is in flight.
+		StreamingStatsHistogram readTurnaround;
+		// How late the completions used for timing (reads, or writes if there are no inputs) were observed, compared to when the clock estimator
+		// expected them. Early completions are counted in bucket 0.
+		StreamingStatsHistogram completionLateness;
+		// Time from a streaming error to the point where streaming resumed after an in-place recovery.
+		StreamingStatsHistogram recoveryDuration;
+	};
+
+}
@@ -0,0 +1,151 @@
+#include "trace.h"
+
+#include "log.h"
+
+#include "../ASIO401Util/shell.h"
+
+#include <windows.h>
+
+#include <stdexcept>
+
+namespace asio401 {
+
+	namespace {
+
+		std::atomic<uint64_t> nextTracerId = 1;
+
+	}
+
+	std::unique_ptr<Tracer> Tracer::Open(const HighResolutionClock& clock) {
+		const auto userDirectory = GetUserDirectory();
+		if (!userDirectory.has_value()) return nullptr;
+
+		std::filesystem::path path(*userDirectory);
+		path.append("ASIO401.trace");
+
+		if (!std::filesystem::exists(path)) return nullptr;
+
+		try {
+			return std::make_unique<Tracer>(path, clock);
+		}
+		catch (const std::exception& exception) {
+			Log() << "WARNING: unable to open trace file, proceeding without tracing: " << exception.what();
+			return nullptr;
+		}
+	}
+
+	Tracer::Tracer(const std::filesystem::path& path, const HighResolutionClock& clock) :
+		clock(clock), id(nextTracerId.fetch_add(1, std::memory_order_relaxed)) {
+		const auto isNewFile = std::filesystem::file_size(path) == 0;
+		file.open(path, std::ios::binary | std::ios::app);
+		if (!file) throw std::runtime_error("unable to open trace file for writing");
+		if (isNewFile) {
+			const TraceFileHeader header = {
+				.magic = TraceFileHeader::expectedMagic,
+				.version = TraceFileHeader::currentVersion,
+				.recordSizeInBytes = sizeof(TraceRecord),
+			};
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		}
+		flushThread = std::thread([this] { RunFlushThread(); });
+		Log() << "Tracing enabled, tracer ID " << id;
+	}
+
+	Tracer::~Tracer() {
+		{
+			std::scoped_lock lock(flushThreadMutex);
+			stopRequested = true;
+		}
+		flushThreadStopRequested.notify_all();
+		flushThread.join();
+		Flush();
+		Log() << "Trace flushed";
+	}
+
+	Tracer::ThreadBuffer::ThreadBuffer(uint32_t threadId) : threadId(threadId), records(std::make_unique<TraceRecord[]>(threadBufferCapacityInRecords)) {}
+
+	void Tracer::Record(TraceEvent event, int64_t arg0, int64_t arg1) noexcept {
+		const auto threadBuffer = GetThreadBuffer();
+		if (threadBuffer == nullptr) return;
+
+		const auto writeCount = threadBuffer->writeCount.load(std::memory_order_relaxed);
+		if (writeCount - threadBuffer->readCount.load(std::memory_order_acquire) >= threadBufferCapacityInRecords) {
+			threadBuffer->droppedCount.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		threadBuffer->records[writeCount % threadBufferCapacityInRecords] = {
+			.timeNanoseconds = clock.GetTimeNanoseconds(),
+			.threadId = threadBuffer->threadId,
+			.event = event,
+			.reserved = 0,
+			.arg0 = arg0,
+			.arg1 = arg1,
+		};
+		threadBuffer->writeCount.store(writeCount + 1, std::memory_order_release);
+	}
+
+	Tracer::ThreadBuffer* Tracer::GetThreadBuffer() noexcept {
+		struct Cache final {
+			uint64_t tracerId = 0;
+			ThreadBuffer* threadBuffer = nullptr;
+		};
+		static thread_local Cache cache;
+		if (cache.tracerId == id) return cache.threadBuffer;
+
+		cache = { .tracerId = id, .threadBuffer = nullptr };
+		std::scoped_lock lock(threadBuffersMutex);
+		if (threadBuffers.size() >= maxThreadBufferCount) return nullptr;
+		try {
+			threadBuffers.push_back(std::make_unique<ThreadBuffer>(uint32_t(::GetCurrentThreadId())));
+		}
+		catch (...) {
+			return nullptr;
+		}
+		cache.threadBuffer = threadBuffers.back().get();
+		return cache.threadBuffer;
+	}
+
+	void Tracer::RunFlushThread() {
+		std::unique_lock lock(flushThreadMutex);
+		while (!flushThreadStopRequested.wait_for(lock, flushPeriod, [&] { return stopRequested; })) {
+			lock.unlock();
+			Flush();
+			lock.lock();
+		}
+	}
+
+	void Tracer::Flush() {
+		std::vector<ThreadBuffer*> threadBuffersSnapshot;
+		{
+			std::scoped_lock lock(threadBuffersMutex);
+			for (const auto& threadBuffer : threadBuffers) threadBuffersSnapshot.push_back(threadBuffer.get());
+		}
+
+		for (const auto threadBuffer : threadBuffersSnapshot) {
+			const auto readCount = threadBuffer->readCount.load(std::memory_order_relaxed);
+			const auto writeCount = threadBuffer->writeCount.load(std::memory_order_acquire);
+			for (auto position = readCount; position < writeCount; ) {
+				const auto offset = position % threadBufferCapacityInRecords;
+				const auto count = (std::min)(writeCount - position, threadBufferCapacityInRecords - offset);
+				file.write(reinterpret_cast<const char*>(&threadBuffer->records[offset]), std::streamsize(count * sizeof(TraceRecord)));
+				position += count;
+			}
+			threadBuffer->readCount.store(writeCount, std::memory_order_release);
+
+			const auto droppedCount = threadBuffer->droppedCount.exchange(0, std::memory_order_relaxed);
+			if (droppedCount > 0) {
+				const TraceRecord record = {
+					.timeNanoseconds = clock.GetTimeNanoseconds(),
+					.threadId = threadBuffer->threadId,
+					.event = TraceEvent::RECORDS_DROPPED,
+					.reserved = 0,
+					.arg0 = int64_t(droppedCount),
+					.arg1 = 0,
+				};
+				file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+			}
+		}
+		file.flush();
+	}
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "trace_format.h"
+
+#include "../ASIO401Util/clock.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace asio401 {
+
+	// Records a binary trace of timing-sensitive events into ASIO401.trace. See trace_format.h for the file format, and ASIO401Trace for the decoder.
+	//
+	// Record() is cheap enough to be called from the streaming thread on every transfer: it does not take any locks, make any system calls (beyond
+	// reading the performance counter), or allocate any memory, except on the first call from a given thread. Each thread records into its own
+	// fixed-size buffer, which a background thread periodically flushes to the file. If a buffer fills up, records are dropped and the number of
+	// dropped records is written to the trace.
+	class Tracer final {
+	public:
+		// Returns nullptr if tracing is not enabled, i.e. if there is no ASIO401.trace file in the user directory.
+		static std::unique_ptr<Tracer> Open(const HighResolutionClock& clock);
+
+		Tracer(const std::filesystem::path& path, const HighResolutionClock& clock);
+		// Flushes all records.
+		~Tracer();
+		Tracer(const Tracer&) = delete;
+		Tracer& operator=(const Tracer&) = delete;
+
+		void Record(TraceEvent event, int64_t arg0 = 0, int64_t arg1 = 0) noexcept;
+
+	private:
+		static constexpr size_t threadBufferCapacityInRecords = 32768;
+		// Beyond this, threads don't get a buffer and their records are ignored. This bounds memory usage in case the ASIO Host Application calls us
+		// from many different threads.
+		static constexpr size_t maxThreadBufferCount = 16;
+		static constexpr auto flushPeriod = std::chrono::milliseconds(100);
+
+		struct ThreadBuffer final {
+			explicit ThreadBuffer(uint32_t threadId);
+
+			const uint32_t threadId;
+			const std::unique_ptr<TraceRecord[]> records;
+			// Counts of records written by the thread, and read by the flush thread, since the creation of the buffer.
+			alignas(64) std::atomic<uint64_t> writeCount = 0;
+			std::atomic<uint64_t> droppedCount = 0;
+			alignas(64) std::atomic<uint64_t> readCount = 0;
+		};
+
+		ThreadBuffer* GetThreadBuffer() noexcept;
+		void RunFlushThread();
+		void Flush();
+
+		const HighResolutionClock& clock;
+		// Identifies this tracer in the per-thread buffer cache. Addresses can't be used for that, as they can be reused by a subsequent tracer.
+		const uint64_t id;
+		// Only accessed by the flush thread, or after it exits.
+		std::ofstream file;
+
+		std::mutex threadBuffersMutex;
+		std::vector<std::unique_ptr<ThreadBuffer>> threadBuffers;
+
+		std::mutex flushThreadMutex;
+		std::condition_variable flushThreadStopRequested;
+		bool stopRequested = false;
+		std::thread flushThread;
+	};
+
+}
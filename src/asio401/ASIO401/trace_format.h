@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+// The format of ASIO401.trace files, shared between the driver (see trace.h) and the decoder (ASIO401Trace).
+//
+// A trace file starts with a TraceFileHeader, followed by TraceRecords. The driver only ever appends to the file, so a file can hold many streaming
+// sessions, each of which starts with a SESSION_BEGIN record. Records are not sorted by time, as they are flushed from per-thread buffers; within a
+// given thread, they are in chronological order.
+
+namespace asio401 {
+
+	enum class TraceEvent : uint16_t {
+		// Recorded when ASIO buffers are created. arg0: ASIO buffer size in frames, arg1: number of I/O slots per direction.
+		SESSION_BEGIN = 1,
+		// arg0: number of records that this thread could not record because its trace buffer was full.
+		RECORDS_DROPPED = 2,
+
+		// Streaming thread. arg0: sample rate in Hz.
+		STREAM_START = 10,
+		STREAM_STOP = 11,
+		// Streaming thread. arg0: number of writes that were withheld during priming and are about to be started.
+		PRIMED = 12,
+		// Streaming thread. arg0: number of frames that were lost (if positive) or repeated (if negative). See ClockEstimator.
+		DISCONTINUITY = 13,
+		// Streaming thread. Recorded when the thread starts recovering from an error. arg0: number of recoveries in the current window, including this one.
+		RECOVERY_BEGIN = 14,
+		// Streaming thread. Recorded when streaming resumes after a recovery.
+		RECOVERY_END = 15,
+
+		// Streaming thread. arg0: transfer index (-1 for the prefix transfer), arg1: I/O slot index (-1 for the prefix transfer).
+		WRITE_START = 20,
+		WRITE_COMPLETE = 21,
+		READ_START = 22,
+		READ_COMPLETE = 23,
+
+		// Thread that calls the ASIO Host Application. arg0: ASIO buffer index, arg1: sample position.
+		BUFFER_SWITCH_BEGIN = 30,
+		BUFFER_SWITCH_END = 31,
+		// Thread that the ASIO Host Application called OutputReady() from.
+		OUTPUT_READY = 32,
+	};
+
+	inline std::optional<std::string_view> GetTraceEventName(TraceEvent event) {
+		switch (event) {
+		case TraceEvent::SESSION_BEGIN: return "SESSION_BEGIN";
+		case TraceEvent::RECORDS_DROPPED: return "RECORDS_DROPPED";
+		case TraceEvent::STREAM_START: return "STREAM_START";
+		case TraceEvent::STREAM_STOP: return "STREAM_STOP";
+		case TraceEvent::PRIMED: return "PRIMED";
+		case TraceEvent::DISCONTINUITY: return "DISCONTINUITY";
+		case TraceEvent::RECOVERY_BEGIN: return "RECOVERY_BEGIN";
+		case TraceEvent::RECOVERY_END: return "RECOVERY_END";
+		case TraceEvent::WRITE_START: return "WRITE_START";
+		case TraceEvent::WRITE_COMPLETE: return "WRITE_COMPLETE";
+		case TraceEvent::READ_START: return "READ_START";
+		case TraceEvent::READ_COMPLETE: return "READ_COMPLETE";
+		case TraceEvent::BUFFER_SWITCH_BEGIN: return "BUFFER_SWITCH_BEGIN";
+		case TraceEvent::BUFFER_SWITCH_END: return "BUFFER_SWITCH_END";
+		case TraceEvent::OUTPUT_READY: return "OUTPUT_READY";
+		}
+		return std::nullopt;
+	}
+
+	struct TraceFileHeader final {
+		static constexpr std::array<char, 8> expectedMagic = { 'A', 'S', 'I', 'O', '4', '0', '1', 'T' };
+		static constexpr uint32_t currentVersion = 1;
+
+		std::array<char, 8> magic;
+		uint32_t version;
+		uint32_t recordSizeInBytes;
+	};
+	static_assert(sizeof(TraceFileHeader) == 16);
+
+	struct TraceRecord final {
+		// Same time base as ASIO timestamps. See HighResolutionClock.
+		int64_t timeNanoseconds;
+		uint32_t threadId;
+		TraceEvent event;
+		uint16_t reserved;
+		int64_t arg0;
+		int64_t arg1;
+	};
+	static_assert(sizeof(TraceRecord) == 32);
+
+}
@@ -0,0 +1,796 @@
+#include "../ASIO401/clock_estimator.h"
+#include "../ASIO401/conversion.h"
+#include "../ASIO401/resampler.h"
+#include "../ASIO401Util/atomic_event.h"
+#include "../ASIO401Util/cpu.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace asio401 {
+	namespace {
+
+		constexpr size_t channelCount = 2;
+		constexpr size_t sampleSizeInBytes = sizeof(int32_t);
+		constexpr std::array<size_t, 4> frameCounts = { 64, 1024, 8192, 32768 };
+
+		// Returns the best (i.e. least disturbed by the rest of the system) average time per call, in nanoseconds.
+		template <typename Functor>
+		double Measure(Functor functor) {
+			using Clock = std::chrono::steady_clock;
+			constexpr int runs = 5;
+			constexpr int callsPerClockRead = 16;
+			double best = (std::numeric_limits<double>::max)();
+			for (int run = 0; run < runs; ++run) {
+				size_t calls = 0;
+				const auto start = Clock::now();
+				auto end = start;
+				do {
+					for (int call = 0; call < callsPerClockRead; ++call) functor();
+					calls += callsPerClockRead;
+					end = Clock::now();
+				} while (end - start < std::chrono::milliseconds(20));
+				best = (std::min)(best, std::chrono::duration<double, std::nano>(end - start).count() / calls);
+			}
+			return best;
+		}
+
+		// Number of checks that failed so far. Any failure makes the program exit with a non-zero status, so that it can be used as a test.
+		size_t failureCount = 0;
+
+		void Report(std::string_view name, size_t frameCount, double referenceNanoseconds, double optimizedNanoseconds, bool resultsMatch) {
+			std::cout << std::left << std::setw(72) << name << std::right << std::setw(8) << frameCount << " frames: "
+				<< std::fixed << std::setprecision(0) << std::setw(10) << referenceNanoseconds << " ns -> "
+				<< std::setw(10) << optimizedNanoseconds << " ns ("
+				<< std::setprecision(1) << referenceNanoseconds / optimizedNanoseconds << "x)"
+				<< (resultsMatch ? "" : " RESULTS DO NOT MATCH") << std::endl;
+			if (!resultsMatch) ++failureCount;
+		}
+
+		// Runs `reference` and `optimized` once each, starting from the same state, checks their results with `resultsMatch`, then times both.
+		// Returns the time taken by `optimized`, so that it can also be compared against a baseline that doesn't produce the same results.
+		template <typename Reference, typename Optimized, typename ResultsMatch>
+		double CompareKernels(std::string_view name, size_t frameCount, Reference reference, Optimized optimized, ResultsMatch resultsMatch) {
+			reference();
+			optimized();
+			const bool resultsMatched = resultsMatch();
+			const auto optimizedNanoseconds = Measure(optimized);
+			Report(name, frameCount, Measure(reference), optimizedNanoseconds, resultsMatched);
+			return optimizedNanoseconds;
+		}
+
+		template <typename Baseline>
+		void CompareBaseline(std::string_view name, size_t frameCount, Baseline baseline, double optimizedNanoseconds) {
+			Report(name, frameCount, Measure(baseline), optimizedNanoseconds, true);
+		}
+
+		std::vector<std::byte> MakeTestSignal(size_t sizeInBytes) {
+			std::vector<std::byte> signal(sizeInBytes);
+			for (size_t index = 0; index < signal.size(); ++index) signal[index] = std::byte(index * 7 + 3);
+			// Make sure the polarity inversion edge case is exercised.
+			if (sizeInBytes >= sampleSizeInBytes) {
+				const auto mostNegative = (std::numeric_limits<int32_t>::min)();
+				memcpy(signal.data(), &mostNegative, sampleSizeInBytes);
+			}
+			return signal;
+		}
+
+		// The separate passes that ASIO401 used before it gained fused conversion kernels. Note these modify the ASIO buffers in place.
+
+		void ReferenceInvertPolarity(std::byte* const buffer, const size_t frameCount) {
+			const auto samples = reinterpret_cast<int32_t*>(buffer);
+			std::replace(samples, samples + frameCount, (std::numeric_limits<int32_t>::min)(), (std::numeric_limits<int32_t>::min)() + 1);
+			std::transform(samples, samples + frameCount, samples, std::negate());
+		}
+
+		void ReferenceSwapEndianness(std::byte* buffer, const size_t frameCount) {
+			for (size_t frame = 0; frame < frameCount; ++frame) {
+				std::swap(buffer[0], buffer[3]);
+				std::swap(buffer[1], buffer[2]);
+				buffer += sampleSizeInBytes;
+			}
+		}
+
+		void ReferenceInterleave(const std::array<std::byte*, channelCount>& sources, std::byte* destination, size_t frameCount, const SampleTransform<channelCount>& transform) {
+			for (size_t slot = 0; slot < channelCount; ++slot) {
+				if (sources[slot] == nullptr) continue;
+				if (transform.invertPolarity[slot]) ReferenceInvertPolarity(sources[slot], frameCount);
+				if (transform.swapEndianness) ReferenceSwapEndianness(sources[slot], frameCount);
+			}
+			for (size_t slot = 0; slot < channelCount; ++slot) {
+				if (sources[slot] == nullptr) continue;
+				for (size_t frame = 0; frame < frameCount; ++frame)
+					memcpy(destination + (channelCount * frame + slot) * sampleSizeInBytes, sources[slot] + frame * sampleSizeInBytes, sampleSizeInBytes);
+			}
+		}
+
+		void ReferenceDeinterleave(const std::byte* source, const std::array<std::byte*, channelCount>& destinations, size_t frameCount, const SampleTransform<channelCount>& transform) {
+			for (size_t slot = 0; slot < channelCount; ++slot) {
+				if (destinations[slot] == nullptr) continue;
+				for (size_t frame = 0; frame < frameCount; ++frame)
+					memcpy(destinations[slot] + frame * sampleSizeInBytes, source + (channelCount * frame + slot) * sampleSizeInBytes, sampleSizeInBytes);
+			}
+			for (size_t slot = 0; slot < channelCount; ++slot) {
+				if (destinations[slot] == nullptr) continue;
+				if (transform.swapEndianness) ReferenceSwapEndianness(destinations[slot], frameCount);
+				if (transform.invertPolarity[slot]) ReferenceInvertPolarity(destinations[slot], frameCount);
+			}
+		}
+
+		struct ConversionCase {
+			std::string_view name;
+			std::array<bool, channelCount> useSlot;
+			SampleTransform<channelCount> transform;
+		};
+
+		// These mirror what ASIO401 does for each device, with the ASIO channel to slot mapping taken into account.
+		constexpr std::array<ConversionCase, 3> outputCases = { {
+			{ "Output, no conversion (QA403)", { true, true }, { false, { false, false } } },
+			{ "Output, one channel (QA403)", { false, true }, { false, { false, false } } },
+			{ "Output, full conversion (QA401)", { true, true }, { true, { true, true } } },
+		} };
+		constexpr std::array<ConversionCase, 3> inputCases = { {
+			{ "Input, polarity only (QA403)", { true, true }, { false, { false, true } } },
+			{ "Input, one channel (QA403)", { true, false }, { false, { false, true } } },
+			{ "Input, full conversion (QA401)", { true, true }, { true, { true, false } } },
+		} };
+
+		std::array<std::vector<std::byte>, channelCount> MakeChannelBuffers(size_t frameCount) {
+			std::array<std::vector<std::byte>, channelCount> channelBuffers;
+			for (auto& channelBuffer : channelBuffers) channelBuffer = MakeTestSignal(frameCount * sampleSizeInBytes);
+			return channelBuffers;
+		}
+
+		template <typename Pointer>
+		std::array<Pointer, channelCount> GetChannelPointers(std::array<std::vector<std::byte>, channelCount>& channelBuffers, const std::array<bool, channelCount>& useSlot) {
+			std::array<Pointer, channelCount> pointers;
+			for (size_t slot = 0; slot < channelCount; ++slot) pointers[slot] = useSlot[slot] ? channelBuffers[slot].data() : nullptr;
+			return pointers;
+		}
+
+		void BenchmarkInterleave(std::string_view name, const ConversionCase& conversionCase, size_t frameCount, const CpuFeatures& cpuFeatures = GetCpuFeatures()) {
+			std::vector<std::byte> referenceResult(frameCount * channelCount * sampleSizeInBytes);
+			std::vector<std::byte> optimizedResult(referenceResult.size());
+
+			auto referenceChannelBuffers = MakeChannelBuffers(frameCount);
+			const auto referenceSources = GetChannelPointers<std::byte*>(referenceChannelBuffers, conversionCase.useSlot);
+			auto optimizedChannelBuffers = MakeChannelBuffers(frameCount);
+			const auto optimizedSources = GetChannelPointers<const std::byte*>(optimizedChannelBuffers, conversionCase.useSlot);
+
+			CompareKernels(name, frameCount,
+				[&] { ReferenceInterleave(referenceSources, referenceResult.data(), frameCount, conversionCase.transform); },
+				[&] { Interleave(optimizedSources, optimizedResult.data(), frameCount, conversionCase.transform, cpuFeatures); },
+				[&] { return referenceResult == optimizedResult && optimizedChannelBuffers == MakeChannelBuffers(frameCount); });
+		}
+
+		void BenchmarkDeinterleave(std::string_view name, const ConversionCase& conversionCase, size_t frameCount, const CpuFeatures& cpuFeatures = GetCpuFeatures()) {
+			const auto interleaved = MakeTestSignal(frameCount * channelCount * sampleSizeInBytes);
+			auto referenceResult = MakeChannelBuffers(frameCount);
+			const auto referenceDestinations = GetChannelPointers<std::byte*>(referenceResult, conversionCase.useSlot);
+			auto optimizedResult = MakeChannelBuffers(frameCount);
+			const auto optimizedDestinations = GetChannelPointers<std::byte*>(optimizedResult, conversionCase.useSlot);
+
+			CompareKernels(name, frameCount,
+				[&] { ReferenceDeinterleave(interleaved.data(), referenceDestinations, frameCount, conversionCase.transform); },
+				[&] { Deinterleave(interleaved.data(), optimizedDestinations, frameCount, conversionCase.transform, cpuFeatures); },
+				[&] { return referenceResult == optimizedResult; });
+		}
+
+		void BenchmarkConversion() {
+			for (const auto frameCount : frameCounts) {
+				for (const auto& outputCase : outputCases) BenchmarkInterleave(outputCase.name, outputCase, frameCount);
+				for (const auto& inputCase : inputCases) BenchmarkDeinterleave(inputCase.name, inputCase, frameCount);
+			}
+		}
+
+		struct InstructionSet {
+			std::string_view name;
+			CpuFeatures cpuFeatures;
+		};
+
+		std::vector<InstructionSet> GetSupportedInstructionSets() {
+			const auto& cpuFeatures = GetCpuFeatures();
+			std::vector<InstructionSet> instructionSets = { { "SSE2", {} } };
+			if (cpuFeatures.ssse3) instructionSets.push_back({ "SSSE3", { .ssse3 = true } });
+			if (cpuFeatures.avx2) instructionSets.push_back({ "AVX2", { .ssse3 = true, .avx2 = true } });
+			return instructionSets;
+		}
+
+		// The QA401 is the only big-endian device, so it is the one that pays for endianness swapping.
+		// This runs the QA401 conversions at the buffer sizes that are typically used with that device, with every supported kernel.
+		void BenchmarkQA401Conversion() {
+			const auto& outputCase = outputCases.back();
+			const auto& inputCase = inputCases.back();
+			const auto instructionSets = GetSupportedInstructionSets();
+			for (const size_t sampleRate : { 48000, 192000 }) {
+				for (const size_t bufferSizeAt48kHz : { 256, 512, 1024 }) {
+					const auto frameCount = bufferSizeAt48kHz * sampleRate / 48000;
+					std::cout << std::endl << sampleRate / 1000 << " kHz, " << frameCount << " frames (buffer period: "
+						<< std::fixed << std::setprecision(2) << frameCount * 1000.0 / sampleRate << " ms)" << std::endl;
+					for (const auto& instructionSet : instructionSets) {
+						BenchmarkInterleave(std::string(outputCase.name) + ", " + std::string(instructionSet.name), outputCase, frameCount, instructionSet.cpuFeatures);
+						BenchmarkDeinterleave(std::string(inputCase.name) + ", " + std::string(instructionSet.name), inputCase, frameCount, instructionSet.cpuFeatures);
+					}
+				}
+			}
+		}
+
+		// Conversions between 32-bit integer samples and other ASIO sample types, done the way ASIO Host Applications have to do them when the driver
+		// only offers Int32 samples: a separate scalar pass over each channel. Polarity is inverted in the host sample type domain, as the fused kernels do.
+		template <HostSampleType hostSampleType>
+		struct ReferenceHostSample;
+
+		template <>
+		struct ReferenceHostSample<HostSampleType::INT24> {
+			static constexpr size_t sizeInBytes = 3;
+			// Packed 24-bit samples are the upper 3 bytes of a little-endian 32-bit sample.
+			static constexpr size_t offsetInBytes = 1;
+
+			static std::vector<std::byte> MakeTestSignal(size_t frameCount) {
+				return ::asio401::MakeTestSignal(frameCount * sizeInBytes);
+			}
+
+			static void ToInt32(const std::byte* const source, std::byte* const destination, const size_t frameCount, const bool invertPolarity) {
+				for (size_t frame = 0; frame < frameCount; ++frame) {
+					int32_t value = 0;
+					memcpy(reinterpret_cast<std::byte*>(&value) + offsetInBytes, source + frame * sizeInBytes, sizeInBytes);
+					if (invertPolarity) ReferenceInvertPolarity(reinterpret_cast<std::byte*>(&value), 1);
+					memcpy(destination + frame * sampleSizeInBytes, &value, sampleSizeInBytes);
+				}
+			}
+
+			static void FromInt32(const std::byte* const source, std::byte* const destination, const size_t frameCount, const bool invertPolarity) {
+				for (size_t frame = 0; frame < frameCount; ++frame) {
+					int32_t value;
+					memcpy(&value, source + frame * sampleSizeInBytes, sampleSizeInBytes);
+					if (invertPolarity) ReferenceInvertPolarity(reinterpret_cast<std::byte*>(&value), 1);
+					memcpy(destination + frame * sizeInBytes, reinterpret_cast<const std::byte*>(&value) + offsetInBytes, sizeInBytes);
+				}
+			}
+		};
+
+		template <typename Float>
+		struct ReferenceFloatHostSample {
+			static constexpr size_t sizeInBytes = sizeof(Float);
+
+			// A sine wave that slightly exceeds full scale, so that clipping is exercised.
+			static std::vector<std::byte> MakeTestSignal(size_t frameCount) {
+				std::vector<std::byte> signal(frameCount * sizeInBytes);
+				for (size_t frame = 0; frame < frameCount; ++frame) {
+					const auto sample = Float(std::sin(double(frame) * 0.01) * 1.1);
+					memcpy(signal.data() + frame * sizeInBytes, &sample, sizeInBytes);
+				}
+				return signal;
+			}
+
+			static void ToInt32(const std::byte* const source, std::byte* const destination, const size_t frameCount, const bool invertPolarity) {
+				constexpr auto highest = std::is_same_v<Float, float> ? Float(2147483520.0) : Float(2147483647.0);
+				for (size_t frame = 0; frame < frameCount; ++frame) {
+					Float sample;
+					memcpy(&sample, source + frame * sizeInBytes, sizeInBytes);
+					sample *= Float(2147483648.0);
+					if (invertPolarity) sample = -sample;
+					const auto value = int32_t(std::lrint(std::clamp(sample, Float(-2147483648.0), highest)));
+					memcpy(destination + frame * sampleSizeInBytes, &value, sampleSizeInBytes);
+				}
+			}
+
+			static void FromInt32(const std::byte* const source, std::byte* const destination, const size_t frameCount, const bool invertPolarity) {
+				for (size_t frame = 0; frame < frameCount; ++frame) {
+					int32_t value;
+					memcpy(&value, source + frame * sampleSizeInBytes, sampleSizeInBytes);
+					auto sample = Float(value) / Float(2147483648.0);
+					if (invertPolarity) sample = -sample;
+					memcpy(destination + frame * sizeInBytes, &sample, sizeInBytes);
+				}
+			}
+		};
+
+		template <>
+		struct ReferenceHostSample<HostSampleType::FLOAT32> : ReferenceFloatHostSample<float> {};
+		template <>
+		struct ReferenceHostSample<HostSampleType::FLOAT64> : ReferenceFloatHostSample<double> {};
+
+		// The reference is a separate conversion pass followed by the Int32 kernel; the baseline is the Int32 kernel alone.
+		template <HostSampleType hostSampleType>
+		void BenchmarkHostSampleTypeInterleave(std::string_view name, const ConversionCase& conversionCase, size_t frameCount) {
+			using Reference = ReferenceHostSample<hostSampleType>;
+			std::array<std::vector<std::byte>, channelCount> hostChannelBuffers;
+			for (auto& hostChannelBuffer : hostChannelBuffers) hostChannelBuffer = Reference::MakeTestSignal(frameCount);
+			const auto hostSources = GetChannelPointers<const std::byte*>(hostChannelBuffers, conversionCase.useSlot);
+			auto int32ChannelBuffers = MakeChannelBuffers(frameCount);
+			const auto int32Sources = GetChannelPointers<const std::byte*>(int32ChannelBuffers, conversionCase.useSlot);
+			std::vector<std::byte> referenceResult(frameCount * channelCount * sampleSizeInBytes);
+			std::vector<std::byte> optimizedResult(referenceResult.size());
+
+			const SampleTransform<channelCount> int32Transform = { .swapEndianness = conversionCase.transform.swapEndianness };
+			auto hostTransform = conversionCase.transform;
+			hostTransform.hostSampleType = hostSampleType;
+			const auto reference = [&] {
+				for (size_t slot = 0; slot < channelCount; ++slot)
+					if (hostSources[slot] != nullptr) Reference::ToInt32(hostSources[slot], int32ChannelBuffers[slot].data(), frameCount, conversionCase.transform.invertPolarity[slot]);
+				Interleave(int32Sources, referenceResult.data(), frameCount, int32Transform);
+			};
+			const auto optimizedNanoseconds = CompareKernels(name, frameCount, reference, [&] { Interleave(hostSources, optimizedResult.data(), frameCount, hostTransform); }, [&] { return referenceResult == optimizedResult; });
+			CompareBaseline(std::string(name) + " vs Int32", frameCount, [&] { Interleave(int32Sources, referenceResult.data(), frameCount, conversionCase.transform); }, optimizedNanoseconds);
+		}
+
+		template <HostSampleType hostSampleType>
+		void BenchmarkHostSampleTypeDeinterleave(std::string_view name, const ConversionCase& conversionCase, size_t frameCount) {
+			using Reference = ReferenceHostSample<hostSampleType>;
+			const auto interleaved = MakeTestSignal(frameCount * channelCount * sampleSizeInBytes);
+			auto int32ChannelBuffers = MakeChannelBuffers(frameCount);
+			const auto int32Destinations = GetChannelPointers<std::byte*>(int32ChannelBuffers, conversionCase.useSlot);
+			std::array<std::vector<std::byte>, channelCount> referenceResult;
+			for (auto& channelBuffer : referenceResult) channelBuffer.resize(frameCount * Reference::sizeInBytes);
+			auto optimizedResult = referenceResult;
+			const auto referenceDestinations = GetChannelPointers<std::byte*>(referenceResult, conversionCase.useSlot);
+			const auto optimizedDestinations = GetChannelPointers<std::byte*>(optimizedResult, conversionCase.useSlot);
+
+			const SampleTransform<channelCount> int32Transform = { .swapEndianness = conversionCase.transform.swapEndianness };
+			auto hostTransform = conversionCase.transform;
+			hostTransform.hostSampleType = hostSampleType;
+			const auto reference = [&] {
+				Deinterleave(interleaved.data(), int32Destinations, frameCount, int32Transform);
+				for (size_t slot = 0; slot < channelCount; ++slot)
+					if (int32Destinations[slot] != nullptr) Reference::FromInt32(int32Destinations[slot], referenceDestinations[slot], frameCount, conversionCase.transform.invertPolarity[slot]);
+			};
+			const auto optimizedNanoseconds = CompareKernels(name, frameCount, reference, [&] { Deinterleave(interleaved.data(), optimizedDestinations, frameCount, hostTransform); }, [&] { return referenceResult == optimizedResult; });
+			CompareBaseline(std::string(name) + " vs Int32", frameCount, [&] { Deinterleave(interleaved.data(), int32Destinations, frameCount, conversionCase.transform); }, optimizedNanoseconds);
+		}
+
+		template <HostSampleType hostSampleType>
+		void BenchmarkHostSampleType(std::string_view hostSampleTypeName) {
+			const auto& outputCase = outputCases.back();
+			const auto& inputCase = inputCases.back();
+			std::cout << std::endl;
+			for (const auto frameCount : frameCounts) {
+				BenchmarkHostSampleTypeInterleave<hostSampleType>(std::string(outputCase.name) + ", " + std::string(hostSampleTypeName), outputCase, frameCount);
+				BenchmarkHostSampleTypeDeinterleave<hostSampleType>(std::string(inputCase.name) + ", " + std::string(hostSampleTypeName), inputCase, frameCount);
+			}
+		}
+
+		// ASIO sample types other than Int32 (see the `sampleType` option), with the full QA401 conversion.
+		void BenchmarkHostSampleTypes() {
+			BenchmarkHostSampleType<HostSampleType::INT24>("Int24");
+			BenchmarkHostSampleType<HostSampleType::FLOAT32>("Float32");
+			BenchmarkHostSampleType<HostSampleType::FLOAT64>("Float64");
+		}
+
+		// A separate scalar calibration pass over a channel, which is what it would take to calibrate samples if the conversion kernels didn't do it.
+		// Polarity inversion is folded into `scale` and `offset`, the same way the kernels do it, so that results match exactly.
+		void ReferenceCalibrate(const std::byte* const source, std::byte* const destination, const size_t frameCount, const double scale, const double offset) {
+			for (size_t frame = 0; frame < frameCount; ++frame) {
+				int32_t value;
+				memcpy(&value, source + frame * sampleSizeInBytes, sampleSizeInBytes);
+				value = int32_t(std::lrint(std::clamp(double(value) * scale + offset, -2147483648.0, 2147483647.0)));
+				memcpy(destination + frame * sampleSizeInBytes, &value, sampleSizeInBytes);
+			}
+		}
+
+		// Typical corrections for a QA40x range: a fraction of a dB of gain error and a small DC offset.
+		constexpr std::array<SampleCalibration, channelCount> benchmarkCalibration = { { { .gain = 1.0139, .offset = 0.0001 }, { .gain = 0.9943, .offset = -0.00002 } } };
+
+		// The reference is a separate calibration pass followed by the uncalibrated kernel; the baseline is the uncalibrated kernel alone.
+		void BenchmarkCalibrationInterleave(std::string_view name, const ConversionCase& conversionCase, size_t frameCount) {
+			auto hostChannelBuffers = MakeChannelBuffers(frameCount);
+			const auto hostSources = GetChannelPointers<const std::byte*>(hostChannelBuffers, conversionCase.useSlot);
+			auto int32ChannelBuffers = MakeChannelBuffers(frameCount);
+			const auto int32Sources = GetChannelPointers<const std::byte*>(int32ChannelBuffers, conversionCase.useSlot);
+			std::vector<std::byte> referenceResult(frameCount * channelCount * sampleSizeInBytes);
+			std::vector<std::byte> optimizedResult(referenceResult.size());
+
+			const SampleTransform<channelCount> int32Transform = { .swapEndianness = conversionCase.transform.swapEndianness };
+			auto calibratedTransform = conversionCase.transform;
+			calibratedTransform.calibration = benchmarkCalibration;
+			const auto reference = [&] {
+				for (size_t slot = 0; slot < channelCount; ++slot) {
+					if (hostSources[slot] == nullptr) continue;
+					const auto sign = conversionCase.transform.invertPolarity[slot] ? -1.0 : 1.0;
+					ReferenceCalibrate(hostSources[slot], int32ChannelBuffers[slot].data(), frameCount, sign * benchmarkCalibration[slot].gain, sign * benchmarkCalibration[slot].offset * 2147483648.0);
+				}
+				Interleave(int32Sources, referenceResult.data(), frameCount, int32Transform);
+			};
+			const auto optimizedNanoseconds = CompareKernels(name, frameCount, reference, [&] { Interleave(hostSources, optimizedResult.data(), frameCount, calibratedTransform); }, [&] { return referenceResult == optimizedResult; });
+			CompareBaseline(std::string(name) + " vs uncalibrated", frameCount, [&] { Interleave(hostSources, referenceResult.data(), frameCount, conversionCase.transform); }, optimizedNanoseconds);
+		}
+
+		void BenchmarkCalibrationDeinterleave(std::string_view name, const ConversionCase& conversionCase, size_t frameCount) {
+			const auto interleaved = MakeTestSignal(frameCount * channelCount * sampleSizeInBytes);
+			auto int32ChannelBuffers = MakeChannelBuffers(frameCount);
+			const auto int32Destinations = GetChannelPointers<std::byte*>(int32ChannelBuffers, conversionCase.useSlot);
+			auto referenceResult = MakeChannelBuffers(frameCount);
+			auto optimizedResult = MakeChannelBuffers(frameCount);
+			const auto referenceDestinations = GetChannelPointers<std::byte*>(referenceResult, conversionCase.useSlot);
+			const auto optimizedDestinations = GetChannelPointers<std::byte*>(optimizedResult, conversionCase.useSlot);
+
+			const SampleTransform<channelCount> int32Transform = { .swapEndianness = conversionCase.transform.swapEndianness };
+			auto calibratedTransform = conversionCase.transform;
+			calibratedTransform.calibration = benchmarkCalibration;
+			const auto reference = [&] {
+				Deinterleave(interleaved.data(), int32Destinations, frameCount, int32Transform);
+				for (size_t slot = 0; slot < channelCount; ++slot) {
+					if (int32Destinations[slot] == nullptr) continue;
+					const auto sign = conversionCase.transform.invertPolarity[slot] ? -1.0 : 1.0;
+					ReferenceCalibrate(int32Destinations[slot], referenceDestinations[slot], frameCount, sign * benchmarkCalibration[slot].gain, benchmarkCalibration[slot].offset * 2147483648.0);
+				}
+			};
+			const auto optimizedNanoseconds = CompareKernels(name, frameCount, reference, [&] { Deinterleave(interleaved.data(), optimizedDestinations, frameCount, calibratedTransform); }, [&] { return referenceResult == optimizedResult; });
+			CompareBaseline(std::string(name) + " vs uncalibrated", frameCount, [&] { Deinterleave(interleaved.data(), referenceDestinations, frameCount, conversionCase.transform); }, optimizedNanoseconds);
+		}
+
+		// Per-channel calibration (see the `inputCalibration` and `outputCalibration` options) on Int32 samples, with the full QA401 conversion.
+		// Floating point sample types are not benchmarked separately, as they go through the same multiply-add whether they are calibrated or not.
+		void BenchmarkCalibration() {
+			const auto& outputCase = outputCases.back();
+			const auto& inputCase = inputCases.back();
+			std::cout << std::endl;
+			for (const auto frameCount : frameCounts) {
+				BenchmarkCalibrationInterleave(std::string(outputCase.name) + ", calibrated", outputCase, frameCount);
+				BenchmarkCalibrationDeinterleave(std::string(inputCase.name) + ", calibrated", inputCase, frameCount);
+			}
+		}
+
+		// A separate scalar high-pass filter pass over a channel, which is what it would take to filter samples once they are in the ASIO buffers.
+		// Filtering happens before polarity inversion, the same way the kernels do it, so that results match exactly.
+		void ReferenceHighPass(std::byte* const buffer, const size_t frameCount, const Biquad& biquad, double& z1, double& z2) {
+			for (size_t frame = 0; frame < frameCount; ++frame) {
+				int32_t value;
+				memcpy(&value, buffer + frame * sampleSizeInBytes, sampleSizeInBytes);
+				const auto x = double(value);
+				const auto y = biquad.b0 * x + z1;
+				z1 = (biquad.b1 * x + z2) - biquad.a1 * y;
+				z2 = biquad.b2 * x - biquad.a2 * y;
+				value = int32_t(std::lrint(std::clamp(y, -2147483648.0, 2147483647.0)));
+				memcpy(buffer + frame * sampleSizeInBytes, &value, sampleSizeInBytes);
+			}
+		}
+
+		// The reference is the unfused conversion followed by a separate filter pass; the baseline is the unfiltered conversion alone.
+		// When calibration is used, the reference drops the calibration offset, as the filter is expected to.
+		void BenchmarkHighPassFilterDeinterleave(std::string_view name, const ConversionCase& conversionCase, const Biquad& biquad, const std::array<SampleCalibration, channelCount>& calibration, size_t frameCount) {
+			const auto interleaved = MakeTestSignal(frameCount * channelCount * sampleSizeInBytes);
+			auto referenceResult = MakeChannelBuffers(frameCount);
+			auto optimizedResult = MakeChannelBuffers(frameCount);
+			const auto referenceDestinations = GetChannelPointers<std::byte*>(referenceResult, conversionCase.useSlot);
+			const auto optimizedDestinations = GetChannelPointers<std::byte*>(optimizedResult, conversionCase.useSlot);
+
+			const SampleTransform<channelCount> unfilteredTransform = { .swapEndianness = conversionCase.transform.swapEndianness };
+			auto filteredTransform = conversionCase.transform;
+			filteredTransform.calibration = calibration;
+			SlotFilter<channelCount> referenceFilter{ .biquad = biquad };
+			SlotFilter<channelCount> optimizedFilter{ .biquad = biquad };
+			const auto reference = [&] {
+				Deinterleave(interleaved.data(), referenceDestinations, frameCount, unfilteredTransform);
+				for (size_t slot = 0; slot < channelCount; ++slot) {
+					if (referenceDestinations[slot] == nullptr) continue;
+					ReferenceHighPass(referenceDestinations[slot], frameCount, biquad, referenceFilter.z1[slot], referenceFilter.z2[slot]);
+					const auto sign = conversionCase.transform.invertPolarity[slot] ? -1.0 : 1.0;
+					if (calibration[slot] != SampleCalibration{}) ReferenceCalibrate(referenceDestinations[slot], referenceDestinations[slot], frameCount, sign * calibration[slot].gain, 0);
+					else if (conversionCase.transform.invertPolarity[slot]) ReferenceInvertPolarity(referenceDestinations[slot], frameCount);
+				}
+			};
+			const auto optimizedNanoseconds = CompareKernels(name, frameCount, reference, [&] { FilterAndDeinterleave(interleaved.data(), optimizedDestinations, frameCount, filteredTransform, optimizedFilter); }, [&] { return referenceResult == optimizedResult; });
+			CompareBaseline(std::string(name) + " vs unfiltered", frameCount, [&] { Deinterleave(interleaved.data(), referenceDestinations, frameCount, filteredTransform); }, optimizedNanoseconds);
+		}
+
+		// The input high-pass filter (see the `inputHighPassFilterHz` option), with the full QA401 conversion, with and without calibration.
+		void BenchmarkHighPassFilter() {
+			const auto& inputCase = inputCases.back();
+			std::cout << std::endl;
+			for (const auto frameCount : frameCounts) {
+				BenchmarkHighPassFilterDeinterleave(std::string(inputCase.name) + ", high-pass order 1", inputCase, GetFirstOrderHighPass(10, 48000), {}, frameCount);
+				BenchmarkHighPassFilterDeinterleave(std::string(inputCase.name) + ", high-pass order 2", inputCase, GetSecondOrderHighPass(10, 48000), {}, frameCount);
+				BenchmarkHighPassFilterDeinterleave(std::string(inputCase.name) + ", high-pass 2, calibrated", inputCase, GetSecondOrderHighPass(10, 48000), benchmarkCalibration, frameCount);
+			}
+		}
+
+		// How much of the real time budget processing takes, i.e. the time it takes to process an ASIO buffer relative to the duration of that buffer.
+		void ReportRealTimeBudget(double nanoseconds, size_t inputFrameCount, double inputSampleRate) {
+			std::cout << std::left << std::setw(72) << "  real time budget used" << std::right << std::setprecision(2) << std::setw(8)
+				<< nanoseconds / (double(inputFrameCount) * 1e9 / inputSampleRate) * 100 << "%" << std::endl;
+		}
+
+		struct ResamplerCase {
+			std::string_view name;
+			double inputSampleRate;
+			size_t upFactor;
+			size_t downFactor;
+		};
+
+		// Compares the SSE2 kernel with the one that would be used on this machine, and reports how much of the real time budget the latter uses.
+		void BenchmarkResampler() {
+			std::cout << std::endl;
+			const std::array<ResamplerCase, 4> resamplerCases = { {
+				{ "Resample 44.1 -> 48 kHz", 44100, 160, 147 },
+				{ "Resample 48 -> 44.1 kHz", 48000, 147, 160 },
+				{ "Resample 88.2 -> 192 kHz", 88200, 320, 147 },
+				{ "Resample 192 -> 88.2 kHz", 192000, 147, 320 },
+			} };
+			for (const auto frameCount : frameCounts) {
+				for (const auto& resamplerCase : resamplerCases) {
+					// ASIO buffers are a whole number of resampling periods.
+					const auto period = (std::min)(resamplerCase.upFactor, resamplerCase.downFactor);
+					const auto hostFrameCount = (frameCount + period - 1) / period * period;
+					const auto inputFrameCount = resamplerCase.upFactor > resamplerCase.downFactor ? hostFrameCount : hostFrameCount / resamplerCase.upFactor * resamplerCase.downFactor;
+					const auto input = MakeTestSignal(inputFrameCount * channelCount * sampleSizeInBytes);
+					Resampler<channelCount> referenceResampler(resamplerCase.upFactor, resamplerCase.downFactor, inputFrameCount, false, false);
+					Resampler<channelCount> optimizedResampler(resamplerCase.upFactor, resamplerCase.downFactor, inputFrameCount, false, false);
+					std::span<const std::byte> referenceOutput, optimizedOutput;
+					const auto optimizedNanoseconds = CompareKernels(resamplerCase.name, inputFrameCount,
+						[&] { referenceOutput = referenceResampler.Process(input, CpuFeatures{}); },
+						[&] { optimizedOutput = optimizedResampler.Process(input); },
+						[&] { return std::ranges::equal(referenceOutput, optimizedOutput); });
+					ReportRealTimeBudget(optimizedNanoseconds, inputFrameCount, resamplerCase.inputSampleRate);
+				}
+			}
+		}
+
+		struct DecimatorCase {
+			std::string_view name;
+			double inputSampleRate;
+			size_t stageCount;
+		};
+
+		// Like BenchmarkResampler(), for the input decimator used with the `deviceSampleRateHz` option. The frame counts are ASIO buffer sizes, i.e. at
+		// the output sample rate. Also compares with decimating using a Resampler with the same ratio.
+		void BenchmarkDecimator() {
+			std::cout << std::endl;
+			const std::array<DecimatorCase, 2> decimatorCases = { {
+				{ "Decimate 384 -> 48 kHz", 384000, 3 },
+				{ "Decimate 192 -> 48 kHz", 192000, 2 },
+			} };
+			for (const auto frameCount : frameCounts) {
+				for (const auto& decimatorCase : decimatorCases) {
+					const auto factor = size_t(1) << decimatorCase.stageCount;
+					const auto inputFrameCount = frameCount * factor;
+					const auto input = MakeTestSignal(inputFrameCount * channelCount * sampleSizeInBytes);
+					Decimator<channelCount> referenceDecimator(decimatorCase.stageCount, inputFrameCount, false, false);
+					Decimator<channelCount> optimizedDecimator(decimatorCase.stageCount, inputFrameCount, false, false);
+					Resampler<channelCount> resampler(1, factor, inputFrameCount, false, false);
+					std::span<const std::byte> referenceOutput, optimizedOutput;
+					const auto optimizedNanoseconds = CompareKernels(decimatorCase.name, frameCount,
+						[&] { referenceOutput = referenceDecimator.Process(input, CpuFeatures{}); },
+						[&] { optimizedOutput = optimizedDecimator.Process(input); },
+						[&] { return std::ranges::equal(referenceOutput, optimizedOutput); });
+					CompareBaseline(std::string(decimatorCase.name) + " vs resampler", frameCount, [&] { resampler.Process(input); }, optimizedNanoseconds);
+					ReportRealTimeBudget(optimizedNanoseconds, inputFrameCount, decimatorCase.inputSampleRate);
+				}
+			}
+		}
+
+		// The mutex and condition variable based OutputReady handshake that ASIO401 used before it switched to AtomicEvent.
+		class ReferenceEvent final {
+		public:
+			explicit ReferenceEvent(bool initiallySet) : state(initiallySet) {}
+
+			void Set() {
+				{
+					std::scoped_lock lock(mutex);
+					state = true;
+				}
+				condition.notify_all();
+			}
+			void Reset() {
+				std::scoped_lock lock(mutex);
+				state = false;
+			}
+			void Wait() {
+				std::unique_lock lock(mutex);
+				condition.wait(lock, [&] { return state; });
+			}
+
+		private:
+			std::mutex mutex;
+			std::condition_variable condition;
+			bool state;
+		};
+
+		// Measures the cost of a handshake when the ASIO Host Application calls OutputReady() from within bufferSwitch(), which is the most common case:
+		// the event is reset before bufferSwitch(), set from within it, and then checked by the streaming thread, all on the same thread.
+		template <typename Event>
+		double MeasureInlineHandshake(Event& event) {
+			return Measure([&] {
+				event.Reset();
+				event.Set();
+				event.Wait();
+			});
+		}
+
+		// Measures the round trip time when the handshake crosses threads, i.e. the ASIO Host Application calls OutputReady() from another thread.
+		// This is a ping-pong between two threads that use a pair of events.
+		template <typename EventFactory>
+		double MeasureCrossThreadHandshake(EventFactory eventFactory) {
+			constexpr size_t roundTrips = 20000;
+			auto request = eventFactory();
+			auto response = eventFactory();
+			std::thread hostThread([&] {
+				for (size_t roundTrip = 0; roundTrip < roundTrips; ++roundTrip) {
+					request->Wait();
+					request->Reset();
+					response->Set();
+				}
+			});
+			const auto start = std::chrono::steady_clock::now();
+			for (size_t roundTrip = 0; roundTrip < roundTrips; ++roundTrip) {
+				response->Reset();
+				request->Set();
+				response->Wait();
+			}
+			const auto end = std::chrono::steady_clock::now();
+			hostThread.join();
+			return std::chrono::duration<double, std::nano>(end - start).count() / roundTrips;
+		}
+
+		void ReportHandshake(std::string_view name, double referenceNanoseconds, double optimizedNanoseconds) {
+			std::cout << std::left << std::setw(72) << name << std::right
+				<< std::fixed << std::setprecision(0) << std::setw(10) << referenceNanoseconds << " ns -> "
+				<< std::setw(10) << optimizedNanoseconds << " ns ("
+				<< std::setprecision(1) << referenceNanoseconds / optimizedNanoseconds << "x)" << std::endl;
+		}
+
+		void BenchmarkOutputReadyHandshake() {
+			std::cout << std::endl;
+			{
+				ReferenceEvent referenceEvent(true);
+				AtomicEvent atomicEvent(true);
+				ReportHandshake("OutputReady handshake, inline", MeasureInlineHandshake(referenceEvent), MeasureInlineHandshake(atomicEvent));
+			}
+			const auto referenceNanoseconds = MeasureCrossThreadHandshake([] { return std::make_unique<ReferenceEvent>(false); });
+			for (const size_t spinCount : { 0, 1000, 10000 }) {
+				ReportHandshake("OutputReady handshake, cross-thread round trip, spin " + std::to_string(spinCount),
+					referenceNanoseconds, MeasureCrossThreadHandshake([&] { return std::make_unique<AtomicEvent>(false, spinCount); }));
+			}
+		}
+
+		struct ClockEstimatorCase {
+			std::string_view name;
+			double driftPPM;
+			// Cycled through, to simulate ASIO buffers being split into transfers of different sizes.
+			std::vector<int64_t> transferSizesInFrames;
+			// Simulates the device dropping that many frames at `disruptionSeconds`, e.g. because the streaming thread fell behind.
+			int64_t lostFrames = 0;
+			// Simulates the streaming thread stalling for that long at `disruptionSeconds`, without any frames being lost.
+			double stallNanoseconds = 0;
+			// The check fails if the estimate is ever further than this from the actual completion time once measurement starts.
+			double maxEstimateErrorNanoseconds = 500e3;
+			// The check fails if the measured drift is further than this from `driftPPM`.
+			double maxDriftErrorPPM = 3;
+		};
+
+		// Not a benchmark strictly speaking: feeds ClockEstimator with synthetic, deterministic completion times that simulate a device clock running
+		// at a known rate, observed through a jittery scheduler, and checks how close the estimates are to the truth. Lost frames must be reported as
+		// a single discontinuity of about that many frames, and nothing else (including a stall) may be reported as a discontinuity.
+		void BenchmarkClockEstimator() {
+			std::cout << std::endl;
+			constexpr double nominalSampleRate = 48000;
+			constexpr double durationSeconds = 60;
+			// Ignore the beginning of the stream, where the loop is still converging.
+			constexpr double measureAfterSeconds = 20;
+			constexpr double disruptionSeconds = 40;
+			// The estimator only sees completion times, so the size of a discontinuity is subject to jitter.
+			constexpr int64_t discontinuityToleranceInFrames = 16;
+			const std::vector<ClockEstimatorCase> cases = {
+				{ "no drift, 1024 frames", 0, { 1024 } },
+				{ "-100 ppm, 1024 frames", -100, { 1024 } },
+				{ "+50 ppm, 256 frames", 50, { 256 } },
+				{ "+50 ppm, 480+544 frames", 50, { 480, 544 } },
+				// The estimate has to converge again after the discontinuity.
+				{ "no drift, 256 frames, 500 lost", 0, { 256 }, 500, 0, 15e6 },
+				{ "no drift, 256 frames, 30 ms stall", 0, { 256 }, 0, 30e6 },
+			};
+			for (const auto& clockEstimatorCase : cases) {
+				std::mt19937_64 random(42);
+				// Models the time it takes for the OS to wake up the streaming thread after the transfer actually completed.
+				std::exponential_distribution<double> schedulingLatencyNanoseconds(1 / 100e3);
+				std::uniform_real_distribution<double> uniform(0, 1);
+				const auto actualSampleRate = nominalSampleRate * (1 + clockEstimatorCase.driftPPM * 1e-6);
+				constexpr int64_t startTimeNanoseconds = 1'000'000'000'000'000;
+
+				ClockEstimator clockEstimator(nominalSampleRate, {});
+				double rawSum = 0, rawSquareSum = 0, rawMax = 0, estimateSum = 0, estimateSquareSum = 0, estimateMax = 0;
+				size_t count = 0;
+				int64_t framePosition = 0;
+				std::vector<int64_t> discontinuitiesInFrames;
+				const auto disruptionTimeNanoseconds = startTimeNanoseconds + disruptionSeconds * 1e9;
+				for (size_t transferIndex = 0; double(framePosition) / actualSampleRate < durationSeconds; ++transferIndex) {
+					framePosition += clockEstimatorCase.transferSizesInFrames[transferIndex % clockEstimatorCase.transferSizesInFrames.size()];
+					auto actualTimeNanoseconds = startTimeNanoseconds + double(framePosition) * 1e9 / actualSampleRate;
+					// Lost frames never cross the bus, so every frame after that crosses it later than it would have.
+					if (actualTimeNanoseconds >= disruptionTimeNanoseconds) actualTimeNanoseconds += double(clockEstimatorCase.lostFrames) * 1e9 / actualSampleRate;
+					auto jitterNanoseconds = schedulingLatencyNanoseconds(random);
+					// Occasional long delays, e.g. DPCs.
+					if (uniform(random) < 0.01) jitterNanoseconds += 2e6 * uniform(random);
+					// Completions that happen while the thread is stalled are all observed at the end of the stall.
+					if (actualTimeNanoseconds >= disruptionTimeNanoseconds && actualTimeNanoseconds < disruptionTimeNanoseconds + clockEstimatorCase.stallNanoseconds)
+						jitterNanoseconds += disruptionTimeNanoseconds + clockEstimatorCase.stallNanoseconds - actualTimeNanoseconds;
+					const auto discontinuityNanoseconds = clockEstimator.Update(framePosition, std::llround(actualTimeNanoseconds + jitterNanoseconds));
+					if (discontinuityNanoseconds.has_value()) discontinuitiesInFrames.push_back(std::llround(double(*discontinuityNanoseconds) * actualSampleRate / 1e9));
+
+					if (double(framePosition) / actualSampleRate < measureAfterSeconds) continue;
+					const auto estimateErrorNanoseconds = double(clockEstimator.GetEstimate()->GetTimeNanoseconds(framePosition)) - actualTimeNanoseconds;
+					rawSum += jitterNanoseconds;
+					rawSquareSum += jitterNanoseconds * jitterNanoseconds;
+					rawMax = (std::max)(rawMax, jitterNanoseconds);
+					estimateSum += estimateErrorNanoseconds;
+					estimateSquareSum += estimateErrorNanoseconds * estimateErrorNanoseconds;
+					estimateMax = (std::max)(estimateMax, std::abs(estimateErrorNanoseconds));
+					++count;
+				}
+				const auto standardDeviation = [&](double sum, double squareSum) {
+					const auto mean = sum / double(count);
+					return std::sqrt(squareSum / double(count) - mean * mean);
+				};
+				std::cout << std::left << std::setw(52) << "Clock estimator, " + std::string(clockEstimatorCase.name) << std::right
+					<< std::fixed << std::setprecision(0) << " jitter sd/max: " << std::setw(6) << standardDeviation(rawSum, rawSquareSum) / 1e3
+					<< "/" << std::setw(5) << rawMax / 1e3 << " us -> " << std::setw(4) << standardDeviation(estimateSum, estimateSquareSum) / 1e3
+					<< "/" << std::setw(4) << estimateMax / 1e3 << " us, drift " << std::showpos << std::setprecision(0) << clockEstimatorCase.driftPPM
+					<< " ppm -> " << std::setprecision(2) << clockEstimator.GetDriftPPM() << " ppm" << std::noshowpos;
+				for (const auto discontinuityInFrames : discontinuitiesInFrames) std::cout << ", discontinuity of " << discontinuityInFrames << " frames";
+
+				const auto driftErrorPPM = std::abs(clockEstimator.GetDriftPPM() - clockEstimatorCase.driftPPM);
+				const auto discontinuitiesMatch = clockEstimatorCase.lostFrames == 0 ? discontinuitiesInFrames.empty() :
+					discontinuitiesInFrames.size() == 1 && std::abs(discontinuitiesInFrames.front() - clockEstimatorCase.lostFrames) <= discontinuityToleranceInFrames;
+				if (estimateMax > clockEstimatorCase.maxEstimateErrorNanoseconds) std::cout << " ESTIMATE ERROR TOO HIGH";
+				if (driftErrorPPM > clockEstimatorCase.maxDriftErrorPPM) std::cout << " DRIFT ERROR TOO HIGH";
+				if (!discontinuitiesMatch) std::cout << " UNEXPECTED DISCONTINUITIES";
+				if (estimateMax > clockEstimatorCase.maxEstimateErrorNanoseconds || driftErrorPPM > clockEstimatorCase.maxDriftErrorPPM || !discontinuitiesMatch) ++failureCount;
+				std::cout << std::endl;
+			}
+		}
+
+	}
+}
+
+int main(int argc, char** argv) {
+	const std::array<std::pair<std::string_view, void(*)()>, 9> benchmarks = { {
+		{ "Conversion", ::asio401::BenchmarkConversion },
+		{ "QA401Conversion", ::asio401::BenchmarkQA401Conversion },
+		{ "HostSampleTypes", ::asio401::BenchmarkHostSampleTypes },
+		{ "Calibration", ::asio401::BenchmarkCalibration },
+		{ "HighPassFilter", ::asio401::BenchmarkHighPassFilter },
+		{ "Resampler", ::asio401::BenchmarkResampler },
+		{ "Decimator", ::asio401::BenchmarkDecimator },
+		{ "OutputReadyHandshake", ::asio401::BenchmarkOutputReadyHandshake },
+		{ "ClockEstimator", ::asio401::BenchmarkClockEstimator },
+	} };
+	// Runs every benchmark by default, or only the ones named on the command line.
+	const std::vector<std::string_view> selected(argv + 1, argv + argc);
+	for (const auto& name : selected) {
+		if (std::ranges::none_of(benchmarks, [&](const auto& benchmark) { return benchmark.first == name; })) {
+			std::cerr << "Unknown benchmark: " << name << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	std::cout << "CPU supports SSSE3: " << (::asio401::GetCpuFeatures().ssse3 ? "yes" : "no") << ", AVX2: " << (::asio401::GetCpuFeatures().avx2 ? "yes" : "no") << std::endl;
+	for (const auto& [name, benchmark] : benchmarks)
+		if (selected.empty() || std::ranges::find(selected, name) != selected.end()) benchmark();
+
+	if (::asio401::failureCount > 0) {
+		std::cout << std::endl << ::asio401::failureCount << " check(s) FAILED" << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,196 @@
+#include "../ASIO401/streaming_stats_format.h"
+
+#include <windows.h>
+#include <tlhelp32.h>
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace asio401 {
+	namespace {
+
+		// A read-only view of the statistics block of a given process.
+		class StatsView final {
+		public:
+			static std::unique_ptr<StatsView> Open(DWORD processId) {
+				const auto fileMapping = OpenFileMappingW(FILE_MAP_READ, FALSE, GetStreamingStatsSharedMemoryName(processId).c_str());
+				if (fileMapping == NULL) return nullptr;
+				const auto view = MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+				CloseHandle(fileMapping);
+				if (view == NULL) return nullptr;
+				return std::unique_ptr<StatsView>(new StatsView(processId, static_cast<const StreamingStatsBlock*>(view)));
+			}
+
+			~StatsView() { UnmapViewOfFile(block); }
+			StatsView(const StatsView&) = delete;
+			StatsView& operator=(const StatsView&) = delete;
+
+			DWORD GetProcessId() const { return processId; }
+			// Null if the block is not in a format we understand.
+			const StreamingStatsBlock* Get() const {
+				if (block->magic != StreamingStatsBlock::expectedMagic || block->version < StreamingStatsBlock::currentVersion || block->sizeInBytes < sizeof(StreamingStatsBlock)) return nullptr;
+				return block;
+			}
+
+		private:
+			StatsView(DWORD processId, const StreamingStatsBlock* block) : processId(processId), block(block) {}
+
+			const DWORD processId;
+			const StreamingStatsBlock* const block;
+		};
+
+		std::vector<std::unique_ptr<StatsView>> OpenAllStatsViews() {
+			std::vector<std::unique_ptr<StatsView>> statsViews;
+			const auto snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+			if (snapshot == INVALID_HANDLE_VALUE) return statsViews;
+			PROCESSENTRY32W processEntry = { .dwSize = sizeof(processEntry) };
+			for (auto found = Process32FirstW(snapshot, &processEntry); found; found = Process32NextW(snapshot, &processEntry)) {
+				auto statsView = StatsView::Open(processEntry.th32ProcessID);
+				if (statsView != nullptr) statsViews.push_back(std::move(statsView));
+			}
+			CloseHandle(snapshot);
+			return statsViews;
+		}
+
+		std::string DescribeHistogram(const StreamingStatsHistogram& histogram) {
+			const auto count = histogram.count.load(std::memory_order_relaxed);
+			if (count == 0) return "none";
+			std::stringstream stream;
+			stream << std::fixed << std::setprecision(1) << count << " samples, mean " << double(histogram.sumNanoseconds.load(std::memory_order_relaxed)) / double(count) / 1e3
+				<< " us, max " << double(histogram.maximumNanoseconds.load(std::memory_order_relaxed)) / 1e3 << " us\n     ";
+			for (size_t bucketIndex = 0; bucketIndex < StreamingStatsHistogram::bucketCount; ++bucketIndex) {
+				const auto bucketCount = histogram.buckets[bucketIndex].load(std::memory_order_relaxed);
+				if (bucketCount == 0) continue;
+				stream << " [" << StreamingStatsHistogram::GetBucketFloorMicroseconds(bucketIndex) << "us";
+				if (bucketIndex + 1 == StreamingStatsHistogram::bucketCount) stream << "+";
+				stream << "] " << bucketCount;
+			}
+			return stream.str();
+		}
+
+		struct Counters final {
+			uint64_t writeCount;
+			uint64_t readCount;
+			uint64_t bufferSwitchCount;
+			uint64_t missedDeadlineCount;
+			uint64_t resetRequestCount;
+			uint64_t discontinuityCount;
+			uint64_t lostFrameCount;
+			uint64_t repeatedFrameCount;
+			uint64_t recoveryCount;
+		};
+
+		Counters GetCounters(const StreamingStatsBlock& block) {
+			return {
+				.writeCount = block.writeCount.load(std::memory_order_relaxed),
+				.readCount = block.readCount.load(std::memory_order_relaxed),
+				.bufferSwitchCount = block.bufferSwitchCount.load(std::memory_order_relaxed),
+				.missedDeadlineCount = block.missedDeadlineCount.load(std::memory_order_relaxed),
+				.resetRequestCount = block.resetRequestCount.load(std::memory_order_relaxed),
+				.discontinuityCount = block.discontinuityCount.load(std::memory_order_relaxed),
+				.lostFrameCount = block.lostFrameCount.load(std::memory_order_relaxed),
+				.repeatedFrameCount = block.repeatedFrameCount.load(std::memory_order_relaxed),
+				.recoveryCount = block.recoveryCount.load(std::memory_order_relaxed),
+			};
+		}
+
+		// What was seen during the previous Print() call for a given process.
+		struct PreviousState final {
+			std::optional<uint64_t> generation;
+			std::optional<Counters> counters;
+		};
+
+		void Print(const StatsView& statsView, PreviousState& previousState) {
+			const auto block = statsView.Get();
+			std::cout << "Process " << statsView.GetProcessId() << ": ";
+			if (block == nullptr) {
+				std::cout << "unsupported statistics format (version mismatch?)" << std::endl;
+				return;
+			}
+			const auto generation = block->generation.load(std::memory_order_acquire);
+			if (previousState.generation.has_value() && *previousState.generation != generation) {
+				// Differences with the previous counters would be meaningless.
+				std::cout << "driver was reinitialized, statistics start over" << std::endl << "  ";
+				previousState.counters.reset();
+			}
+			previousState.generation = generation;
+			const bool running = block->running.load(std::memory_order_relaxed) != 0;
+			const auto counters = GetCounters(*block);
+			const auto describeCounter = [&](uint64_t Counters::* counter) {
+				std::stringstream stream;
+				stream << counters.*counter;
+				if (previousState.counters.has_value()) stream << " (+" << counters.*counter - (*previousState.counters).*counter << ")";
+				return stream.str();
+			};
+			if (!running) {
+				// The statistics of previous streams are still there, but nothing is moving, so don't make it look like a live stream.
+				std::cout << "not streaming (last stream at " << block->sampleRate.load(std::memory_order_relaxed) << " Hz, "
+					<< block->bufferSizeInFrames.load(std::memory_order_relaxed) << " frames per ASIO buffer, " << block->streamCount.load(std::memory_order_relaxed) << " streams so far)" << std::endl;
+				previousState.counters = counters;
+				return;
+			}
+			std::cout << "streaming at " << block->sampleRate.load(std::memory_order_relaxed) << " Hz, "
+				<< block->bufferSizeInFrames.load(std::memory_order_relaxed) << " frames per ASIO buffer, " << block->streamCount.load(std::memory_order_relaxed) << " streams so far" << std::endl;
+			std::cout << "  In flight: " << block->inflightWrites.load(std::memory_order_relaxed) << " writes, " << block->inflightReads.load(std::memory_order_relaxed) << " reads" << std::endl;
+			std::cout << "  Writes: " << describeCounter(&Counters::writeCount) << ", reads: " << describeCounter(&Counters::readCount) << ", bufferSwitch() calls: " << describeCounter(&Counters::bufferSwitchCount) << std::endl;
+			std::cout << "  Missed deadlines: " << describeCounter(&Counters::missedDeadlineCount) << ", reset requests: " << describeCounter(&Counters::resetRequestCount) << ", recoveries: " << describeCounter(&Counters::recoveryCount) << std::endl;
+			std::cout << "  Discontinuities: " << describeCounter(&Counters::discontinuityCount) << ", lost frames: " << describeCounter(&Counters::lostFrameCount) << ", repeated frames: " << describeCounter(&Counters::repeatedFrameCount) << std::endl;
+			std::cout << "  Write latency: " << DescribeHistogram(block->writeLatency) << std::endl;
+			std::cout << "  Read latency: " << DescribeHistogram(block->readLatency) << std::endl;
+			std::cout << "  Read turnaround: " << DescribeHistogram(block->readTurnaround) << std::endl;
+			std::cout << "  bufferSwitch() duration: " << DescribeHistogram(block->bufferSwitchDuration) << std::endl;
+			std::cout << "  Completion lateness: " << DescribeHistogram(block->completionLateness) << std::endl;
+			std::cout << "  Recovery duration: " << DescribeHistogram(block->recoveryDuration) << std::endl;
+			previousState.counters = counters;
+		}
+
+		int Main(int argc, char** argv) {
+			std::optional<DWORD> processId;
+			bool once = false;
+			for (int argumentIndex = 1; argumentIndex < argc; ++argumentIndex) {
+				const std::string_view argument = argv[argumentIndex];
+				if (argument == "--once") once = true;
+				else if (!processId.has_value() && !argument.empty() && argument.find_first_not_of("0123456789") == argument.npos) processId = DWORD(std::stoul(std::string(argument)));
+				else {
+					std::cerr << "usage: ASIO401Stats [<process ID>] [--once]" << std::endl;
+					std::cerr << "Prints ASIO401 streaming statistics every second (or once). By default, prints statistics for every process that uses ASIO401." << std::endl;
+					return 2;
+				}
+			}
+
+			std::vector<std::unique_ptr<StatsView>> statsViews;
+			if (processId.has_value()) {
+				auto statsView = StatsView::Open(*processId);
+				if (statsView != nullptr) statsViews.push_back(std::move(statsView));
+			}
+			else statsViews = OpenAllStatsViews();
+			if (statsViews.empty()) {
+				std::cerr << "No ASIO401 statistics found. Is the ASIO Host Application running, with ASIO401 loaded?" << std::endl;
+				return 1;
+			}
+
+			std::map<DWORD, PreviousState> previousStates;
+			for (;;) {
+				for (const auto& statsView : statsViews) Print(*statsView, previousStates[statsView->GetProcessId()]);
+				if (once) return 0;
+				std::cout << std::endl;
+				std::this_thread::sleep_for(std::chrono::seconds(1));
+			}
+		}
+
+	}
+}
+
+int main(int argc, char** argv) {
+	return ::asio401::Main(argc, argv);
+}
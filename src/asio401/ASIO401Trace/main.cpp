@@ -0,0 +1,252 @@
+#include "../ASIO401/trace_format.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace asio401 {
+	namespace {
+
+		// A series of records that starts with a SESSION_BEGIN record (except possibly the first one, if the trace was truncated), sorted by time.
+		struct Session final {
+			std::optional<TraceRecord> begin;
+			std::vector<TraceRecord> records;
+		};
+
+		std::vector<Session> ReadTrace(const std::string& path) {
+			std::ifstream file(path, std::ios::binary);
+			if (!file) throw std::runtime_error("unable to open " + path);
+			const std::vector<char> contents{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+
+			TraceFileHeader header;
+			if (contents.size() < sizeof(header)) throw std::runtime_error("file is too small to be an ASIO401 trace");
+			memcpy(&header, contents.data(), sizeof(header));
+			if (header.magic != TraceFileHeader::expectedMagic) throw std::runtime_error("file is not an ASIO401 trace");
+			if (header.version != TraceFileHeader::currentVersion) throw std::runtime_error("unsupported trace version " + std::to_string(header.version));
+			if (header.recordSizeInBytes != sizeof(TraceRecord)) throw std::runtime_error("unexpected trace record size " + std::to_string(header.recordSizeInBytes));
+
+			std::vector<Session> sessions;
+			for (size_t offset = sizeof(header); offset + sizeof(TraceRecord) <= contents.size(); offset += sizeof(TraceRecord)) {
+				TraceRecord record;
+				memcpy(&record, contents.data() + offset, sizeof(record));
+				if (record.event == TraceEvent::SESSION_BEGIN || sessions.empty()) sessions.emplace_back();
+				if (record.event == TraceEvent::SESSION_BEGIN) sessions.back().begin = record;
+				sessions.back().records.push_back(record);
+			}
+			for (auto& session : sessions)
+				std::ranges::stable_sort(session.records, {}, &TraceRecord::timeNanoseconds);
+			return sessions;
+		}
+
+		class Stats final {
+		public:
+			void Record(double value) { values.push_back(value); }
+
+			std::string Describe(std::string_view unit) {
+				if (values.empty()) return "none";
+				std::ranges::sort(values);
+				double sum = 0;
+				for (const auto value : values) sum += value;
+				const auto percentile = [&](double fraction) { return values[size_t(fraction * double(values.size() - 1))]; };
+				std::stringstream stream;
+				stream << std::fixed << std::setprecision(1) << values.size() << " samples, min " << values.front() << " " << unit << ", mean " << sum / double(values.size()) << " " << unit
+					<< ", median " << percentile(0.5) << " " << unit << ", p99 " << percentile(0.99) << " " << unit << ", max " << values.back() << " " << unit;
+				return stream.str();
+			}
+
+		private:
+			std::vector<double> values;
+		};
+
+		double ToMicroseconds(int64_t nanoseconds) { return double(nanoseconds) / 1e3; }
+
+		void PrintSummary(const Session& session, size_t sessionIndex) {
+			std::cout << "Session #" << sessionIndex;
+			if (session.begin.has_value()) std::cout << " (ASIO buffer size: " << session.begin->arg0 << " frames, " << session.begin->arg1 << " I/O slots per direction)";
+			std::cout << ": " << session.records.size() << " records";
+			if (!session.records.empty()) std::cout << " over " << std::fixed << std::setprecision(3) << double(session.records.back().timeNanoseconds - session.records.front().timeNanoseconds) / 1e9 << " s";
+			std::cout << std::endl;
+
+			int64_t droppedRecords = 0;
+			size_t streamCount = 0;
+			int64_t discontinuityCount = 0, lostFrames = 0, repeatedFrames = 0;
+			Stats bufferSwitchDuration, bufferSwitchInterval, outputReadyDelay, writeDuration, readDuration, primingDuration, firstReadDelay, recoveryDuration;
+			std::optional<int64_t> streamStartTime, lastBufferSwitchBeginTime, recoveryBeginTime;
+			bool firstReadCompleted = false;
+			// Keyed by transfer index.
+			std::map<int64_t, int64_t> writeStartTimes, readStartTimes;
+			for (const auto& record : session.records) {
+				switch (record.event) {
+				case TraceEvent::RECORDS_DROPPED:
+					droppedRecords += record.arg0;
+					break;
+				case TraceEvent::STREAM_START:
+					++streamCount;
+					streamStartTime = record.timeNanoseconds;
+					lastBufferSwitchBeginTime.reset();
+					recoveryBeginTime.reset();
+					firstReadCompleted = false;
+					writeStartTimes.clear();
+					readStartTimes.clear();
+					break;
+				case TraceEvent::PRIMED:
+					if (streamStartTime.has_value()) primingDuration.Record(ToMicroseconds(record.timeNanoseconds - *streamStartTime));
+					break;
+				case TraceEvent::DISCONTINUITY:
+					++discontinuityCount;
+					(record.arg0 >= 0 ? lostFrames : repeatedFrames) += std::abs(record.arg0);
+					break;
+				case TraceEvent::RECOVERY_BEGIN:
+					// Transfer indices start over after a recovery. Priming and first read times would include the recovery, so don't count them.
+					if (!recoveryBeginTime.has_value()) recoveryBeginTime = record.timeNanoseconds;
+					streamStartTime.reset();
+					writeStartTimes.clear();
+					readStartTimes.clear();
+					break;
+				case TraceEvent::RECOVERY_END:
+					if (recoveryBeginTime.has_value()) recoveryDuration.Record(ToMicroseconds(record.timeNanoseconds - *recoveryBeginTime));
+					recoveryBeginTime.reset();
+					break;
+				case TraceEvent::WRITE_START:
+					writeStartTimes[record.arg0] = record.timeNanoseconds;
+					break;
+				case TraceEvent::WRITE_COMPLETE:
+					if (const auto startTime = writeStartTimes.find(record.arg0); startTime != writeStartTimes.end()) {
+						writeDuration.Record(ToMicroseconds(record.timeNanoseconds - startTime->second));
+						writeStartTimes.erase(startTime);
+					}
+					break;
+				case TraceEvent::READ_START:
+					readStartTimes[record.arg0] = record.timeNanoseconds;
+					break;
+				case TraceEvent::READ_COMPLETE:
+					if (const auto startTime = readStartTimes.find(record.arg0); startTime != readStartTimes.end()) {
+						readDuration.Record(ToMicroseconds(record.timeNanoseconds - startTime->second));
+						readStartTimes.erase(startTime);
+					}
+					if (!firstReadCompleted && streamStartTime.has_value()) {
+						firstReadDelay.Record(ToMicroseconds(record.timeNanoseconds - *streamStartTime));
+						firstReadCompleted = true;
+					}
+					break;
+				case TraceEvent::BUFFER_SWITCH_BEGIN:
+					if (lastBufferSwitchBeginTime.has_value()) bufferSwitchInterval.Record(ToMicroseconds(record.timeNanoseconds - *lastBufferSwitchBeginTime));
+					lastBufferSwitchBeginTime = record.timeNanoseconds;
+					break;
+				case TraceEvent::BUFFER_SWITCH_END:
+					if (lastBufferSwitchBeginTime.has_value()) bufferSwitchDuration.Record(ToMicroseconds(record.timeNanoseconds - *lastBufferSwitchBeginTime));
+					break;
+				case TraceEvent::OUTPUT_READY:
+					if (lastBufferSwitchBeginTime.has_value()) outputReadyDelay.Record(ToMicroseconds(record.timeNanoseconds - *lastBufferSwitchBeginTime));
+					break;
+				default:
+					break;
+				}
+			}
+
+			std::cout << "  Streams: " << streamCount << std::endl;
+			if (droppedRecords > 0) std::cout << "  WARNING: " << droppedRecords << " records were dropped; statistics are incomplete" << std::endl;
+			if (discontinuityCount > 0) std::cout << "  WARNING: " << discontinuityCount << " stream discontinuities: approximately " << lostFrames << " frames lost, " << repeatedFrames << " frames repeated" << std::endl;
+			std::cout << "  Time from stream start to end of priming: " << primingDuration.Describe("us") << std::endl;
+			std::cout << "  Time from stream start to first read completion: " << firstReadDelay.Describe("us") << std::endl;
+			std::cout << "  Write transfer duration: " << writeDuration.Describe("us") << std::endl;
+			std::cout << "  Read transfer duration: " << readDuration.Describe("us") << std::endl;
+			std::cout << "  bufferSwitch() duration: " << bufferSwitchDuration.Describe("us") << std::endl;
+			std::cout << "  bufferSwitch() interval: " << bufferSwitchInterval.Describe("us") << std::endl;
+			std::cout << "  OutputReady() delay from bufferSwitch() start: " << outputReadyDelay.Describe("us") << std::endl;
+			std::cout << "  Recovery duration: " << recoveryDuration.Describe("us") << std::endl;
+		}
+
+		// See the Trace Event Format: https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+		// This can be loaded into chrome://tracing or https://ui.perfetto.dev.
+		void WriteChromeTrace(const std::vector<Session>& sessions, std::ostream& stream) {
+			std::optional<int64_t> originNanoseconds;
+			for (const auto& session : sessions)
+				if (!session.records.empty()) originNanoseconds = (std::min)(originNanoseconds.value_or(session.records.front().timeNanoseconds), session.records.front().timeNanoseconds);
+
+			stream << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+			bool first = true;
+			const auto beginEvent = [&](std::string_view name, std::string_view phase, size_t processId, uint32_t threadId, std::optional<int64_t> timeNanoseconds) {
+				if (!first) stream << ",";
+				first = false;
+				stream << "\n{\"name\":\"" << name << "\",\"ph\":\"" << phase << "\",\"pid\":" << processId << ",\"tid\":" << threadId;
+				if (timeNanoseconds.has_value()) stream << ",\"ts\":" << std::fixed << std::setprecision(3) << ToMicroseconds(*timeNanoseconds - *originNanoseconds);
+			};
+
+			for (size_t sessionIndex = 0; sessionIndex < sessions.size(); ++sessionIndex) {
+				const auto processId = sessionIndex + 1;
+				beginEvent("process_name", "M", processId, 0, std::nullopt);
+				stream << ",\"args\":{\"name\":\"ASIO401 session #" << sessionIndex << "\"}}";
+
+				for (const auto& record : sessions[sessionIndex].records) {
+					const auto writeTransfer = [&](std::string_view name, std::string_view phase) {
+						beginEvent(name, phase, processId, record.threadId, record.timeNanoseconds);
+						stream << ",\"cat\":\"" << name << "\",\"id\":\"" << name << "-" << sessionIndex << "-" << record.arg0 << "\",\"args\":{\"transfer\":" << record.arg0 << ",\"slot\":" << record.arg1 << "}}";
+					};
+					const auto writeBufferSwitch = [&](std::string_view phase) {
+						beginEvent("bufferSwitch", phase, processId, record.threadId, record.timeNanoseconds);
+						stream << ",\"args\":{\"bufferIndex\":" << record.arg0;
+						if (record.event == TraceEvent::BUFFER_SWITCH_BEGIN) stream << ",\"samplePosition\":" << record.arg1;
+						stream << "}}";
+					};
+					switch (record.event) {
+					case TraceEvent::WRITE_START: writeTransfer("write", "b"); break;
+					case TraceEvent::WRITE_COMPLETE: writeTransfer("write", "e"); break;
+					case TraceEvent::READ_START: writeTransfer("read", "b"); break;
+					case TraceEvent::READ_COMPLETE: writeTransfer("read", "e"); break;
+					case TraceEvent::BUFFER_SWITCH_BEGIN: writeBufferSwitch("B"); break;
+					case TraceEvent::BUFFER_SWITCH_END: writeBufferSwitch("E"); break;
+					default: {
+						const auto name = GetTraceEventName(record.event);
+						beginEvent(name.value_or("UNKNOWN"), "i", processId, record.threadId, record.timeNanoseconds);
+						stream << ",\"s\":\"" << (record.event == TraceEvent::RECORDS_DROPPED ? "g" : "t") << "\",\"args\":{\"arg0\":" << record.arg0 << ",\"arg1\":" << record.arg1 << "}}";
+					}
+					}
+				}
+			}
+			stream << "\n]}\n";
+		}
+
+		int Main(int argc, char** argv) {
+			if (argc < 2 || argc > 3) {
+				std::cerr << "usage: ASIO401Trace <ASIO401.trace file> [<output JSON file>]" << std::endl;
+				std::cerr << "Prints summary statistics, and writes a Chrome/Perfetto JSON timeline (by default, next to the trace file with a .json extension)." << std::endl;
+				return 2;
+			}
+			const std::string tracePath = argv[1];
+			const std::string jsonPath = argc > 2 ? argv[2] : tracePath + ".json";
+
+			try {
+				const auto sessions = ReadTrace(tracePath);
+				for (size_t sessionIndex = 0; sessionIndex < sessions.size(); ++sessionIndex) PrintSummary(sessions[sessionIndex], sessionIndex);
+
+				std::ofstream json(jsonPath);
+				if (!json) throw std::runtime_error("unable to open " + jsonPath + " for writing");
+				WriteChromeTrace(sessions, json);
+				std::cout << "Timeline written to " << jsonPath << std::endl;
+			}
+			catch (const std::exception& exception) {
+				std::cerr << "ERROR: " << exception.what() << std::endl;
+				return 1;
+			}
+			return 0;
+		}
+
+	}
+}
+
+int main(int argc, char** argv) {
+	return ::asio401::Main(argc, argv);
+}
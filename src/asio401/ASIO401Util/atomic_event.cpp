@@ -0,0 +1,25 @@
+#include "atomic_event.h"
+
+#include <windows.h>
+
+#include <thread>
+
+namespace asio401 {
+
+	AtomicEvent::AtomicEvent(bool initiallySet, size_t spinCount) :
+		state(initiallySet), spinCount(std::thread::hardware_concurrency() > 1 ? spinCount : 0) {}
+
+	void AtomicEvent::Set() {
+		// If the event was already set, then by definition nobody can be waiting on it.
+		if (!state.exchange(true, std::memory_order_release)) state.notify_all();
+	}
+
+	void AtomicEvent::Wait() const {
+		for (size_t spin = 0; spin < spinCount; ++spin) {
+			if (IsSet()) return;
+			YieldProcessor();
+		}
+		while (!IsSet()) state.wait(false, std::memory_order_acquire);
+	}
+
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace asio401 {
+
+	// A manual-reset event that does not use any locks. Set() and Reset() are wait-free, and Set() only makes a system call if the event was not set
+	// already. Wait() spins for a while before falling back to a wait on the address of the flag (std::atomic::wait(), i.e. WaitOnAddress() on Windows).
+	// Spinning makes sense when the event is expected to be set very shortly, as it avoids a context switch in that case. Spinning is disabled on
+	// single-processor systems, where it would only delay the thread that is supposed to set the event.
+	class AtomicEvent final {
+	public:
+		explicit AtomicEvent(bool initiallySet, size_t spinCount = 0);
+		AtomicEvent(const AtomicEvent&) = delete;
+		AtomicEvent& operator=(const AtomicEvent&) = delete;
+
+		void Set();
+		void Reset() { state.store(false, std::memory_order_relaxed); }
+		bool IsSet() const { return state.load(std::memory_order_acquire); }
+		void Wait() const;
+
+	private:
+		std::atomic<bool> state;
+		const size_t spinCount;
+	};
+
+}
@@ -0,0 +1,49 @@
+#include "clock.h"
+
+#include <windows.h>
+#include <timeapi.h>
+
+namespace asio401 {
+
+	HighResolutionClock::HighResolutionClock() {
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);  // Cannot fail on Windows XP and later
+		counterFrequency = frequency.QuadPart;
+
+		// Catch timeGetTime() right as it ticks, so that the offset is accurate to the performance counter resolution, not timeGetTime() resolution.
+		// Temporarily bump the timer resolution so that we don't have to wait for too long.
+		timeBeginPeriod(1);
+		const auto initialTimeMilliseconds = timeGetTime();
+		DWORD timeMilliseconds;
+		int64_t counterNanoseconds;
+		do {
+			timeMilliseconds = timeGetTime();
+			counterNanoseconds = GetCounterNanoseconds();
+		} while (timeMilliseconds == initialTimeMilliseconds);
+		timeEndPeriod(1);
+		offsetNanoseconds = int64_t(timeMilliseconds) * 1000000 - counterNanoseconds;
+	}
+
+	int64_t HighResolutionClock::GetTimeNanoseconds() const {
+		return GetCounterNanoseconds() + offsetNanoseconds;
+	}
+
+	int64_t HighResolutionClock::GetCounterNanoseconds() const {
+		LARGE_INTEGER counter;
+		QueryPerformanceCounter(&counter);  // Cannot fail on Windows XP and later
+		// Split the conversion to avoid overflowing int64_t on systems that have been up for a long time.
+		return counter.QuadPart / counterFrequency * 1000000000 + counter.QuadPart % counterFrequency * 1000000000 / counterFrequency;
+	}
+
+	void SleepUntil(std::chrono::steady_clock::time_point deadline) {
+		for (;;) {
+			const auto remaining = deadline - std::chrono::steady_clock::now();
+			if (remaining <= std::chrono::steady_clock::duration::zero()) return;
+			if (remaining > std::chrono::milliseconds(2))
+				Sleep(DWORD(std::chrono::floor<std::chrono::milliseconds>(remaining).count() - 1));
+			else
+				SwitchToThread();
+		}
+	}
+
+}
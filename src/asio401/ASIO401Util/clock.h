@@ -0,0 +1,31 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace asio401 {
+
+	// A monotonic clock with sub-microsecond resolution, for timestamping audio events.
+	//
+	// Times are in nanoseconds, in the time base that ASIO timestamps are expected to use: the one of timeGetTime(), i.e. time since system startup.
+	// However, timeGetTime() only has a resolution of one millisecond at best, so the clock is actually driven by the QueryPerformanceCounter()
+	// performance counter, which is aligned on timeGetTime() once on construction.
+	class HighResolutionClock final {
+	public:
+		// Note: construction takes up to a few milliseconds, as it waits for timeGetTime() to tick in order to align on it as precisely as possible.
+		HighResolutionClock();
+
+		int64_t GetTimeNanoseconds() const;
+
+	private:
+		int64_t GetCounterNanoseconds() const;
+
+		int64_t counterFrequency;
+		int64_t offsetNanoseconds;
+	};
+
+	// Sleeps until the deadline, more precisely than Sleep(), which can overshoot by a whole timer tick. Sleeps most of the way, then yields the
+	// processor until the deadline. Precision is best if the timer resolution has been raised (e.g. with timeBeginPeriod()).
+	void SleepUntil(std::chrono::steady_clock::time_point deadline);
+
+}
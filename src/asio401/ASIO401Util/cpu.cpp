@@ -0,0 +1,39 @@
+#include "cpu.h"
+
+#include <intrin.h>
+
+namespace asio401 {
+
+	namespace {
+
+		CpuFeatures DetectCpuFeatures() {
+			CpuFeatures cpuFeatures;
+#if defined(_M_IX86) || defined(_M_X64)
+			int cpuInfo[4];
+			__cpuid(cpuInfo, 0);
+			const auto maxFunctionId = cpuInfo[0];
+			if (maxFunctionId < 1) return cpuFeatures;
+
+			__cpuid(cpuInfo, 1);
+			cpuFeatures.ssse3 = cpuInfo[2] & (1 << 9);
+			const bool osxsave = cpuInfo[2] & (1 << 27);
+			const bool avx = cpuInfo[2] & (1 << 28);
+			// The CPU supporting AVX is not enough - the OS also has to save the YMM registers on context switches, otherwise AVX instructions will fault.
+			const bool osSupportsAvx = osxsave && avx && (_xgetbv(0) & 0x6) == 0x6;
+
+			if (maxFunctionId >= 7) {
+				__cpuidex(cpuInfo, 7, 0);
+				cpuFeatures.avx2 = osSupportsAvx && (cpuInfo[1] & (1 << 5));
+			}
+#endif
+			return cpuFeatures;
+		}
+
+	}
+
+	const CpuFeatures& GetCpuFeatures() {
+		static const auto cpuFeatures = DetectCpuFeatures();
+		return cpuFeatures;
+	}
+
+}
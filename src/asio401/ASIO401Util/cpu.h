@@ -0,0 +1,15 @@
+#pragma once
+
+namespace asio401 {
+
+	// Instruction set extensions that can be used by code paths that are selected at runtime.
+	// SSE2 is not listed because it is always available on the platforms ASIO401 is built for.
+	struct CpuFeatures {
+		bool ssse3 = false;
+		bool avx2 = false;
+	};
+
+	// The result is computed on first call and cached for the lifetime of the process.
+	const CpuFeatures& GetCpuFeatures();
+
+}
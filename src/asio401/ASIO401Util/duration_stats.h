@@ -0,0 +1,44 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+namespace asio401 {
+
+	// Accumulates the distribution of a series of durations, for diagnostic purposes.
+	class DurationStats final {
+	public:
+		using Duration = std::chrono::steady_clock::duration;
+
+		void Record(Duration duration) {
+			minimum = count == 0 ? duration : (std::min)(minimum, duration);
+			maximum = count == 0 ? duration : (std::max)(maximum, duration);
+			sum += duration;
+			++count;
+		}
+
+		size_t GetCount() const { return count; }
+
+		static std::string DescribeDuration(Duration duration) {
+			std::stringstream stream;
+			stream << std::fixed << std::setprecision(2) << std::chrono::duration<double, std::milli>(duration).count() << " ms";
+			return stream.str();
+		}
+
+		std::string Describe() const {
+			if (count == 0) return "none";
+			return std::to_string(count) + " samples, min " + DescribeDuration(minimum) + ", mean " + DescribeDuration(sum / count) + ", max " + DescribeDuration(maximum);
+		}
+
+	private:
+		size_t count = 0;
+		Duration minimum = Duration::zero();
+		Duration maximum = Duration::zero();
+		Duration sum = Duration::zero();
+	};
+
+}
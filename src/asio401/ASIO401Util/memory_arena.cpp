@@ -0,0 +1,80 @@
+#include "memory_arena.h"
+
+#include "windows_error.h"
+
+#include <windows.h>
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <string>
+
+namespace asio401 {
+
+	namespace {
+
+		size_t GetPageSize() {
+			SYSTEM_INFO systemInfo;
+			GetSystemInfo(&systemInfo);
+			return systemInfo.dwPageSize;
+		}
+
+		// The locked pages count against the process minimum working set size, so we need to make room for them.
+		// Unlike VirtualLock(), this is process-wide, so we only ever add to (or remove from) the current value.
+		bool AdjustWorkingSetSize(SSIZE_T deltaInBytes) {
+			const auto process = GetCurrentProcess();
+			SIZE_T minimumWorkingSetSize, maximumWorkingSetSize;
+			if (GetProcessWorkingSetSize(process, &minimumWorkingSetSize, &maximumWorkingSetSize) == 0) return false;
+			return SetProcessWorkingSetSize(process, minimumWorkingSetSize + deltaInBytes, maximumWorkingSetSize + deltaInBytes) != 0;
+		}
+
+	}
+
+	void MemoryArena::VirtualFreeDeleter::operator()(std::byte* memory) {
+		const auto result = VirtualFree(memory, 0, MEM_RELEASE);
+		assert(result != 0);
+	}
+
+	MemoryArena::MemoryArena(size_t sizeInBytes) :
+		sizeInBytes([&] {
+			const auto pageSize = GetPageSize();
+			return (std::max)((sizeInBytes + pageSize - 1) / pageSize * pageSize, pageSize);
+		}()),
+		memory([&] {
+			const auto memory = VirtualAlloc(/*lpAddress=*/NULL, this->sizeInBytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+			if (memory == NULL) throw std::runtime_error("Unable to allocate " + std::to_string(this->sizeInBytes) + " bytes: " + GetWindowsErrorString(GetLastError()));
+			return static_cast<std::byte*>(memory);
+		}()) {
+		// VirtualAlloc() only reserves zero pages; they are not actually mapped until they are first accessed. Do that now.
+		const auto pageSize = GetPageSize();
+		for (size_t offset = 0; offset < this->sizeInBytes; offset += pageSize)
+			*static_cast<volatile std::byte*>(memory.get() + offset) = std::byte(0);
+	}
+
+	MemoryArena::~MemoryArena() {
+		// Note: freeing the memory unlocks it.
+		if (workingSetGrown) AdjustWorkingSetSize(-SSIZE_T(sizeInBytes));
+	}
+
+	void MemoryArena::Lock() {
+		if (locked) return;
+		if (VirtualLock(memory.get(), sizeInBytes) == 0) {
+			const auto error = GetLastError();
+			if (error != ERROR_WORKING_SET_QUOTA) throw std::runtime_error("Unable to lock memory: " + GetWindowsErrorString(error));
+			if (!AdjustWorkingSetSize(SSIZE_T(sizeInBytes))) throw std::runtime_error("Unable to grow the working set to lock memory: " + GetWindowsErrorString(GetLastError()));
+			workingSetGrown = true;
+			if (VirtualLock(memory.get(), sizeInBytes) == 0) throw std::runtime_error("Unable to lock memory: " + GetWindowsErrorString(GetLastError()));
+		}
+		locked = true;
+	}
+
+	std::span<std::byte> MemoryArena::Allocate(size_t sizeInBytes) {
+		const auto blockSizeInBytes = GetBlockSizeInBytes(sizeInBytes);
+		if (blockSizeInBytes > this->sizeInBytes - allocatedSizeInBytes)
+			throw std::runtime_error("Memory arena of size " + std::to_string(this->sizeInBytes) + " is too small to allocate " + std::to_string(sizeInBytes) + " more bytes");
+		const std::span<std::byte> block(memory.get() + allocatedSizeInBytes, sizeInBytes);
+		allocatedSizeInBytes += blockSizeInBytes;
+		return block;
+	}
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <span>
+
+namespace asio401 {
+
+	// A single, page-aligned block of memory that is allocated in one go and then carved into smaller blocks, each aligned to a cache line.
+	//
+	// All pages are touched on construction, so that the first access to the memory does not trigger a page fault. Optionally, the memory can be
+	// locked into physical memory, so that it cannot be paged out later either. This is meant for memory that is accessed from real-time threads.
+	//
+	// Blocks cannot be freed individually; they are all freed when the arena is destroyed.
+	class MemoryArena final {
+	public:
+		static constexpr size_t blockAlignmentInBytes = 64;
+
+		// Returns how much arena space a block of the given size takes, including alignment padding. Useful to compute the size of the arena.
+		static size_t GetBlockSizeInBytes(size_t sizeInBytes) { return (sizeInBytes + blockAlignmentInBytes - 1) / blockAlignmentInBytes * blockAlignmentInBytes; }
+
+		explicit MemoryArena(size_t sizeInBytes);
+		~MemoryArena();
+		MemoryArena(const MemoryArena&) = delete;
+		MemoryArena& operator=(const MemoryArena&) = delete;
+
+		size_t GetSizeInBytes() const { return sizeInBytes; }
+		const std::byte* GetData() const { return memory.get(); }
+
+		// Locks the whole arena into physical memory, growing the process working set if necessary. Throws on failure, in which case the arena is
+		// still usable, just not locked.
+		void Lock();
+		bool IsLocked() const { return locked; }
+
+		// Returns a zero-initialized block. Throws if there is not enough space left in the arena.
+		std::span<std::byte> Allocate(size_t sizeInBytes);
+
+	private:
+		struct VirtualFreeDeleter {
+			void operator()(std::byte*);
+		};
+
+		const size_t sizeInBytes;
+		const std::unique_ptr<std::byte, VirtualFreeDeleter> memory;
+		size_t allocatedSizeInBytes = 0;
+		bool locked = false;
+		// If Lock() had to grow the working set, we shrink it back on destruction.
+		bool workingSetGrown = false;
+	};
+
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+namespace asio401 {
+
+	// A fixed-capacity queue of elements that can be pushed from any number of threads, and popped from a single thread at a time. See "Bounded MPMC
+	// queue", D. Vyukov, of which this is a subset.
+	//
+	// TryPush() never blocks and never allocates memory; if the queue is full, it fails immediately. Elements are not moved in or out of the queue;
+	// instead, they are constructed once along with the queue, and callers fill them in or read them in place. This makes it possible to reuse
+	// resources held by elements (e.g. string capacity) from one push to the next.
+	template <typename T>
+	class BoundedMpscQueue final {
+	public:
+		// `capacity` must be a power of two. `initialize` is called once on every element.
+		template <typename Initialize = void(*)(T&)>
+		explicit BoundedMpscQueue(size_t capacity, Initialize&& initialize = [](T&) {}) : mask(capacity - 1), cells(std::make_unique<Cell[]>(capacity)) {
+			if (!std::has_single_bit(capacity)) throw std::invalid_argument("BoundedMpscQueue capacity must be a power of two");
+			for (size_t cellIndex = 0; cellIndex < capacity; ++cellIndex) {
+				cells[cellIndex].sequence.store(cellIndex, std::memory_order_relaxed);
+				initialize(cells[cellIndex].value);
+			}
+		}
+		BoundedMpscQueue(const BoundedMpscQueue&) = delete;
+		BoundedMpscQueue& operator=(const BoundedMpscQueue&) = delete;
+
+		size_t GetCapacity() const { return mask + 1; }
+
+		// Calls `write` with a reference to a free element, and enqueues it when `write` returns. Returns false (without calling `write`) if the queue
+		// is full. Can be called from any thread. Lock-free.
+		template <typename Write> bool TryPush(Write&& write) {
+			auto position = pushPosition.load(std::memory_order_relaxed);
+			for (;;) {
+				auto& cell = cells[position & mask];
+				const auto sequence = cell.sequence.load(std::memory_order_acquire);
+				const auto difference = intptr_t(sequence) - intptr_t(position);
+				if (difference == 0) {
+					if (!pushPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) continue;
+					write(cell.value);
+					cell.sequence.store(position + 1, std::memory_order_release);
+					return true;
+				}
+				// The consumer hasn't released this cell yet, i.e. the queue is full.
+				if (difference < 0) return false;
+				// Another producer claimed this cell since we loaded the position.
+				position = pushPosition.load(std::memory_order_relaxed);
+			}
+		}
+
+		// Calls `read` with a reference to the oldest element, and frees it when `read` returns. Returns false (without calling `read`) if the queue is
+		// empty, or if the oldest element is still being written. Must only be called from a single thread at a time. Wait-free.
+		template <typename Read> bool TryPop(Read&& read) {
+			auto& cell = cells[popPosition & mask];
+			if (cell.sequence.load(std::memory_order_acquire) != popPosition + 1) return false;
+			read(cell.value);
+			cell.sequence.store(popPosition + mask + 1, std::memory_order_release);
+			++popPosition;
+			return true;
+		}
+
+	private:
+		struct Cell final {
+			// Equal to the position of the next push that can use this cell, plus one if the cell holds an element that is ready to be popped.
+			std::atomic<size_t> sequence;
+			T value;
+		};
+
+		const size_t mask;
+		const std::unique_ptr<Cell[]> cells;
+		// Producers contend on the push position; keep it away from the consumer so that pops don't suffer from that.
+		alignas(64) std::atomic<size_t> pushPosition = 0;
+		alignas(64) size_t popPosition = 0;
+	};
+
+}
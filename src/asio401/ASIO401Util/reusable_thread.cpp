@@ -0,0 +1,51 @@
+#include "reusable_thread.h"
+
+#include <cassert>
+#include <utility>
+
+namespace asio401 {
+
+	ReusableThread::ReusableThread(std::function<void()> function) : function(std::move(function)) {
+		thread = std::thread([&] { Run(); });
+	}
+
+	ReusableThread::~ReusableThread() {
+		{
+			std::unique_lock lock(mutex);
+			stateChanged.wait(lock, [&] { return !startRequested && !running; });
+			exitRequested = true;
+		}
+		stateChanged.notify_all();
+		thread.join();
+	}
+
+	void ReusableThread::Start() {
+		{
+			std::scoped_lock lock(mutex);
+			assert(!startRequested && !running);
+			startRequested = true;
+		}
+		stateChanged.notify_all();
+	}
+
+	void ReusableThread::Wait() {
+		std::unique_lock lock(mutex);
+		stateChanged.wait(lock, [&] { return !startRequested && !running; });
+	}
+
+	void ReusableThread::Run() {
+		std::unique_lock lock(mutex);
+		for (;;) {
+			stateChanged.wait(lock, [&] { return startRequested || exitRequested; });
+			if (exitRequested) return;
+			startRequested = false;
+			running = true;
+			lock.unlock();
+			function();
+			lock.lock();
+			running = false;
+			stateChanged.notify_all();
+		}
+	}
+
+}
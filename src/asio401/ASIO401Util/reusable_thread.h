@@ -0,0 +1,39 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace asio401 {
+
+	// A thread that runs the same function every time it is asked to, instead of exiting when the function returns. This avoids the cost of creating a
+	// new thread every time. The function is fixed at construction time, so that starting it does not involve any memory allocation.
+	//
+	// This is not meant to be used on any real-time path: Start() and Wait() use a mutex.
+	class ReusableThread final {
+	public:
+		explicit ReusableThread(std::function<void()> function);
+		// Waits for the function to return if it is running.
+		~ReusableThread();
+		ReusableThread(const ReusableThread&) = delete;
+		ReusableThread& operator=(const ReusableThread&) = delete;
+
+		// Must not be called again until Wait() has returned.
+		void Start();
+		// Blocks until the function returns. Returns immediately if the function is not running.
+		void Wait();
+
+	private:
+		void Run();
+
+		const std::function<void()> function;
+		std::mutex mutex;
+		std::condition_variable stateChanged;
+		bool startRequested = false;
+		bool running = false;
+		bool exitRequested = false;
+		std::thread thread;
+	};
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace asio401 {
+
+	// Publishes a value from one writer thread to any number of reader threads, without locks.
+	// Store() is wait-free. Load() never blocks the writer; it retries if it races with a Store(), which is cheap because a Store() only takes a few
+	// nanoseconds. This is meant for small values that are updated often and read occasionally.
+	template <typename T>
+	class Seqlock final {
+		static_assert(std::is_trivially_copyable_v<T>);
+
+	public:
+		Seqlock() : Seqlock(T()) {}
+		explicit Seqlock(const T& value) { Store(value); }
+		Seqlock(const Seqlock&) = delete;
+		Seqlock& operator=(const Seqlock&) = delete;
+
+		// Must only be called from a single thread at a time.
+		void Store(const T& value) {
+			const auto currentSequence = sequence.load(std::memory_order_relaxed);
+			// An odd sequence number means a write is in progress.
+			sequence.store(currentSequence + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			std::array<uint64_t, wordCount> valueWords = {};
+			memcpy(valueWords.data(), &value, sizeof(value));
+			for (size_t wordIndex = 0; wordIndex < wordCount; ++wordIndex) words[wordIndex].store(valueWords[wordIndex], std::memory_order_relaxed);
+			sequence.store(currentSequence + 2, std::memory_order_release);
+		}
+
+		T Load() const {
+			for (;;) {
+				const auto sequenceBefore = sequence.load(std::memory_order_acquire);
+				if (sequenceBefore % 2 != 0) continue;
+				std::array<uint64_t, wordCount> valueWords;
+				for (size_t wordIndex = 0; wordIndex < wordCount; ++wordIndex) valueWords[wordIndex] = words[wordIndex].load(std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (sequence.load(std::memory_order_relaxed) != sequenceBefore) continue;
+				T value;
+				memcpy(&value, valueWords.data(), sizeof(value));
+				return value;
+			}
+		}
+
+	private:
+		// The value is stored as atomic words, so that reads racing with writes are not undefined behaviour. Torn reads are detected using the sequence number.
+		static constexpr size_t wordCount = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+		std::atomic<uint64_t> sequence = 0;
+		std::array<std::atomic<uint64_t>, wordCount> words;
+	};
+
+}
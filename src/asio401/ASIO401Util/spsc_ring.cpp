@@ -0,0 +1,65 @@
+#include "spsc_ring.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace asio401 {
+
+	SpscRing::SpscRing(std::span<std::byte> buffer) : buffer(buffer) {
+		assert(!buffer.empty());
+	}
+
+	bool SpscRing::WaitUntilWritable(size_t sizeInBytes) {
+		assert(sizeInBytes <= buffer.size());
+		// The write position can only be changed by us, or by Close() - in the latter case the read position changes as well, which will wake us up.
+		const auto currentWritePosition = writePosition.load(std::memory_order_relaxed);
+		for (;;) {
+			const auto currentReadPosition = readPosition.load(std::memory_order_acquire);
+			if ((currentWritePosition | currentReadPosition) & closedFlag) return false;
+			if (currentWritePosition - currentReadPosition + sizeInBytes <= buffer.size()) return true;
+			readPosition.wait(currentReadPosition, std::memory_order_acquire);
+		}
+	}
+
+	SpscRing::Regions SpscRing::GetWriteRegions(size_t sizeInBytes) {
+		const auto offset = GetOffset(writePosition.load(std::memory_order_relaxed));
+		const auto firstRegionSize = (std::min)(sizeInBytes, buffer.size() - offset);
+		return { buffer.subspan(offset, firstRegionSize), buffer.first(sizeInBytes - firstRegionSize) };
+	}
+
+	void SpscRing::CommitWrite(size_t sizeInBytes) {
+		// Note: fetch_add() (as opposed to store()) preserves the closed flag if Close() is called concurrently.
+		writePosition.fetch_add(sizeInBytes, std::memory_order_release);
+		writePosition.notify_one();
+	}
+
+	bool SpscRing::WaitUntilReadable(size_t sizeInBytes) {
+		assert(sizeInBytes <= buffer.size());
+		const auto currentReadPosition = readPosition.load(std::memory_order_relaxed);
+		for (;;) {
+			const auto currentWritePosition = writePosition.load(std::memory_order_acquire);
+			if ((currentWritePosition | currentReadPosition) & closedFlag) return false;
+			if (currentWritePosition - currentReadPosition >= sizeInBytes) return true;
+			writePosition.wait(currentWritePosition, std::memory_order_acquire);
+		}
+	}
+
+	SpscRing::ConstRegions SpscRing::GetReadRegions(size_t sizeInBytes) const {
+		const auto offset = GetOffset(readPosition.load(std::memory_order_relaxed));
+		const auto firstRegionSize = (std::min)(sizeInBytes, buffer.size() - offset);
+		return { buffer.subspan(offset, firstRegionSize), buffer.first(sizeInBytes - firstRegionSize) };
+	}
+
+	void SpscRing::CommitRead(size_t sizeInBytes) {
+		readPosition.fetch_add(sizeInBytes, std::memory_order_release);
+		readPosition.notify_one();
+	}
+
+	void SpscRing::Close() {
+		writePosition.fetch_or(closedFlag, std::memory_order_acq_rel);
+		readPosition.fetch_or(closedFlag, std::memory_order_acq_rel);
+		writePosition.notify_all();
+		readPosition.notify_all();
+	}
+
+}
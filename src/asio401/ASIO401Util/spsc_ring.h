@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace asio401 {
+
+	// A fixed-size ring buffer of bytes that is shared between exactly one producer thread and one consumer thread.
+	//
+	// Data is not copied in or out of the ring; instead, the producer and consumer access the ring memory directly (through Get*Regions()), and then
+	// commit what they wrote or read. This allows callers to convert data directly from/to the ring memory. Because the ring wraps around, the memory
+	// is exposed as two contiguous regions; the second one is empty if the requested range does not wrap around.
+	//
+	// All operations are wait-free, except for the WaitUntil*() functions which block until enough data or space is available (or the ring is closed).
+	class SpscRing final {
+	public:
+		using Regions = std::array<std::span<std::byte>, 2>;
+		using ConstRegions = std::array<std::span<const std::byte>, 2>;
+
+		// The ring does not own its memory; the caller must keep `buffer` alive for the lifetime of the ring.
+		explicit SpscRing(std::span<std::byte> buffer);
+		SpscRing(const SpscRing&) = delete;
+		SpscRing& operator=(const SpscRing&) = delete;
+
+		size_t GetSizeInBytes() const { return buffer.size(); }
+
+		// Producer side.
+
+		// Returns false if the ring has been closed.
+		bool WaitUntilWritable(size_t sizeInBytes);
+		// Only valid if at least `sizeInBytes` bytes are writable, e.g. after WaitUntilWritable() returned true.
+		Regions GetWriteRegions(size_t sizeInBytes);
+		void CommitWrite(size_t sizeInBytes);
+
+		// Consumer side.
+
+		// Returns false if the ring has been closed.
+		bool WaitUntilReadable(size_t sizeInBytes);
+		// Only valid if at least `sizeInBytes` bytes are readable, e.g. after WaitUntilReadable() returned true.
+		ConstRegions GetReadRegions(size_t sizeInBytes) const;
+		void CommitRead(size_t sizeInBytes);
+
+		// Can be called from any thread. Makes all current and future WaitUntil*() calls return false. Cannot be undone.
+		void Close();
+
+	private:
+		// Positions are byte counts since the creation of the ring; they never wrap around in practice. The most significant bit is used to flag the ring
+		// as closed, so that waiters (which wait for a position to change) are woken up by Close().
+		static constexpr uint64_t closedFlag = uint64_t(1) << 63;
+
+		size_t GetOffset(uint64_t position) const { return size_t((position & ~closedFlag) % buffer.size()); }
+
+		const std::span<std::byte> buffer;
+		// Each position is only ever advanced by one side; keep them on separate cache lines so that the two threads don't fight over the same line.
+		alignas(64) std::atomic<uint64_t> writePosition = 0;
+		alignas(64) std::atomic<uint64_t> readPosition = 0;
+	};
+
+}